@@ -1,2 +1,5 @@
 glslc shaders/shader.vert -o shaders/shader.vert.spv
-glslc shaders/shader.frag -o shaders/shader.frag.spv
\ No newline at end of file
+glslc -DPER_DRAW_UBO shaders/shader.vert -o shaders/shader_ubo.vert.spv
+glslc shaders/shader.frag -o shaders/shader.frag.spv
+glslc shaders/indirect.vert -o shaders/indirect.vert.spv
+glslc shaders/cull.comp -o shaders/cull.comp.spv
@@ -0,0 +1,27 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 fragColor;
+
+struct ObjectData {
+    mat4 model;
+    vec4 sphere;
+    uint batch;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects { ObjectData objects[]; };
+
+layout(push_constant) uniform Push {
+    mat4 viewProj;
+} push;
+
+void main() {
+    // firstInstance of each indirect command is the object index
+    fragColor = color;
+    gl_Position = push.viewProj * objects[gl_InstanceIndex].model * vec4(position, 1.0);
+}
@@ -1,11 +1,23 @@
 #version 450
 
-layout(location = 0) in vec2 position;
+layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 
 layout(location = 0) out vec3 fragColor;
 
+// mirrors DrawData in push_constants.h; PER_DRAW_UBO selects the dynamic uniform buffer fallback
+#ifdef PER_DRAW_UBO
+layout(set = 1, binding = 0) uniform DrawData {
+#else
+layout(push_constant) uniform DrawData {
+#endif
+    mat4 transform;
+    vec4 color;
+    uint transformIndex;
+    uint materialId;
+} draw;
+
 void main() {
-    fragColor = color;
-    gl_Position = vec4(position, 0.0, 1.0);
-}
\ No newline at end of file
+    fragColor = color * draw.color.rgb;
+    gl_Position = draw.transform * vec4(position, 1.0);
+}
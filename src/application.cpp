@@ -1,122 +1,268 @@
 #include "application.h"
+#include "log.h"
+#include "mesh_loader.h"
 
 #include <array>
+#include <cmath>
+#include <cstdlib>
 #include <filesystem>
-#include <iostream>
+#include <memory>
+#include <sstream>
 
 namespace VKEngine {
 
-    Application::Application()
-        : m_pipelineLayout(VK_NULL_HANDLE) {
+    Application::Application(const LaunchProfile& profile)
+        : m_profile(profile), m_pipelineLayout(VK_NULL_HANDLE) {
+        m_stats.profile = m_device.profile().name();
         loadModels();
+        createDescriptors();
+        createGpuCulling();
         createPipelineLayout();
-        recreateSwapChain();
+        createSwapChain();
         createCommandBuffers();
+        createFrameCapture();
+        // from here on the scene is only touched by the simulation thread
+        m_simulation.start();
     }
     Application::~Application() {
+        m_simulation.stop();
         vkDeviceWaitIdle(m_device.device());
+        // the model frees its geometry through the queue, so it goes before the flush
+        m_model.reset();
+        // deferred deleters reference other members, so they run before any of those are destroyed
+        m_deletionQueue.flush();
 
         vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
     }
 
     void Application::run() {
         while (!m_window.shouldClose()) {
-            glfwPollEvents();
+            // nothing is presented while minimized, so block instead of spinning until the window returns
+            if (m_window.isMinimized()) {
+                glfwWaitEvents();
+                continue;
+            }
+            if (!m_framePacer.waitForFrame(m_window)) {
+                continue;
+            }
+            handleCaptureKey();
+            uint64_t framesBefore = m_stats.frameCount;
             drawFrame();
+            if (m_stats.frameCount == framesBefore || !isFrameSettled()) {
+                requestFrame();
+            }
         }
 
         vkDeviceWaitIdle(m_device.device());
     }
 
+    bool Application::isFrameSettled() const {
+        // anything still streaming in or moving needs the frames after this one as well
+        return m_stats.simulation.interpolated == 0
+            && m_stats.assets.queued == 0
+            && m_stats.assets.decoding == 0
+            && m_stats.textures.loading == 0
+            && m_stats.textures.uploadsInFlight == 0
+            && !(m_frameCapture && m_frameCapture->isRecording());
+    }
+
+    void Application::requestFrame() {
+        // continuous pacing draws the next frame anyway
+        if (m_framePacer.getSettings().onDemand) {
+            m_framePacer.invalidate();
+        }
+    }
+
+    void Application::createFrameCapture() {
+        if (!FrameCapture::isSupported(*m_swapChain)) {
+            LOG_INFO("frame capture: no");
+            return;
+        }
+        // VKENGINE_CAPTURE=png|raw records from the first frame, e.g. for headless image output
+        const char* captureFormat = std::getenv("VKENGINE_CAPTURE");
+        bool raw = captureFormat != nullptr && std::string(captureFormat) == "raw";
+        m_frameCapture = std::make_unique<FrameCapture>(
+            m_device, CAPTURE_DIRECTORY, raw ? FrameCapture::Format::Raw : FrameCapture::Format::Png);
+        if (captureFormat != nullptr) {
+            m_frameCapture->start();
+        }
+        LOG_INFO("frame capture: yes (F12)");
+    }
+
+    void Application::handleCaptureKey() {
+        bool pressed = glfwGetKey(m_window.getWindowHandle(), GLFW_KEY_F12) == GLFW_PRESS;
+        if (m_frameCapture && pressed && !m_captureKeyDown) {
+            if (m_frameCapture->isRecording()) {
+                m_frameCapture->stop();
+            }
+            else {
+                m_frameCapture->start();
+            }
+        }
+        m_captureKeyDown = pressed;
+    }
+
     void Application::loadModels() {
-        std::vector<Model::Vertex> vertices = {
-            {{0.0f, -0.5f}, {0.0f, 0.0f, 1.0f}},
-            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-            {{-0.5f, 0.5f}, {1.0f, 0.0f, 0.0f}}
+        // the entity exists from the start, its geometry appears once the file has been loaded
+        m_modelEntity = m_scene.createEntity();
+
+        // parsing and LOD generation run on a worker; only the upload is left for the main thread
+        auto mesh = std::make_shared<Model::MeshData>();
+        auto decode = [mesh](std::vector<uint8_t>& bytes, std::string& error) {
+            std::vector<Model::Vertex> vertices;
+            std::vector<uint32_t> indices;
+            if (!decodeObj(bytes, vertices, indices, error)) {
+                return false;
+            }
+            *mesh = Model::buildMesh(vertices, indices);
+            return true;
+        };
+        auto finish = [this, mesh](bool success, const std::string& error) {
+            if (!success) {
+                LOG_ERROR("failed to load model " << MODEL_PATH << ": " << error);
+                return;
+            }
+            m_model = std::make_unique<Model>(m_geometry, *mesh);
+            addCullingObject(m_modelEntity, m_model.get());
         };
+        m_modelRequest = m_assets.load(MODEL_PATH, 0, std::move(decode), std::move(finish));
+    }
 
-        m_model = std::make_unique<Model>(m_device, vertices);
+    void Application::addCullingObject(Scene::Entity entity, Model* model) {
+        if (entity >= m_entityObjects.size()) {
+            m_entityObjects.resize(entity + 1, UINT32_MAX);
+        }
+        // later transforms only arrive when the entity moves
+        glm::mat4 world = entity < m_entityWorld.size() ? m_entityWorld[entity] : glm::mat4{1.0f};
+        m_entityObjects[entity] = m_gpuCulling ? m_gpuCulling->addObject(model, world)
+                                               : m_cpuCulling.addObject(model, world);
+    }
+
+    void Application::createDescriptors() {
+        for (auto& allocator : m_frameDescriptors) {
+            allocator = std::make_unique<DescriptorAllocator>(m_device);
+        }
+
+        if (BindlessDescriptors::isSupported(m_device)) {
+            m_bindless = std::make_unique<BindlessDescriptors>(m_device, m_layoutCache);
+        }
+        m_textureManager = std::make_unique<TextureManager>(
+            m_device, m_deletionQueue, m_assets, m_bindless.get(), TEXTURE_BUDGET_BYTES);
+    }
+
+    void Application::createGpuCulling() {
+        if (!GpuCulling::isSupported(m_device)) {
+            LOG_INFO("GPU-driven culling unavailable, using CPU-issued draws");
+            return;
+        }
+        m_gpuCulling = std::make_unique<GpuCulling>(m_device, "../shaders/cull.comp.spv");
     }
 
     void Application::createPipelineLayout() {
+        // the bindless set is bound once per command buffer; per-draw data comes from m_perDraw
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        if (m_bindless) {
+            setLayouts.push_back(m_bindless->getLayout());
+        }
+        m_perDraw.declare(setLayouts, pushConstantRanges);
+
         VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
         if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
     }
 
     void Application::createPipeline() {
-        auto pipelineConfig =
-            Pipeline::defaultPipelineConfigInfo(m_swapChain->getSwapChainExtent().width, m_swapChain->getSwapChainExtent().height);
-        pipelineConfig.renderPass = m_swapChain->getRenderPass();
+        auto pipelineConfig = Pipeline::defaultPipelineConfigInfo();
+        // the render pass is null on the dynamic rendering path, which uses the attachment formats instead
+        // scaled rendering uses its own render pass; a render pass's dependencies are part of its compatibility
+        pipelineConfig.renderPass = m_dynamicResolution ? m_dynamicResolution->getRenderPass() : m_swapChain->getRenderPass();
+        pipelineConfig.colorAttachmentFormat = m_swapChain->getSwapChainImageFormat();
+        pipelineConfig.depthAttachmentFormat = m_swapChain->findDepthFormat();
         pipelineConfig.pipelineLayout = m_pipelineLayout;
+
+        // frames still in flight may be using the pipelines being replaced
+        m_deletionQueue.push(std::move(m_pipeline));
+        m_deletionQueue.push(std::move(m_indirectPipeline));
+
         m_pipeline = std::make_unique<Pipeline>(m_device,
-            "../shaders/shader.vert.spv",
+            m_perDraw.usesPushConstants() ? "../shaders/shader.vert.spv" : "../shaders/shader_ubo.vert.spv",
             "../shaders/shader.frag.spv",
             pipelineConfig);
-    }
 
-    void Application::recreateSwapChain() {
-        // Wait for a real size
-        int w = 0, h = 0;
-        glfwGetFramebufferSize(m_window.getGLFWwindow(), &w, &h);
-        while (w == 0 || h == 0) {
-            glfwGetFramebufferSize(m_window.getGLFWwindow(), &w, &h);
-            glfwWaitEvents();
+        if (m_gpuCulling) {
+            auto indirectConfig = pipelineConfig;
+            indirectConfig.pipelineLayout = m_gpuCulling->getDrawPipelineLayout();
+            m_indirectPipeline = std::make_unique<Pipeline>(m_device,
+                "../shaders/indirect.vert.spv",
+                "../shaders/shader.frag.spv",
+                indirectConfig);
         }
+    }
 
-        vkDeviceWaitIdle(m_device.device());
-
-        // Validate surface; if it's lost, recreate it *here* as a last line of defense
-        VkSurfaceCapabilitiesKHR caps{};
-        VkResult capRes = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
-            m_device.physicalDevice(), m_device.surface(), &caps);
-
-        if (capRes == VK_ERROR_SURFACE_LOST_KHR) {
-            std::cerr << "[recreateSwapChain] Surface lost — recreating surface\n";
-            m_window.recreateSurface(m_device.instance());
-            // requery capabilities after recreating the surface
-            VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
-                m_device.physicalDevice(), m_device.surface(), &caps));
+    void Application::createSwapChain() {
+        m_swapChain = std::make_unique<SwapChain>(m_device, m_deletionQueue, m_window.getExtent());
+        if (DynamicResolution::isSupported(m_device, *m_swapChain)) {
+            m_dynamicResolution = std::make_unique<DynamicResolution>(m_device, m_deletionQueue, TARGET_GPU_MILLIS);
+            m_dynamicResolution->resize(*m_swapChain);
         }
+        LOG_INFO("dynamic resolution: " << (m_dynamicResolution ? "yes" : "no"));
+        updateLodScale(m_swapChain->height());
+        createPipeline();
+    }
 
-        // Clamp extent if needed (defensive)
-        VkExtent2D extent{ static_cast<uint32_t>(w), static_cast<uint32_t>(h) };
-        extent.width  = std::max(caps.minImageExtent.width,
-                          std::min(caps.maxImageExtent.width,  extent.width));
-        extent.height = std::max(caps.minImageExtent.height,
-                          std::min(caps.maxImageExtent.height, extent.height));
-
-        // Create a new SwapChain passing old handle so driver can migrate
-        VkSwapchainKHR oldHandle = m_swapChain ? m_swapChain->handle() : VK_NULL_HANDLE;
-
-        // Your SwapChain ctor should accept oldHandle (or store it as m_oldSwapChain)
-        m_swapChain = std::make_unique<SwapChain>(m_device, extent, oldHandle);
-
-        // After successful creation, destroy the old one (inside SwapChain or here)
-        if (oldHandle != VK_NULL_HANDLE) {
-            vkDestroySwapchainKHR(m_device.device(), oldHandle, nullptr);
+    void Application::recreateSwapChain() {
+        // in-flight frames keep presenting from the old swapchain until the deletion queue retires it;
+        // viewport and scissor are dynamic, so pipelines are only rebuilt if the image format changed
+        bool formatChanged = m_swapChain->recreate(m_window.getExtent());
+        if (m_dynamicResolution) {
+            m_dynamicResolution->resize(*m_swapChain);
+        }
+        if (formatChanged) {
+            createPipeline();
         }
+        updateLodScale(m_swapChain->height());
+        createCommandBuffers();
+    }
 
-        createPipeline(); // rebuild pipelines/framebuffers that depend on swapchain
+    void Application::updateLodScale(uint32_t renderHeight) {
+        // pixels per world unit at distance 1, turns LOD errors into screen-space errors
+        float projectionScale = static_cast<float>(renderHeight) / (2.0f * std::tan(FOV_Y * 0.5f));
+        m_lodScale = projectionScale / LOD_ERROR_PIXELS;
     }
 
+    void Application::recreateSurface() {
+        // the only path that drains the GPU: a swapchain must be destroyed before its surface, and a
+        // lost surface cannot hand its images over to a new swapchain
+        LOG_WARN("surface lost, recreating surface and swapchain");
+        m_swapChain->retireSwapChain();
+        vkDeviceWaitIdle(m_device.device());
+        m_deletionQueue.flush();
+        m_window.recreateSurface(m_device.instance());
+        recreateSwapChain();
+    }
 
     void Application::createCommandBuffers() {
+        // one per swapchain image; a recreated swapchain with more images only allocates the extra ones
+        size_t firstNew = m_commandBuffers.size();
+        if (firstNew >= m_swapChain->imageCount()) {
+            return;
+        }
         m_commandBuffers.resize(m_swapChain->imageCount());
 
         VkCommandBufferAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandPool = m_device.getCommandPool();
-        allocInfo.commandBufferCount = (uint32_t)m_commandBuffers.size();
+        allocInfo.commandBufferCount = (uint32_t)(m_commandBuffers.size() - firstNew);
 
-        if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
+        if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, m_commandBuffers.data() + firstNew) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate command buffers!");
         }
 
@@ -132,83 +278,262 @@ namespace VKEngine {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_swapChain->getRenderPass();
-        renderPassInfo.framebuffer = m_swapChain->getFrameBuffer(imageIndex);
+        // the frame's fence was waited on in acquireNextImage, so its transient sets are free again
+        size_t frameIndex = m_swapChain->currentFrame();
+        m_frameDescriptors[frameIndex]->resetPools();
+        m_perDraw.beginFrame(frameIndex);
+        if (m_frameCapture) {
+            m_frameCapture->collect(frameIndex);
+        }
 
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
+        // timings of the frame that last used this slot are ready, so the scale for this one is known
+        if (m_dynamicResolution) {
+            m_dynamicResolution->beginFrame(m_commandBuffers[imageIndex], frameIndex);
+            updateLodScale(m_dynamicResolution->renderExtent().height);
+            m_stats.dynamicResolution = m_dynamicResolution->getStats();
+        }
 
-        std::array<VkClearValue, 2> clearValues = {};
-        clearValues[0].color = {0.1f, 0.1f, 0.1f, 1.0f};
-        clearValues[1].depthStencil = {1.0f, 0};
-        renderPassInfo.clearValueCount = (uint32_t)clearValues.size();
-        renderPassInfo.pClearValues = clearValues.data();
+        m_renderGraph.reset();
+
+        // the culling output is imported so the graph orders the indirect draw after the compute pass
+        RenderGraph::Resource drawCommands = RenderGraph::INVALID_RESOURCE;
+        if (m_gpuCulling) {
+            drawCommands = m_renderGraph.importBuffer("draw commands");
+            m_renderGraph.addPass("cull",
+                [&](RenderGraph::PassBuilder& pass) {
+                    pass.write(drawCommands, RenderGraph::Access::ComputeStorageWrite);
+                },
+                [&](VkCommandBuffer commandBuffer) {
+                    m_gpuCulling->recordCull(commandBuffer, frameIndex, m_viewProj, m_cameraPosition, m_lodScale);
+                });
+        }
 
-        vkCmdBeginRenderPass(m_commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (m_dynamicResolution) {
+            // the scene renders into the scaled target and is blitted to the swapchain image, which is
+            // only available once the acquire semaphore's wait stage has been reached
+            RenderGraph::Resource sceneColor = m_renderGraph.importImage(
+                "scene color", m_dynamicResolution->getColorImage(frameIndex), VK_NULL_HANDLE,
+                VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            RenderGraph::Resource sceneDepth = m_renderGraph.importImage(
+                "scene depth", m_swapChain->getDepthImage(frameIndex), m_swapChain->getDepthImageView(frameIndex),
+                m_swapChain->getDepthAspect(), VK_IMAGE_LAYOUT_UNDEFINED);
+            RenderGraph::Resource backbuffer = m_renderGraph.importImage(
+                "backbuffer", m_swapChain->getImage(imageIndex), m_swapChain->getImageView(imageIndex),
+                VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+            m_renderGraph.addPass("scene",
+                [&](RenderGraph::PassBuilder& pass) {
+                    if (drawCommands != RenderGraph::INVALID_RESOURCE) {
+                        pass.read(drawCommands, RenderGraph::Access::IndirectRead);
+                    }
+                    pass.write(sceneColor, RenderGraph::Access::ColorAttachmentWrite);
+                    pass.write(sceneDepth, RenderGraph::Access::DepthAttachmentWrite);
+                },
+                [&](VkCommandBuffer commandBuffer) {
+                    m_dynamicResolution->beginRendering(commandBuffer, frameIndex,
+                        m_swapChain->getDepthImageView(frameIndex), {{0.1f, 0.1f, 0.1f, 1.0f}});
+                    recordScene(commandBuffer, frameIndex, m_dynamicResolution->renderExtent());
+                    m_dynamicResolution->endRendering(commandBuffer, frameIndex);
+                });
+
+            m_renderGraph.addPass("upscale",
+                [&](RenderGraph::PassBuilder& pass) {
+                    pass.read(sceneColor, RenderGraph::Access::TransferRead);
+                    pass.write(backbuffer, RenderGraph::Access::TransferWrite);
+                },
+                [&](VkCommandBuffer commandBuffer) {
+                    m_dynamicResolution->recordUpscale(commandBuffer, frameIndex, m_swapChain->getImage(imageIndex),
+                                                       m_swapChain->getSwapChainExtent());
+                });
+
+            if (m_frameCapture && m_frameCapture->isRecording()) {
+                m_renderGraph.addPass("capture",
+                    [&](RenderGraph::PassBuilder& pass) {
+                        pass.read(backbuffer, RenderGraph::Access::TransferRead);
+                        pass.sideEffect();
+                    },
+                    [&](VkCommandBuffer commandBuffer) {
+                        m_frameCapture->record(commandBuffer, frameIndex, m_swapChain->getImage(imageIndex),
+                                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                               m_swapChain->getSwapChainImageFormat(), m_swapChain->getSwapChainExtent());
+                    });
+            }
+        }
+        else {
+            // SwapChain::beginRendering/endRendering own the swapchain and depth transitions, so the
+            // main pass only declares what it consumes and is kept for presenting
+            m_renderGraph.addPass("main",
+                [&](RenderGraph::PassBuilder& pass) {
+                    if (drawCommands != RenderGraph::INVALID_RESOURCE) {
+                        pass.read(drawCommands, RenderGraph::Access::IndirectRead);
+                    }
+                    pass.sideEffect();
+                },
+                [&](VkCommandBuffer commandBuffer) {
+                    m_swapChain->beginRendering(commandBuffer, imageIndex, {{0.1f, 0.1f, 0.1f, 1.0f}});
+                    recordScene(commandBuffer, frameIndex, m_swapChain->getSwapChainExtent());
+                    m_swapChain->endRendering(commandBuffer, imageIndex);
+                    if (m_frameCapture) {
+                        // endRendering leaves the image ready for presenting, with transfers ordered after it
+                        m_frameCapture->record(commandBuffer, frameIndex, m_swapChain->getImage(imageIndex),
+                                               VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                               m_swapChain->getSwapChainImageFormat(), m_swapChain->getSwapChainExtent());
+                    }
+                });
+        }
 
-        m_pipeline->bind(m_commandBuffers[imageIndex]);
-        m_model->bind(m_commandBuffers[imageIndex]);
-        m_model->draw(m_commandBuffers[imageIndex]);
+        m_renderGraph.compile();
+        m_renderGraph.execute(m_commandBuffers[imageIndex]);
+        m_stats.renderGraph = m_renderGraph.getStats();
 
-        vkCmdEndRenderPass(m_commandBuffers[imageIndex]);
         if (vkEndCommandBuffer(m_commandBuffers[imageIndex]) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
         }
     }
 
+    void Application::recordScene(VkCommandBuffer commandBuffer, size_t frameIndex, VkExtent2D extent) {
+        VkViewport viewport{0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, extent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        if (m_gpuCulling) {
+            // every model lives in the shared geometry buffer, so vertex/index buffers are bound once
+            m_geometry.bind(commandBuffer);
+            m_indirectPipeline->bind(commandBuffer);
+            m_gpuCulling->recordDraw(commandBuffer, frameIndex, m_viewProj);
+        }
+        else {
+            if (m_bindless) {
+                m_bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout);
+            }
+            buildRenderQueue();
+            m_renderQueue.record(commandBuffer, m_perDraw, m_pipelineLayout);
+            m_stats.renderQueue = m_renderQueue.getStats();
+        }
+    }
+
+    void Application::buildRenderQueue() {
+        m_cpuCulling.cull(m_viewProj, m_cameraPosition);
+        m_cpuCulling.selectLods(m_cameraPosition, m_lodScale);
+        m_stats.culling = m_cpuCulling.getStats();
+
+        m_renderQueue.clear();
+        for (uint32_t object : m_cpuCulling.getVisibleObjects()) {
+            RenderQueue::DrawItem item{m_pipeline.get(), m_cpuCulling.getModel(object), m_cpuCulling.getLod(object)};
+            item.data.transform = m_viewProj * m_cpuCulling.getTransform(object);
+            item.data.color = glm::vec4(1.0f);
+            item.data.transformIndex = object;
+            item.data.materialId = 0;
+            m_renderQueue.submit(RenderQueue::makeKey(0, item), item);
+        }
+        m_renderQueue.sort();
+    }
+
+    void Application::updateScene() {
+        // only entities whose world matrix may have changed are pushed to the culling stage
+        m_simulation.interpolate(std::chrono::steady_clock::now(), [this](Scene::Entity entity, const glm::mat4& world) {
+            if (entity >= m_entityWorld.size()) {
+                m_entityWorld.resize(entity + 1, glm::mat4{1.0f});
+            }
+            m_entityWorld[entity] = world;
+            if (entity >= m_entityObjects.size() || m_entityObjects[entity] == UINT32_MAX) {
+                return;
+            }
+            if (m_gpuCulling) {
+                m_gpuCulling->setTransform(m_entityObjects[entity], world);
+            }
+            else {
+                m_cpuCulling.setTransform(m_entityObjects[entity], world);
+            }
+        });
+        m_stats.simulation = m_simulation.getStats();
+        m_stats.scene = m_stats.simulation.scene;
+    }
+
+    void Application::updateStats() {
+        auto now = std::chrono::steady_clock::now();
+        m_stats.frameCount++;
+        m_stats.cpuFrameMillis = std::chrono::duration<double, std::milli>(now - m_frameStart).count();
+        m_frameStart = now;
+        m_stats.pacing = m_framePacer.getStats();
+
+        if (now - m_lastStatsPrint >= std::chrono::seconds(1)) {
+            std::ostringstream out;
+            m_stats.print(out);
+            LOG_INFO(out.str());
+            m_lastStatsPrint = now;
+        }
+    }
 
     void Application::drawFrame() {
+        // resize before acquiring, so no image is acquired from a swapchain about to be replaced
+        if (m_window.wasWindowResized()) {
+            m_window.resetWindowResizedFlag();
+            recreateSwapChain();
+        }
+
         uint32_t imageIndex;
         VkResult result = m_swapChain->acquireNextImage(&imageIndex);
 
         // ----- ACQUIRE CHECKS -----
         if (result == VK_ERROR_SURFACE_LOST_KHR) {
-            std::cerr << "acquireNextImage: SURFACE_LOST — recreating surface and swapchain\n";
-            m_window.recreateSurface(m_device.instance());
-            recreateSwapChain();
+            recreateSurface();
             return;
         }
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            std::cout << "acquireNextImage: OUT_OF_DATE — recreating swapchain\n";
+            LOG_INFO("acquireNextImage: OUT_OF_DATE — recreating swapchain");
             recreateSwapChain();
             return;
         }
         if (result == VK_SUBOPTIMAL_KHR) {
-            std::cout << "acquireNextImage: SUBOPTIMAL — continuing with current swapchain\n";
+            LOG_INFO("acquireNextImage: SUBOPTIMAL — continuing with current swapchain");
         }
         if (result == VK_TIMEOUT) {
-            std::cout << "acquireNextImage: TIMEOUT — skipping frame\n";
+            LOG_WARN("acquireNextImage: TIMEOUT — skipping frame");
             return;
         }
         if (result != VK_SUCCESS) {
-            std::cerr << "acquireNextImage failed with VkResult: " << result << std::endl;
+            LOG_ERROR("acquireNextImage failed with VkResult: " << result);
             return;
         }
 
         // ----- SUBMIT / PRESENT -----
+        m_deletionQueue.collect();
+        // geometry finished this frame goes up in one batch; textures batch their own uploads
+        m_geometry.beginUploads();
+        m_assets.update();
+        m_geometry.endUploads();
+        m_stats.assets = m_assets.getStats();
+        updateScene();
+        m_textureManager->update();
+        m_stats.textures = m_textureManager->getStats();
         recordCommandBuffer(imageIndex);
         VkResult submitResult = m_swapChain->submitCommandBuffers(&m_commandBuffers[imageIndex], &imageIndex);
+        m_deletionQueue.endFrame();
+        m_stats.pendingDeletions = m_deletionQueue.pendingCount();
+        if (m_frameCapture) {
+            m_stats.capture = m_frameCapture->getStats();
+        }
 
         if (submitResult == VK_ERROR_SURFACE_LOST_KHR) {
-            std::cerr << "present: SURFACE_LOST — recreating surface and swapchain\n";
-            m_window.recreateSurface(m_device.instance());
-            recreateSwapChain();
+            recreateSurface();
             return;
         }
-        if (submitResult == VK_ERROR_OUT_OF_DATE_KHR || m_window.wasWindowResized()) {
-            std::cout << "present: OUT_OF_DATE — recreating swapchain\n";
-            m_window.resetWindowResizedFlag();
+        if (submitResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            LOG_INFO("present: OUT_OF_DATE — recreating swapchain");
             recreateSwapChain();
             return;
         }
         if (submitResult == VK_SUBOPTIMAL_KHR) {
-            std::cout << "present: SUBOPTIMAL — continuing with current swapchain\n";
+            LOG_INFO("present: SUBOPTIMAL — continuing with current swapchain");
         }
         if (submitResult != VK_SUCCESS) {
-            std::cerr << "present failed with VkResult: " << submitResult << std::endl;
+            LOG_ERROR("present failed with VkResult: " << submitResult);
         }
+
+        updateStats();
     }
 
 
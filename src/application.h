@@ -5,9 +5,27 @@
 #include "vk_device.h"
 #include "vk_swapchain.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 #include "model.h"
+#include "gpu_culling.h"
+#include "cpu_culling.h"
+#include "render_queue.h"
+#include "frame_stats.h"
+#include "scene.h"
+#include "simulation.h"
+#include "descriptors.h"
+#include "push_constants.h"
+#include "texture_manager.h"
+#include "deletion_queue.h"
+#include "render_graph.h"
+#include "dynamic_resolution.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "asset_pipeline.h"
+
+#include <chrono>
 
 
 namespace VKEngine {
@@ -15,8 +33,14 @@ namespace VKEngine {
         public:
         static constexpr int WIDTH = 800;
         static constexpr int HEIGHT = 600;
+        static constexpr float FOV_Y = 1.0471976f;  // 60 degrees
+        static constexpr float LOD_ERROR_PIXELS = 1.0f;
+        static constexpr VkDeviceSize TEXTURE_BUDGET_BYTES = 256ull << 20;
+        static constexpr const char* CAPTURE_DIRECTORY = "captures";
+        static constexpr const char* MODEL_PATH = "../models/triangle.obj";
+        static constexpr double TARGET_GPU_MILLIS = 12.0;  // scene pass budget, leaves headroom in a 60 Hz frame
 
-        Application();
+        explicit Application(const LaunchProfile& profile);
         ~Application();
         Application(const Application&) = delete;
         Application &operator=(const Application&) = delete;
@@ -25,21 +49,68 @@ namespace VKEngine {
 
         private:
         void loadModels();
+        void addCullingObject(Scene::Entity entity, Model* model);
+        void createDescriptors();
+        void createGpuCulling();
         void createPipelineLayout();
         void createPipeline();
         void createCommandBuffers();
         void drawFrame();
+        void createSwapChain();
+        void createFrameCapture();
+        void handleCaptureKey();
+        bool isFrameSettled() const;
+        void requestFrame();
         void recreateSwapChain();
+        void recreateSurface();
+        void updateLodScale(uint32_t renderHeight);
         void recordCommandBuffer(int imageIndex);
-        //void recreateSurface();
+        void recordScene(VkCommandBuffer commandBuffer, size_t frameIndex, VkExtent2D extent);
+        void buildRenderQueue();
+        void updateScene();
+        void updateStats();
 
+        LaunchProfile m_profile;
         Window m_window {WIDTH, HEIGHT, "Vulkan window"};
-        Device m_device {m_window};
+        Device m_device {m_window, m_profile};
+        FramePacer m_framePacer {FramePacer::settingsFromEnvironment()};
+        DeletionQueue m_deletionQueue {m_device};
         std::unique_ptr<SwapChain> m_swapChain;
+        std::unique_ptr<DynamicResolution> m_dynamicResolution;  // null if the device can't time or blit
+        std::unique_ptr<FrameCapture> m_frameCapture;  // null if swapchain images can't be copied
+        bool m_captureKeyDown = false;
+        DescriptorLayoutCache m_layoutCache {m_device};
+        std::unique_ptr<BindlessDescriptors> m_bindless;
+        std::unique_ptr<TextureManager> m_textureManager;
+        std::array<std::unique_ptr<DescriptorAllocator>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frameDescriptors;
+        PerDrawConstants<DrawData> m_perDraw {m_device, m_layoutCache, VK_SHADER_STAGE_VERTEX_BIT};
         std::unique_ptr<Pipeline> m_pipeline;
         VkPipelineLayout m_pipelineLayout;
         std::vector<VkCommandBuffer> m_commandBuffers;
-        std::unique_ptr<Model> m_model;
+        GeometryBuffer m_geometry {m_device, m_deletionQueue, sizeof(Model::Vertex), 1 << 16, 1 << 18};
+        std::unique_ptr<Model> m_model;  // null until loaded
+        std::unique_ptr<GpuCulling> m_gpuCulling;
+        CpuCulling m_cpuCulling;
+        std::unique_ptr<Pipeline> m_indirectPipeline;
+        RenderGraph m_renderGraph {m_device, m_deletionQueue};
+        glm::mat4 m_viewProj{1.0f};
+        glm::vec3 m_cameraPosition{0.0f};
+        float m_lodScale = 0.0f;
+
+        Scene m_scene;
+        Scene::Entity m_modelEntity = Scene::INVALID_ENTITY;
+        std::vector<uint32_t> m_entityObjects;  // GPU or CPU culling object index per scene entity
+        std::vector<glm::mat4> m_entityWorld;    // last world matrix applied per scene entity
+        // declared after everything its finish steps use, so it is destroyed before them
+        AssetPipeline m_assets;
+        AssetPipeline::Handle m_modelRequest = AssetPipeline::INVALID_HANDLE;
+        // declared after everything its callbacks use, so its thread is joined before those go away
+        Simulation m_simulation {m_scene, {}, [this]() { requestFrame(); }};
+
+        RenderQueue m_renderQueue;
+        FrameStats m_stats;
+        std::chrono::steady_clock::time_point m_lastStatsPrint = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point m_frameStart = std::chrono::steady_clock::now();
 
     };
 }
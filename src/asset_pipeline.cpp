@@ -0,0 +1,218 @@
+#include "asset_pipeline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace VKEngine {
+
+    namespace {
+
+        // Reads the whole file with a few large reads straight into the destination
+        bool readWholeFile(const std::string& path, std::vector<uint8_t>& bytes, std::string& error) {
+#if defined(__unix__) || defined(__APPLE__)
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                error = "failed to open " + path;
+                return false;
+            }
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                error = "failed to stat " + path;
+                return false;
+            }
+#if defined(__linux__)
+            // lets the kernel read ahead aggressively and drop the pages behind us
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            bytes.resize(static_cast<size_t>(info.st_size));
+            size_t offset = 0;
+            while (offset < bytes.size()) {
+                size_t chunk = std::min(AssetPipeline::READ_CHUNK_BYTES, bytes.size() - offset);
+                ssize_t count = ::read(fd, bytes.data() + offset, chunk);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count < 0) {
+                    ::close(fd);
+                    error = "failed to read " + path + ": " + std::strerror(errno);
+                    return false;
+                }
+                if (count == 0) {
+                    break;
+                }
+                offset += static_cast<size_t>(count);
+            }
+            bytes.resize(offset);
+            ::close(fd);
+            return true;
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                error = "failed to open " + path;
+                return false;
+            }
+            bytes.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            size_t offset = 0;
+            while (offset < bytes.size() && file) {
+                size_t chunk = std::min(AssetPipeline::READ_CHUNK_BYTES, bytes.size() - offset);
+                file.read(reinterpret_cast<char*>(bytes.data() + offset), static_cast<std::streamsize>(chunk));
+                offset += static_cast<size_t>(file.gcount());
+            }
+            bytes.resize(offset);
+            return true;
+#endif
+        }
+
+    }
+
+    AssetPipeline::AssetPipeline() : m_ioThread(&AssetPipeline::ioLoop, this) {}
+
+    AssetPipeline::~AssetPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        m_ioThread.join();
+        // decode jobs reference this and whatever their callbacks capture
+        JobSystem::shared().wait(m_decodeJobs);
+    }
+
+    AssetPipeline::Handle AssetPipeline::load(const std::string& path, int priority, DecodeFunction decode,
+                                              FinishFunction finish) {
+        auto request = std::make_shared<Request>();
+        request->path = path;
+        request->priority = priority;
+        request->sequence = m_nextSequence++;
+        request->decode = std::move(decode);
+        request->finish = std::move(finish);
+
+        Handle handle = static_cast<Handle>(m_requests.size());
+        m_requests.push_back(request);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.emplace(QueueKey{priority, request->sequence}, request);
+        }
+        m_wake.notify_one();
+        return handle;
+    }
+
+    void AssetPipeline::setPriority(Handle handle, int priority) {
+        Request& request = *m_requests[handle];
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (request.queued) {
+            auto node = m_queue.extract(QueueKey{request.priority, request.sequence});
+            node.key().priority = priority;
+            m_queue.insert(std::move(node));
+        }
+        request.priority = priority;
+    }
+
+    void AssetPipeline::cancel(Handle handle) {
+        Request& request = *m_requests[handle];
+        if (request.state != State::Loading) {
+            return;
+        }
+        request.cancelled = true;
+        request.state = State::Cancelled;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (request.queued) {
+            m_queue.erase(QueueKey{request.priority, request.sequence});
+            request.queued = false;
+        }
+    }
+
+    void AssetPipeline::update() {
+        std::vector<Completion> completed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            completed.swap(m_completed);
+        }
+        for (Completion& completion : completed) {
+            Request& request = *completion.request;
+            if (!request.cancelled) {
+                request.state = completion.success ? State::Ready : State::Failed;
+                if (request.finish) {
+                    request.finish(completion.success, completion.error);
+                }
+            }
+            // the callbacks may hold large decoded data
+            request.decode = nullptr;
+            request.finish = nullptr;
+        }
+    }
+
+    AssetPipeline::Stats AssetPipeline::getStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Stats stats;
+        stats.queued = static_cast<uint32_t>(m_queue.size());
+        stats.decoding = m_decoding;
+        stats.bytesRead = m_bytesRead;
+        stats.readMiBPerSecond = m_readSeconds > 0.0 ? m_bytesRead / m_readSeconds / (1 << 20) : 0.0;
+        return stats;
+    }
+
+    void AssetPipeline::ioLoop() {
+        while (true) {
+            std::shared_ptr<Request> request;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this]() {
+                    return m_stopping || (!m_queue.empty() && m_bytesInFlight < MAX_BYTES_IN_FLIGHT);
+                });
+                if (m_stopping) {
+                    return;
+                }
+                auto first = m_queue.begin();
+                request = first->second;
+                request->queued = false;
+                m_queue.erase(first);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<uint8_t> bytes;
+            std::string error;
+            bool success = readWholeFile(request->path, bytes, error);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            size_t size = bytes.size();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_bytesInFlight += size;
+                m_bytesRead += size;
+                m_readSeconds += seconds;
+                m_decoding++;
+            }
+
+            // a background job, so a frame waiting on its own parallel work never runs a decode
+            JobSystem::shared().runBackground([this, request, bytes = std::move(bytes), error, success, size]() mutable {
+                if (success && !request->cancelled) {
+                    success = request->decode(bytes, error);
+                }
+                bytes = {};
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_bytesInFlight -= size;
+                    m_decoding--;
+                    m_completed.push_back({std::move(request), success, std::move(error)});
+                }
+                // room for the next read if the I/O thread was held back
+                m_wake.notify_one();
+            }, &m_decodeJobs);
+        }
+    }
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VKEngine {
+
+    // Loads files in three stages. A single I/O thread reads whole files, highest priority first,
+    // with large sequential reads back to back so the disk never waits on decoding. Each file is then
+    // decoded on the job system, and update() runs the finish step of every decoded asset on the main
+    // thread, where owners batch their GPU uploads. Files read but not yet decoded are capped in size,
+    // so a fast disk can't run ahead of the decoders without bound.
+    //
+    // Priorities can be changed until the I/O thread picks the file up. A cancelled load skips the
+    // stages it hasn't reached and never runs its finish step.
+    //
+    // Destruction waits for decodes in flight and drops finish steps that haven't run, so the
+    // pipeline must be destroyed before anything its callbacks reference.
+    class AssetPipeline {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+        static constexpr size_t READ_CHUNK_BYTES = 8 << 20;
+        static constexpr size_t MAX_BYTES_IN_FLIGHT = 256 << 20;
+
+        enum class State {
+            Loading,
+            Ready,
+            Failed,
+            Cancelled,
+        };
+
+        // Runs on a worker with the whole file; returns false and fills error on failure
+        using DecodeFunction = std::function<bool(std::vector<uint8_t>& bytes, std::string& error)>;
+        // Runs on the main thread inside update(), also when reading or decoding failed
+        using FinishFunction = std::function<void(bool success, const std::string& error)>;
+
+        struct Stats {
+            uint32_t queued = 0;       // waiting for the I/O thread
+            uint32_t decoding = 0;     // read, waiting for a worker or for update()
+            uint64_t bytesRead = 0;
+            double readMiBPerSecond = 0.0;  // while the I/O thread was reading
+        };
+
+        AssetPipeline();
+        ~AssetPipeline();
+
+        AssetPipeline(const AssetPipeline&) = delete;
+        AssetPipeline &operator=(const AssetPipeline&) = delete;
+
+        // Higher priorities are read first, equal ones in request order
+        Handle load(const std::string& path, int priority, DecodeFunction decode, FinishFunction finish);
+        void setPriority(Handle handle, int priority);
+        void cancel(Handle handle);
+        State getState(Handle handle) const { return m_requests[handle]->state; }
+
+        // Once per frame on the main thread
+        void update();
+
+        Stats getStats();
+
+    private:
+        struct Request {
+            std::string path;
+            int priority = 0;
+            uint64_t sequence = 0;
+            DecodeFunction decode;
+            FinishFunction finish;
+            std::atomic<bool> cancelled{false};
+            bool queued = true;            // under m_mutex
+            State state = State::Loading;  // main thread
+        };
+
+        // orders the queue by descending priority, then by request order
+        struct QueueKey {
+            int priority;
+            uint64_t sequence;
+            bool operator<(const QueueKey& other) const {
+                return priority != other.priority ? priority > other.priority : sequence < other.sequence;
+            }
+        };
+
+        struct Completion {
+            std::shared_ptr<Request> request;
+            bool success;
+            std::string error;
+        };
+
+        void ioLoop();
+
+        std::vector<std::shared_ptr<Request>> m_requests;  // by handle, main thread
+        uint64_t m_nextSequence = 0;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::map<QueueKey, std::shared_ptr<Request>> m_queue;
+        size_t m_bytesInFlight = 0;
+        uint32_t m_decoding = 0;
+        uint64_t m_bytesRead = 0;
+        double m_readSeconds = 0.0;
+        std::vector<Completion> m_completed;
+        bool m_stopping = false;
+
+        JobCounter m_decodeJobs;
+        std::thread m_ioThread;  // last, so it starts once everything above exists
+    };
+
+}
@@ -0,0 +1,589 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace VKEngine {
+
+    namespace {
+
+        using Block = std::array<std::array<uint8_t, 4>, 16>;
+
+        constexpr uint8_t BC7_WEIGHTS2[4] = {0, 21, 43, 64};
+        constexpr uint8_t BC7_WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+        constexpr uint8_t BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // Little-endian bit stream over one 16-byte block, least significant bit first
+        struct BitWriter {
+            uint8_t* data;
+            uint32_t position = 0;
+
+            void write(uint32_t value, uint32_t bits) {
+                for (uint32_t i = 0; i < bits; i++, position++) {
+                    data[position >> 3] |= ((value >> i) & 1u) << (position & 7);
+                }
+            }
+        };
+
+        struct BitReader {
+            const uint8_t* data;
+            uint32_t position = 0;
+
+            uint32_t read(uint32_t bits) {
+                uint32_t value = 0;
+                for (uint32_t i = 0; i < bits; i++, position++) {
+                    value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+                }
+                return value;
+            }
+        };
+
+        uint8_t interpolateBc7(uint8_t e0, uint8_t e1, uint8_t weight) {
+            return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+        }
+
+        uint32_t colorDistance(const uint8_t* a, const uint8_t* b, uint32_t channels) {
+            uint32_t distance = 0;
+            for (uint32_t c = 0; c < channels; c++) {
+                int d = int(a[c]) - int(b[c]);
+                distance += d * d;
+            }
+            return distance;
+        }
+
+        // Edge blocks replicate the last row/column so partial blocks do not pull in garbage
+        void fetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sy = std::min(blockY * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = std::min(blockX * 4 + x, width - 1);
+                    std::memcpy(block[y * 4 + x].data(), &pixels[(size_t(sy) * width + sx) * 4], 4);
+                }
+            }
+        }
+
+        void storeBlock(const Block& block, uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY) {
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+                    size_t index = size_t(blockY * 4 + y) * width + blockX * 4 + x;
+                    std::memcpy(&pixels[index * 4], block[y * 4 + x].data(), 4);
+                }
+            }
+        }
+
+        // Principal axis of the block's first `channels` channels, returned as the two extreme
+        // points of the block projected onto it
+        void principalEndpoints(const Block& block, uint32_t channels, float* e0, float* e1) {
+            float mean[4] = {};
+            for (const auto& texel : block) {
+                for (uint32_t c = 0; c < channels; c++) mean[c] += texel[c];
+            }
+            for (uint32_t c = 0; c < channels; c++) mean[c] /= 16.0f;
+
+            float covariance[4][4] = {};
+            for (const auto& texel : block) {
+                for (uint32_t i = 0; i < channels; i++) {
+                    for (uint32_t j = 0; j < channels; j++) {
+                        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                    }
+                }
+            }
+
+            // power iteration from the diagonal of the bounding box
+            float axis[4] = {};
+            for (uint32_t c = 0; c < channels; c++) {
+                uint8_t lo = 255, hi = 0;
+                for (const auto& texel : block) {
+                    lo = std::min(lo, texel[c]);
+                    hi = std::max(hi, texel[c]);
+                }
+                axis[c] = float(hi - lo) + 1e-3f;
+            }
+            for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {};
+                float length = 0.0f;
+                for (uint32_t i = 0; i < channels; i++) {
+                    for (uint32_t j = 0; j < channels; j++) next[i] += covariance[i][j] * axis[j];
+                    length += next[i] * next[i];
+                }
+                if (length < 1e-8f) break;
+                length = 1.0f / std::sqrt(length);
+                for (uint32_t c = 0; c < channels; c++) axis[c] = next[c] * length;
+            }
+
+            float minT = 0.0f, maxT = 0.0f;
+            for (const auto& texel : block) {
+                float t = 0.0f;
+                for (uint32_t c = 0; c < channels; c++) t += (texel[c] - mean[c]) * axis[c];
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+                e0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+                e1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+            }
+        }
+
+        uint16_t packRgb565(const float* color) {
+            uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+            uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+            uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void unpackRgb565(uint16_t packed, uint8_t* color) {
+            uint32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+            color[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+            color[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+            color[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+            color[3] = 255;
+        }
+
+        void bc1Palette(uint16_t c0, uint16_t c1, bool fourColor, uint8_t palette[4][4]) {
+            unpackRgb565(c0, palette[0]);
+            unpackRgb565(c1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                if (fourColor) {
+                    palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+                    palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+                }
+                else {
+                    palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+                    palette[3][c] = 0;
+                }
+            }
+            palette[2][3] = 255;
+            palette[3][3] = fourColor ? 255 : 0;
+        }
+
+        // Always emits the four-colour mode (c0 > c1), which is also what BC3 colour blocks need
+        void encodeBc1(const Block& block, uint8_t* out) {
+            float e0[4], e1[4];
+            principalEndpoints(block, 3, e0, e1);
+            uint16_t c0 = packRgb565(e0);
+            uint16_t c1 = packRgb565(e1);
+            if (c0 < c1) {
+                std::swap(c0, c1);
+            }
+
+            uint32_t indices = 0;
+            if (c0 != c1) {
+                uint8_t palette[4][4];
+                bc1Palette(c0, c1, true, palette);
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t best = 0, bestDistance = UINT32_MAX;
+                    for (uint32_t p = 0; p < 4; p++) {
+                        uint32_t distance = colorDistance(block[i].data(), palette[p], 3);
+                        if (distance < bestDistance) {
+                            best = p;
+                            bestDistance = distance;
+                        }
+                    }
+                    indices |= best << (2 * i);
+                }
+            }
+
+            out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+            out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+            std::memcpy(out + 4, &indices, 4);
+        }
+
+        void decodeBc1(const uint8_t* in, bool forceFourColor, bool allowTransparent, Block& block) {
+            uint16_t c0 = in[0] | (in[1] << 8);
+            uint16_t c1 = in[2] | (in[3] << 8);
+            uint32_t indices;
+            std::memcpy(&indices, in + 4, 4);
+
+            uint8_t palette[4][4];
+            bc1Palette(c0, c1, forceFourColor || c0 > c1, palette);
+            if (!allowTransparent) {
+                palette[3][3] = 255;
+            }
+            for (uint32_t i = 0; i < 16; i++) {
+                std::memcpy(block[i].data(), palette[(indices >> (2 * i)) & 3], 4);
+            }
+        }
+
+        void bc4Palette(uint8_t a0, uint8_t a1, uint8_t palette[8]) {
+            palette[0] = a0;
+            palette[1] = a1;
+            if (a0 > a1) {
+                for (int i = 2; i < 8; i++) palette[i] = static_cast<uint8_t>(((8 - i) * a0 + (i - 1) * a1) / 7);
+            }
+            else {
+                for (int i = 2; i < 6; i++) palette[i] = static_cast<uint8_t>(((6 - i) * a0 + (i - 1) * a1) / 5);
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        void encodeBc4(const Block& block, uint32_t channel, uint8_t* out) {
+            uint8_t lo = 255, hi = 0;
+            for (const auto& texel : block) {
+                lo = std::min(lo, texel[channel]);
+                hi = std::max(hi, texel[channel]);
+            }
+
+            uint8_t palette[8];
+            bc4Palette(hi, lo, palette);
+
+            uint64_t indices = 0;
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t best = 0, bestDistance = UINT32_MAX;
+                for (uint32_t p = 0; p < 8; p++) {
+                    uint32_t distance = colorDistance(&block[i][channel], &palette[p], 1);
+                    if (distance < bestDistance) {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+                indices |= uint64_t(best) << (3 * i);
+            }
+
+            out[0] = hi;
+            out[1] = lo;
+            for (int i = 0; i < 6; i++) out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+
+        void decodeBc4(const uint8_t* in, uint32_t channel, Block& block) {
+            uint8_t palette[8];
+            bc4Palette(in[0], in[1], palette);
+            uint64_t indices = 0;
+            for (int i = 0; i < 6; i++) indices |= uint64_t(in[2 + i]) << (8 * i);
+            for (uint32_t i = 0; i < 16; i++) {
+                block[i][channel] = palette[(indices >> (3 * i)) & 7];
+            }
+        }
+
+        // Mode 6: one subset, RGBA endpoints at 7 bits plus a p-bit each, 4-bit indices
+        void encodeBc7(const Block& block, uint8_t* out) {
+            float e[2][4];
+            principalEndpoints(block, 4, e[0], e[1]);
+
+            uint8_t endpoints[2][4];
+            uint32_t quantized[2][4];
+            uint32_t pbits[2];
+            for (int endpoint = 0; endpoint < 2; endpoint++) {
+                float bestError = INFINITY;
+                for (uint32_t p = 0; p < 2; p++) {
+                    float error = 0.0f;
+                    uint32_t q[4];
+                    for (int c = 0; c < 4; c++) {
+                        q[c] = static_cast<uint32_t>(std::clamp(std::round((e[endpoint][c] - p) / 2.0f), 0.0f, 127.0f));
+                        float d = float((q[c] << 1) | p) - e[endpoint][c];
+                        error += d * d;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        pbits[endpoint] = p;
+                        for (int c = 0; c < 4; c++) {
+                            quantized[endpoint][c] = q[c];
+                            endpoints[endpoint][c] = static_cast<uint8_t>((q[c] << 1) | p);
+                        }
+                    }
+                }
+            }
+
+            uint8_t palette[16][4];
+            for (int i = 0; i < 16; i++) {
+                for (int c = 0; c < 4; c++) palette[i][c] = interpolateBc7(endpoints[0][c], endpoints[1][c], BC7_WEIGHTS4[i]);
+            }
+
+            uint32_t indices[16];
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t bestDistance = UINT32_MAX;
+                for (uint32_t p = 0; p < 16; p++) {
+                    uint32_t distance = colorDistance(block[i].data(), palette[p], 4);
+                    if (distance < bestDistance) {
+                        indices[i] = p;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            // the anchor index drops its top bit, so the first texel must sit in the lower half
+            if (indices[0] & 8) {
+                std::swap(quantized[0], quantized[1]);
+                std::swap(pbits[0], pbits[1]);
+                for (uint32_t& index : indices) index = 15 - index;
+            }
+
+            std::memset(out, 0, 16);
+            BitWriter writer{out};
+            writer.write(1u << 6, 7);
+            for (int c = 0; c < 4; c++) {
+                writer.write(quantized[0][c], 7);
+                writer.write(quantized[1][c], 7);
+            }
+            writer.write(pbits[0], 1);
+            writer.write(pbits[1], 1);
+            writer.write(indices[0], 3);
+            for (uint32_t i = 1; i < 16; i++) writer.write(indices[i], 4);
+        }
+
+        uint8_t expandBits(uint32_t value, uint32_t bits) {
+            value <<= 8 - bits;
+            return static_cast<uint8_t>(value | (value >> bits));
+        }
+
+        // the mode is the number of zero bits before the first set one; 8 is reserved
+        uint32_t bc7Mode(const uint8_t* in) {
+            uint32_t mode = 0;
+            while (mode < 8 && !(in[0] & (1u << mode))) mode++;
+            return mode;
+        }
+
+        bool decodeBc7(const uint8_t* in, Block& block) {
+            uint32_t mode = bc7Mode(in);
+
+            BitReader reader{in};
+            reader.read(mode + 1);
+
+            if (mode == 8) {
+                // reserved encoding decodes to transparent black
+                for (auto& texel : block) texel = {0, 0, 0, 0};
+                return true;
+            }
+            if (mode != 4 && mode != 5 && mode != 6) {
+                return false;
+            }
+
+            uint32_t rotation = 0, indexMode = 0;
+            uint32_t colorBits = 7, alphaBits = 7;
+            if (mode == 4) {
+                rotation = reader.read(2);
+                indexMode = reader.read(1);
+                colorBits = 5;
+                alphaBits = 6;
+            }
+            else if (mode == 5) {
+                rotation = reader.read(2);
+                alphaBits = 8;
+            }
+
+            uint32_t raw[2][4];
+            for (int c = 0; c < 3; c++) {
+                raw[0][c] = reader.read(colorBits);
+                raw[1][c] = reader.read(colorBits);
+            }
+            raw[0][3] = reader.read(alphaBits);
+            raw[1][3] = reader.read(alphaBits);
+
+            uint8_t endpoints[2][4];
+            if (mode == 6) {
+                uint32_t p0 = reader.read(1), p1 = reader.read(1);
+                for (int c = 0; c < 4; c++) {
+                    endpoints[0][c] = static_cast<uint8_t>((raw[0][c] << 1) | p0);
+                    endpoints[1][c] = static_cast<uint8_t>((raw[1][c] << 1) | p1);
+                }
+            }
+            else {
+                for (int e = 0; e < 2; e++) {
+                    for (int c = 0; c < 3; c++) endpoints[e][c] = expandBits(raw[e][c], colorBits);
+                    endpoints[e][3] = expandBits(raw[e][3], alphaBits);
+                }
+            }
+
+            // primary index set, then for modes 4 and 5 a second one
+            uint32_t primaryBits = mode == 6 ? 4 : 2;
+            uint32_t secondaryBits = mode == 4 ? 3 : 2;
+            uint32_t primary[16], secondary[16] = {};
+            for (uint32_t i = 0; i < 16; i++) primary[i] = reader.read(i == 0 ? primaryBits - 1 : primaryBits);
+            if (mode != 6) {
+                for (uint32_t i = 0; i < 16; i++) secondary[i] = reader.read(i == 0 ? secondaryBits - 1 : secondaryBits);
+            }
+
+            auto weight = [](uint32_t bits, uint32_t index) {
+                return bits == 2 ? BC7_WEIGHTS2[index] : bits == 3 ? BC7_WEIGHTS3[index] : BC7_WEIGHTS4[index];
+            };
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint8_t colorWeight, alphaWeight;
+                if (mode == 6) {
+                    colorWeight = alphaWeight = weight(4, primary[i]);
+                }
+                else if (mode == 4 && indexMode == 1) {
+                    colorWeight = weight(3, secondary[i]);
+                    alphaWeight = weight(2, primary[i]);
+                }
+                else {
+                    colorWeight = weight(2, primary[i]);
+                    alphaWeight = weight(secondaryBits, secondary[i]);
+                }
+
+                auto& texel = block[i];
+                for (int c = 0; c < 3; c++) texel[c] = interpolateBc7(endpoints[0][c], endpoints[1][c], colorWeight);
+                texel[3] = interpolateBc7(endpoints[0][3], endpoints[1][3], alphaWeight);
+                if (rotation > 0) {
+                    std::swap(texel[3], texel[rotation - 1]);
+                }
+            }
+            return true;
+        }
+
+    }
+
+    bool isBlockCompressed(VkFormat format) {
+        return std::find(std::begin(BLOCK_COMPRESSED_FORMATS), std::end(BLOCK_COMPRESSED_FORMATS), format) !=
+               std::end(BLOCK_COMPRESSED_FORMATS);
+    }
+
+    uint32_t formatBlockBytes(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                return 8;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return 16;
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
+    size_t levelByteSize(VkFormat format, uint32_t width, uint32_t height) {
+        if (isBlockCompressed(format)) {
+            return size_t((width + 3) / 4) * ((height + 3) / 4) * formatBlockBytes(format);
+        }
+        return size_t(width) * height * formatBlockBytes(format);
+    }
+
+    VkFormat decompressedFormat(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            default:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    bool compressImage(const ImageData& source, VkFormat format, ImageData& result, std::string& error) {
+        if (formatBlockBytes(source.format) != 4 || isBlockCompressed(source.format)) {
+            error = "compression source must be RGBA8";
+            return false;
+        }
+        if (!isBlockCompressed(format)) {
+            error = "unsupported block compression target format";
+            return false;
+        }
+
+        const uint32_t blockBytes = formatBlockBytes(format);
+        result = {};
+        result.format = format;
+        result.width = source.width;
+        result.height = source.height;
+
+        for (const ImageData::Level& level : source.levels) {
+            size_t offset = result.data.size();
+            size_t size = levelByteSize(format, level.width, level.height);
+            result.levels.push_back({offset, size, level.width, level.height});
+            result.data.resize(offset + size);
+
+            const uint8_t* pixels = source.data.data() + level.offset;
+            uint8_t* out = result.data.data() + offset;
+            uint32_t blocksX = (level.width + 3) / 4;
+            uint32_t blocksY = (level.height + 3) / 4;
+            Block block;
+            for (uint32_t by = 0; by < blocksY; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++, out += blockBytes) {
+                    fetchBlock(pixels, level.width, level.height, bx, by, block);
+                    switch (format) {
+                        case VK_FORMAT_BC3_UNORM_BLOCK:
+                        case VK_FORMAT_BC3_SRGB_BLOCK:
+                            encodeBc4(block, 3, out);
+                            encodeBc1(block, out + 8);
+                            break;
+                        case VK_FORMAT_BC5_UNORM_BLOCK:
+                            encodeBc4(block, 0, out);
+                            encodeBc4(block, 1, out + 8);
+                            break;
+                        case VK_FORMAT_BC7_UNORM_BLOCK:
+                        case VK_FORMAT_BC7_SRGB_BLOCK:
+                            encodeBc7(block, out);
+                            break;
+                        default:
+                            encodeBc1(block, out);
+                            break;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool decompressImage(ImageData& image, std::string& error) {
+        if (!isBlockCompressed(image.format)) {
+            return true;
+        }
+
+        const VkFormat format = image.format;
+        const uint32_t blockBytes = formatBlockBytes(format);
+        ImageData result;
+        result.format = decompressedFormat(format);
+        result.width = image.width;
+        result.height = image.height;
+
+        for (const ImageData::Level& level : image.levels) {
+            size_t offset = result.data.size();
+            size_t size = size_t(level.width) * level.height * 4;
+            result.levels.push_back({offset, size, level.width, level.height});
+            result.data.resize(offset + size);
+
+            const uint8_t* in = image.data.data() + level.offset;
+            uint8_t* pixels = result.data.data() + offset;
+            uint32_t blocksX = (level.width + 3) / 4;
+            uint32_t blocksY = (level.height + 3) / 4;
+            Block block;
+            for (uint32_t by = 0; by < blocksY; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++, in += blockBytes) {
+                    switch (format) {
+                        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                            decodeBc1(in, false, false, block);
+                            break;
+                        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                            decodeBc1(in, false, true, block);
+                            break;
+                        case VK_FORMAT_BC3_UNORM_BLOCK:
+                        case VK_FORMAT_BC3_SRGB_BLOCK:
+                            decodeBc1(in + 8, true, false, block);
+                            decodeBc4(in, 3, block);
+                            break;
+                        case VK_FORMAT_BC5_UNORM_BLOCK:
+                            for (auto& texel : block) texel = {0, 0, 0, 255};
+                            decodeBc4(in, 0, block);
+                            decodeBc4(in + 8, 1, block);
+                            break;
+                        default:
+                            if (!decodeBc7(in, block)) {
+                                error = "unsupported BC7 mode " + std::to_string(bc7Mode(in)) +
+                                        " without device BC support (the CPU fallback decodes modes 4-6 only)";
+                                return false;
+                            }
+                            break;
+                    }
+                    storeBlock(block, pixels, level.width, level.height, bx, by);
+                }
+            }
+        }
+
+        image = std::move(result);
+        return true;
+    }
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "image_loader.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+namespace VKEngine {
+
+    // BC1/BC3/BC5/BC7 block formats, in the order they are checked for device support
+    inline constexpr VkFormat BLOCK_COMPRESSED_FORMATS[] = {
+        VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+        VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+        VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK,
+        VK_FORMAT_BC5_UNORM_BLOCK,
+        VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK,
+    };
+
+    bool isBlockCompressed(VkFormat format);
+
+    // Bytes per 4x4 block, or per texel for the uncompressed RGBA8 formats; 0 for anything else
+    uint32_t formatBlockBytes(VkFormat format);
+
+    // Byte size of one level of the given extent
+    size_t levelByteSize(VkFormat format, uint32_t width, uint32_t height);
+
+    // RGBA8 format a block format expands to, keeping the sRGB encoding
+    VkFormat decompressedFormat(VkFormat format);
+
+    // Encodes every level of an RGBA8 image. BC7 output uses the single-subset mode 6 only,
+    // which keeps the encoder simple at some quality cost on blocks with several distinct colours.
+    bool compressImage(const ImageData& source, VkFormat format, ImageData& result, std::string& error);
+
+    // Expands every level of a block compressed image to RGBA8 in place, for devices that cannot
+    // sample BC formats. BC7 decodes modes 4-6, which covers the texture cooker's output; images
+    // from other encoders that use the partitioned modes (0-3, 7) fail with "unsupported BC7 mode".
+    bool decompressImage(ImageData& image, std::string& error);
+
+}
@@ -0,0 +1,241 @@
+#include "cpu_culling.h"
+#include "frustum.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VKENGINE_CULLING_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace VKEngine {
+
+    namespace {
+
+#if defined(__AVX__)
+        constexpr uint32_t SIMD_WIDTH = 8;
+#else
+        constexpr uint32_t SIMD_WIDTH = 4;
+#endif
+
+        size_t paddedCount(size_t count) {
+            return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+        }
+
+    }
+
+    uint32_t CpuCulling::addObject(Model* model, const glm::mat4& transform) {
+        assert(model != nullptr && "Cannot add a culling object without a model.");
+
+        uint32_t index = objectCount();
+        m_models.push_back(model);
+        m_transforms.push_back(transform);
+        m_lods.push_back(0);
+
+        size_t padded = paddedCount(m_models.size());
+        m_centerX.resize(padded, 0.0f);
+        m_centerY.resize(padded, 0.0f);
+        m_centerZ.resize(padded, 0.0f);
+        m_radius.resize(padded, -FLT_MAX);
+
+        setTransform(index, transform);
+        return index;
+    }
+
+    void CpuCulling::setTransform(uint32_t objectIndex, const glm::mat4& transform) {
+        assert(objectIndex < objectCount() && "Culling object index out of range.");
+        const auto& bounds = m_models[objectIndex]->getBoundingSphere();
+        m_transforms[objectIndex] = transform;
+
+        glm::vec4 center = transform * glm::vec4(bounds.center, 1.0f);
+        float maxScale = std::max({glm::length(glm::vec3(transform[0])),
+                                   glm::length(glm::vec3(transform[1])),
+                                   glm::length(glm::vec3(transform[2]))});
+
+        m_centerX[objectIndex] = center.x;
+        m_centerY[objectIndex] = center.y;
+        m_centerZ[objectIndex] = center.z;
+        m_radius[objectIndex] = bounds.radius * maxScale;
+    }
+
+    void CpuCulling::clearObjects() {
+        m_models.clear();
+        m_transforms.clear();
+        m_centerX.clear();
+        m_centerY.clear();
+        m_centerZ.clear();
+        m_radius.clear();
+        m_lods.clear();
+        m_visible.clear();
+    }
+
+    void CpuCulling::cull(const glm::mat4& viewProj, const glm::vec3& cameraPosition, float maxDistance) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        glm::vec4 planes[6];
+        extractFrustumPlanes(viewProj, planes);
+
+        const uint32_t count = objectCount();
+        const uint32_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        m_chunkVisible.resize(static_cast<size_t>(chunkCount) * CHUNK_SIZE);
+        m_chunkCounts.assign(chunkCount, 0);
+
+        JobSystem::shared().parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                cullChunk(static_cast<uint32_t>(chunk), planes, cameraPosition, maxDistance);
+            }
+        });
+
+        // stitch the per-chunk lists together, keeping ascending object order
+        m_visible.clear();
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+            const uint32_t* first = m_chunkVisible.data() + static_cast<size_t>(chunk) * CHUNK_SIZE;
+            m_visible.insert(m_visible.end(), first, first + m_chunkCounts[chunk]);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        m_stats.objects = count;
+        m_stats.visible = static_cast<uint32_t>(m_visible.size());
+        m_stats.culled = count - m_stats.visible;
+        m_stats.cullMicros = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    void CpuCulling::selectLods(const glm::vec3& cameraPosition, float lodScale) {
+        std::atomic<uint32_t> triangles{0};
+        JobSystem::shared().parallelFor(m_visible.size(), CHUNK_SIZE, [&](size_t begin, size_t end) {
+            uint32_t batchTriangles = 0;
+            for (size_t i = begin; i < end; i++) {
+                uint32_t object = m_visible[i];
+                glm::vec3 center(m_centerX[object], m_centerY[object], m_centerZ[object]);
+                float distance = glm::length(center - cameraPosition) - m_radius[object];
+
+                const Model& model = *m_models[object];
+                m_lods[object] = model.selectLod(distance, lodScale, m_lods[object]);
+                batchTriangles += model.getLod(m_lods[object]).indexCount / 3;
+            }
+            triangles.fetch_add(batchTriangles, std::memory_order_relaxed);
+        });
+        m_stats.triangles = triangles.load(std::memory_order_relaxed);
+    }
+
+    void CpuCulling::cullChunk(uint32_t chunk, const glm::vec4 planes[6], const glm::vec3& cameraPosition, float maxDistance) {
+        const uint32_t begin = chunk * CHUNK_SIZE;
+        const uint32_t end = static_cast<uint32_t>(std::min<size_t>(begin + CHUNK_SIZE, m_radius.size()));
+        const bool testDistance = std::isfinite(maxDistance);
+
+        uint32_t* out = m_chunkVisible.data() + begin;
+        uint32_t visible = 0;
+
+#if defined(__AVX__)
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++) {
+            planeX[p] = _mm256_set1_ps(planes[p].x);
+            planeY[p] = _mm256_set1_ps(planes[p].y);
+            planeZ[p] = _mm256_set1_ps(planes[p].z);
+            planeW[p] = _mm256_set1_ps(planes[p].w);
+        }
+        const __m256 cameraX = _mm256_set1_ps(cameraPosition.x);
+        const __m256 cameraY = _mm256_set1_ps(cameraPosition.y);
+        const __m256 cameraZ = _mm256_set1_ps(cameraPosition.z);
+        const __m256 distance = _mm256_set1_ps(maxDistance);
+
+        for (uint32_t i = begin; i < end; i += 8) {
+            __m256 x = _mm256_loadu_ps(&m_centerX[i]);
+            __m256 y = _mm256_loadu_ps(&m_centerY[i]);
+            __m256 z = _mm256_loadu_ps(&m_centerZ[i]);
+            __m256 r = _mm256_loadu_ps(&m_radius[i]);
+            __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m256 d = _mm256_add_ps(_mm256_mul_ps(planeX[p], x), planeW[p]);
+                d = _mm256_add_ps(d, _mm256_mul_ps(planeY[p], y));
+                d = _mm256_add_ps(d, _mm256_mul_ps(planeZ[p], z));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GT_OQ));
+            }
+            if (testDistance) {
+                __m256 dx = _mm256_sub_ps(x, cameraX);
+                __m256 dy = _mm256_sub_ps(y, cameraY);
+                __m256 dz = _mm256_sub_ps(z, cameraZ);
+                __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+                __m256 reach = _mm256_add_ps(distance, r);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(lengthSq, _mm256_mul_ps(reach, reach), _CMP_LE_OQ));
+            }
+
+            int mask = _mm256_movemask_ps(inside);
+            for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) out[visible++] = i + lane;
+            }
+        }
+#elif defined(VKENGINE_CULLING_SSE)
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++) {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+        }
+        const __m128 cameraX = _mm_set1_ps(cameraPosition.x);
+        const __m128 cameraY = _mm_set1_ps(cameraPosition.y);
+        const __m128 cameraZ = _mm_set1_ps(cameraPosition.z);
+        const __m128 distance = _mm_set1_ps(maxDistance);
+
+        for (uint32_t i = begin; i < end; i += 4) {
+            __m128 x = _mm_loadu_ps(&m_centerX[i]);
+            __m128 y = _mm_loadu_ps(&m_centerY[i]);
+            __m128 z = _mm_loadu_ps(&m_centerZ[i]);
+            __m128 r = _mm_loadu_ps(&m_radius[i]);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m128 d = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+                d = _mm_add_ps(d, _mm_mul_ps(planeY[p], y));
+                d = _mm_add_ps(d, _mm_mul_ps(planeZ[p], z));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, negR));
+            }
+            if (testDistance) {
+                __m128 dx = _mm_sub_ps(x, cameraX);
+                __m128 dy = _mm_sub_ps(y, cameraY);
+                __m128 dz = _mm_sub_ps(z, cameraZ);
+                __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 reach = _mm_add_ps(distance, r);
+                inside = _mm_and_ps(inside, _mm_cmple_ps(lengthSq, _mm_mul_ps(reach, reach)));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            if (mask & 1) out[visible++] = i;
+            if (mask & 2) out[visible++] = i + 1;
+            if (mask & 4) out[visible++] = i + 2;
+            if (mask & 8) out[visible++] = i + 3;
+        }
+#else
+        for (uint32_t i = begin; i < end; i++) {
+            glm::vec3 center(m_centerX[i], m_centerY[i], m_centerZ[i]);
+            float radius = m_radius[i];
+
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w > -radius;
+            }
+            if (inside && testDistance) {
+                glm::vec3 offset = center - cameraPosition;
+                float reach = maxDistance + radius;
+                inside = glm::dot(offset, offset) <= reach * reach;
+            }
+            if (inside) {
+                out[visible++] = i;
+            }
+        }
+#endif
+        m_chunkCounts[chunk] = visible;
+    }
+
+}
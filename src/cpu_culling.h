@@ -0,0 +1,60 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace VKEngine {
+
+    // CPU culling stage for the non-indirect draw path. World-space bounding spheres are kept as
+    // structure-of-arrays and tested against the frustum planes and an optional view distance four
+    // (SSE) or eight (AVX) at a time, with fixed-size chunks spread across the shared JobSystem.
+    // The result is a compact, ascending list of visible object indices.
+    class CpuCulling {
+    public:
+        struct Stats {
+            uint32_t objects = 0;
+            uint32_t visible = 0;
+            uint32_t culled = 0;
+            uint32_t triangles = 0;   // submitted by the visible objects at their selected LOD
+            double cullMicros = 0.0;
+        };
+
+        uint32_t addObject(Model* model, const glm::mat4& transform);
+        void setTransform(uint32_t objectIndex, const glm::mat4& transform);
+        void clearObjects();
+        uint32_t objectCount() const { return static_cast<uint32_t>(m_models.size()); }
+        Model* getModel(uint32_t objectIndex) const { return m_models[objectIndex]; }
+        const glm::mat4& getTransform(uint32_t objectIndex) const { return m_transforms[objectIndex]; }
+
+        // maxDistance limits how far from cameraPosition an object's sphere may start
+        void cull(const glm::mat4& viewProj, const glm::vec3& cameraPosition,
+                  float maxDistance = std::numeric_limits<float>::infinity());
+
+        // Updates the LOD of every visible object, with hysteresis against the previous choice
+        void selectLods(const glm::vec3& cameraPosition, float lodScale);
+
+        const std::vector<uint32_t>& getVisibleObjects() const { return m_visible; }
+        uint32_t getLod(uint32_t objectIndex) const { return m_lods[objectIndex]; }
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        static constexpr uint32_t CHUNK_SIZE = 1024;  // multiple of the SIMD width
+
+        void cullChunk(uint32_t chunk, const glm::vec4 planes[6], const glm::vec3& cameraPosition, float maxDistance);
+
+        std::vector<Model*> m_models;
+        std::vector<glm::mat4> m_transforms;
+        // world-space spheres, padded to the SIMD width with spheres that never pass the test
+        std::vector<float> m_centerX, m_centerY, m_centerZ, m_radius;
+        std::vector<uint32_t> m_lods;
+
+        std::vector<uint32_t> m_chunkVisible;  // CHUNK_SIZE slots per chunk
+        std::vector<uint32_t> m_chunkCounts;
+        std::vector<uint32_t> m_visible;
+        Stats m_stats;
+    };
+
+}
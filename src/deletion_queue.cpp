@@ -0,0 +1,84 @@
+#include "deletion_queue.h"
+
+#include <stdexcept>
+
+namespace VKEngine {
+
+    DeletionQueue::~DeletionQueue() {
+        flush();
+        for (VkFence fence : m_freeFences) {
+            vkDestroyFence(m_device.device(), fence, nullptr);
+        }
+    }
+
+    void DeletionQueue::push(Deleter deleter) {
+        m_deleters.push_back({m_frame, std::move(deleter)});
+    }
+
+    void DeletionQueue::endFrame() {
+        // frames that queued nothing need no fence; later fences cover them anyway
+        if (!m_deleters.empty() && m_deleters.back().frame == m_frame) {
+            VkFence fence = acquireFence();
+            // an empty submission signals its fence once all previously submitted work has completed
+            if (vkQueueSubmit(m_device.graphicsQueue(), 0, nullptr, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit deletion queue fence!");
+            }
+            m_frameFences.push_back({m_frame, fence});
+        }
+        m_frame++;
+    }
+
+    void DeletionQueue::collect() {
+        while (!m_frameFences.empty() &&
+               vkGetFenceStatus(m_device.device(), m_frameFences.front().fence) == VK_SUCCESS) {
+            m_completedFrame = m_frameFences.front().frame;
+            vkResetFences(m_device.device(), 1, &m_frameFences.front().fence);
+            m_freeFences.push_back(m_frameFences.front().fence);
+            m_frameFences.pop_front();
+        }
+
+        while (!m_deleters.empty() && m_deleters.front().frame <= m_completedFrame) {
+            Entry entry = std::move(m_deleters.front());
+            m_deleters.pop_front();
+            entry.deleter();
+        }
+    }
+
+    void DeletionQueue::flush() {
+        if (!m_deleters.empty() || !m_frameFences.empty()) {
+            vkQueueWaitIdle(m_device.graphicsQueue());
+        }
+
+        for (const FrameFence& frameFence : m_frameFences) {
+            vkResetFences(m_device.device(), 1, &frameFence.fence);
+            m_freeFences.push_back(frameFence.fence);
+        }
+        m_frameFences.clear();
+        // the current frame may still submit work after this, so what it pushes later waits for endFrame()
+        m_completedFrame = m_frame - 1;
+
+        // deleters may push more work (e.g. an object owning other deferred objects)
+        while (!m_deleters.empty()) {
+            Entry entry = std::move(m_deleters.front());
+            m_deleters.pop_front();
+            entry.deleter();
+        }
+    }
+
+    VkFence DeletionQueue::acquireFence() {
+        if (!m_freeFences.empty()) {
+            VkFence fence = m_freeFences.back();
+            m_freeFences.pop_back();
+            return fence;
+        }
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create deletion queue fence!");
+        }
+        return fence;
+    }
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vk_device.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace VKEngine {
+
+    // Defers destruction of GPU resources until the graphics queue has finished every frame that
+    // could still reference them, instead of draining the device with vkDeviceWaitIdle.
+    //
+    // Everything pushed during a frame is tagged with that frame's number. endFrame(), called right
+    // after the frame's submit, puts a fence behind all work submitted so far; collect() polls those
+    // fences and runs the deleters of every frame they prove finished.
+    //
+    // Deleters may reference other objects, so owners must flush() the queue while those are alive.
+    class DeletionQueue {
+    public:
+        using Deleter = std::function<void()>;
+
+        explicit DeletionQueue(Device& device) : m_device(device) {}
+        ~DeletionQueue();
+
+        DeletionQueue(const DeletionQueue&) = delete;
+        DeletionQueue &operator=(const DeletionQueue&) = delete;
+
+        void push(Deleter deleter);
+
+        // Takes ownership of an object whose destructor releases GPU resources synchronously
+        template <typename T>
+        void push(std::unique_ptr<T> object) {
+            if (object) {
+                std::shared_ptr<T> owned = std::move(object);
+                push([owned]() mutable { owned.reset(); });
+            }
+        }
+
+        void endFrame();
+
+        // Never blocks; runs deleters of frames the GPU has completed
+        void collect();
+
+        // Waits for the graphics queue to go idle and runs every deleter
+        void flush();
+
+        uint64_t currentFrame() const { return m_frame; }
+        uint64_t completedFrame() const { return m_completedFrame; }
+        size_t pendingCount() const { return m_deleters.size(); }
+
+    private:
+        struct Entry {
+            uint64_t frame;
+            Deleter deleter;
+        };
+
+        struct FrameFence {
+            uint64_t frame;
+            VkFence fence;
+        };
+
+        VkFence acquireFence();
+
+        Device& m_device;
+        std::deque<Entry> m_deleters;
+        std::deque<FrameFence> m_frameFences;
+        std::vector<VkFence> m_freeFences;
+        uint64_t m_frame = 1;
+        uint64_t m_completedFrame = 0;
+    };
+
+}
@@ -0,0 +1,311 @@
+#include "descriptors.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    // ---------------------------------------------------------------- DescriptorLayoutCache
+
+    DescriptorLayoutCache::~DescriptorLayoutCache() {
+        for (auto& [key, layout] : m_layouts) {
+            vkDestroyDescriptorSetLayout(m_device.device(), layout, nullptr);
+        }
+    }
+
+    VkDescriptorSetLayout DescriptorLayoutCache::getLayout(
+        std::vector<VkDescriptorSetLayoutBinding> bindings,
+        VkDescriptorSetLayoutCreateFlags flags,
+        std::vector<VkDescriptorBindingFlags> bindingFlags) {
+        assert((bindingFlags.empty() || bindingFlags.size() == bindings.size()) && "Need one binding flag per binding.");
+
+        // sort by binding number so declaration order does not matter; binding flags follow their binding
+        std::vector<size_t> order(bindings.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+            assert(bindings[i].pImmutableSamplers == nullptr && "Immutable samplers are not supported by the layout cache.");
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+        LayoutKey key;
+        key.flags = flags;
+        key.bindings.reserve(bindings.size());
+        for (size_t index : order) {
+            key.bindings.push_back(bindings[index]);
+            if (!bindingFlags.empty()) {
+                key.bindingFlags.push_back(bindingFlags[index]);
+            }
+        }
+
+        auto it = m_layouts.find(key);
+        if (it != m_layouts.end()) {
+            return it->second;
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        flagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+        flagsInfo.pBindingFlags = key.bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = key.bindingFlags.empty() ? nullptr : &flagsInfo;
+        layoutInfo.flags = flags;
+        layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+        layoutInfo.pBindings = key.bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(m_device.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        m_layouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const {
+        if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags) {
+            return false;
+        }
+        for (size_t i = 0; i < bindings.size(); i++) {
+            const auto& a = bindings[i];
+            const auto& b = other.bindings[i];
+            if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+                a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const {
+        auto combine = [](size_t seed, size_t value) { return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2)); };
+
+        size_t hash = std::hash<uint32_t>()(key.flags);
+        for (const auto& binding : key.bindings) {
+            size_t packed = binding.binding | (size_t(binding.descriptorType) << 8) | (size_t(binding.stageFlags) << 16);
+            hash = combine(hash, packed);
+            hash = combine(hash, binding.descriptorCount);
+        }
+        for (VkDescriptorBindingFlags flags : key.bindingFlags) {
+            hash = combine(hash, flags);
+        }
+        return hash;
+    }
+
+    // ---------------------------------------------------------------- DescriptorAllocator
+
+    DescriptorAllocator::~DescriptorAllocator() {
+        for (VkDescriptorPool pool : m_usedPools) {
+            vkDestroyDescriptorPool(m_device.device(), pool, nullptr);
+        }
+        for (VkDescriptorPool pool : m_freePools) {
+            vkDestroyDescriptorPool(m_device.device(), pool, nullptr);
+        }
+    }
+
+    VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+        if (m_currentPool == VK_NULL_HANDLE) {
+            m_currentPool = grabPool();
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_currentPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(m_device.device(), &allocInfo, &set);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+            // the full pool stays in m_usedPools until the next reset
+            m_currentPool = grabPool();
+            allocInfo.descriptorPool = m_currentPool;
+            result = vkAllocateDescriptorSets(m_device.device(), &allocInfo, &set);
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+        return set;
+    }
+
+    void DescriptorAllocator::resetPools() {
+        for (VkDescriptorPool pool : m_usedPools) {
+            vkResetDescriptorPool(m_device.device(), pool, 0);
+            m_freePools.push_back(pool);
+        }
+        m_usedPools.clear();
+        m_currentPool = VK_NULL_HANDLE;
+    }
+
+    VkDescriptorPool DescriptorAllocator::grabPool() {
+        VkDescriptorPool pool;
+        if (!m_freePools.empty()) {
+            pool = m_freePools.back();
+            m_freePools.pop_back();
+        }
+        else {
+            // every new pool is larger than the last, so a heavy frame settles on a few big pools
+            pool = createPool(m_nextPoolSize);
+            m_nextPoolSize = std::min(m_nextPoolSize * 2, MAX_SETS_PER_POOL);
+        }
+        m_usedPools.push_back(pool);
+        return pool;
+    }
+
+    VkDescriptorPool DescriptorAllocator::createPool(uint32_t maxSets) {
+        // average descriptors per set, by type
+        constexpr std::array<std::pair<VkDescriptorType, uint32_t>, 5> ratios = {{
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+        }};
+
+        std::array<VkDescriptorPoolSize, ratios.size()> poolSizes = {};
+        for (size_t i = 0; i < ratios.size(); i++) {
+            poolSizes[i].type = ratios[i].first;
+            poolSizes[i].descriptorCount = ratios[i].second * maxSets;
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(m_device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        return pool;
+    }
+
+    // ---------------------------------------------------------------- BindlessDescriptors
+
+    BindlessDescriptors::BindlessDescriptors(Device& device, DescriptorLayoutCache& layoutCache)
+        : m_device(device) {
+        assert(isSupported(device) && "Bindless descriptors need descriptor indexing.");
+
+        m_textureCapacity = std::max(1u, std::min(MAX_TEXTURES, device.maxBindlessSampledImages()));
+        m_bufferCapacity = std::max(1u, std::min(MAX_BUFFERS, device.maxBindlessStorageBuffers()));
+        m_textureSlots.capacity = m_textureCapacity;
+        m_bufferSlots.capacity = m_bufferCapacity;
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+        bindings[0].binding = TEXTURE_BINDING;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = m_textureCapacity;
+        bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[1].binding = BUFFER_BINDING;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = m_bufferCapacity;
+        bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+        // slots may be empty, and slots no pending command buffer reads may be written at any time
+        VkDescriptorBindingFlags bindingFlags =
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        m_layout = layoutCache.getLayout(
+            bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, {bindingFlags, bindingFlags});
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+        poolSizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureCapacity};
+        poolSizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_bufferCapacity};
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        if (vkCreateDescriptorPool(m_device.device(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_layout;
+
+        if (vkAllocateDescriptorSets(m_device.device(), &allocInfo, &m_set) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+        }
+    }
+
+    BindlessDescriptors::~BindlessDescriptors() {
+        // the layout belongs to the cache
+        vkDestroyDescriptorPool(m_device.device(), m_pool, nullptr);
+    }
+
+    uint32_t BindlessDescriptors::registerTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout) {
+        uint32_t index = m_textureSlots.acquire();
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler = sampler;
+        imageInfo.imageView = imageView;
+        imageInfo.imageLayout = layout;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_set;
+        write.dstBinding = TEXTURE_BINDING;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessDescriptors::registerBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+        uint32_t index = m_bufferSlots.acquire();
+
+        VkDescriptorBufferInfo bufferInfo = {buffer, offset, range};
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_set;
+        write.dstBinding = BUFFER_BINDING;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+        return index;
+    }
+
+    void BindlessDescriptors::releaseTexture(uint32_t index) {
+        m_textureSlots.release(index);
+    }
+
+    void BindlessDescriptors::releaseBuffer(uint32_t index) {
+        m_bufferSlots.release(index);
+    }
+
+    void BindlessDescriptors::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) {
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, BINDLESS_SET, 1, &m_set, 0, nullptr);
+    }
+
+    uint32_t BindlessDescriptors::SlotAllocator::acquire() {
+        if (!freeSlots.empty()) {
+            uint32_t index = freeSlots.back();
+            freeSlots.pop_back();
+            return index;
+        }
+        if (next >= capacity) {
+            throw std::runtime_error("bindless descriptor array is full!");
+        }
+        return next++;
+    }
+
+    void BindlessDescriptors::SlotAllocator::release(uint32_t index) {
+        assert(index < next && "Releasing a bindless slot that was never acquired.");
+        freeSlots.push_back(index);
+    }
+
+}
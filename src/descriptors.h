@@ -0,0 +1,134 @@
+#pragma once
+
+#include "vk_device.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace VKEngine {
+
+    // Deduplicates descriptor set layouts by their bindings, so identical layouts requested by
+    // different pipelines resolve to the same handle. Layouts live as long as the cache.
+    class DescriptorLayoutCache {
+    public:
+        explicit DescriptorLayoutCache(Device& device) : m_device(device) {}
+        ~DescriptorLayoutCache();
+
+        DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+        DescriptorLayoutCache &operator=(const DescriptorLayoutCache&) = delete;
+
+        // bindingFlags is either empty or has one entry per binding
+        VkDescriptorSetLayout getLayout(
+            std::vector<VkDescriptorSetLayoutBinding> bindings,
+            VkDescriptorSetLayoutCreateFlags flags = 0,
+            std::vector<VkDescriptorBindingFlags> bindingFlags = {});
+
+        size_t size() const { return m_layouts.size(); }
+
+    private:
+        struct LayoutKey {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            std::vector<VkDescriptorBindingFlags> bindingFlags;
+            VkDescriptorSetLayoutCreateFlags flags;
+
+            bool operator==(const LayoutKey& other) const;
+        };
+
+        struct LayoutKeyHash {
+            size_t operator()(const LayoutKey& key) const;
+        };
+
+        Device& m_device;
+        std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> m_layouts;
+    };
+
+    // Allocates descriptor sets from a growing list of pools. Pools that run out are retired until
+    // resetPools(), which recycles all of them at once; meant to be owned per frame in flight and
+    // reset after that frame's fence has signalled.
+    class DescriptorAllocator {
+    public:
+        explicit DescriptorAllocator(Device& device) : m_device(device) {}
+        ~DescriptorAllocator();
+
+        DescriptorAllocator(const DescriptorAllocator&) = delete;
+        DescriptorAllocator &operator=(const DescriptorAllocator&) = delete;
+
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+        void resetPools();
+
+        size_t poolCount() const { return m_usedPools.size() + m_freePools.size(); }
+
+    private:
+        static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        VkDescriptorPool grabPool();
+        VkDescriptorPool createPool(uint32_t maxSets);
+
+        Device& m_device;
+        VkDescriptorPool m_currentPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> m_usedPools;
+        std::vector<VkDescriptorPool> m_freePools;
+        uint32_t m_nextPoolSize = INITIAL_SETS_PER_POOL;
+    };
+
+    // One update-after-bind descriptor set holding large arrays of sampled images and storage
+    // buffers. Resources are registered once and addressed from shaders by index, so the set is
+    // bound once per command buffer and never per draw.
+    //
+    // GLSL side (set = BINDLESS_SET):
+    //   layout(set = 0, binding = 0) uniform sampler2D textures[];
+    //   layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+    class BindlessDescriptors {
+    public:
+        static constexpr uint32_t BINDLESS_SET = 0;
+        static constexpr uint32_t TEXTURE_BINDING = 0;
+        static constexpr uint32_t BUFFER_BINDING = 1;
+        static constexpr uint32_t MAX_TEXTURES = 16384;
+        static constexpr uint32_t MAX_BUFFERS = 4096;
+        static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+        BindlessDescriptors(Device& device, DescriptorLayoutCache& layoutCache);
+        ~BindlessDescriptors();
+
+        BindlessDescriptors(const BindlessDescriptors&) = delete;
+        BindlessDescriptors &operator=(const BindlessDescriptors&) = delete;
+
+        static bool isSupported(Device& device) { return device.supportsDescriptorIndexing(); }
+
+        // Returned indices stay valid until released; releasing a slot that an in-flight frame
+        // still reads is the caller's responsibility to avoid
+        uint32_t registerTexture(VkImageView imageView, VkSampler sampler,
+                                 VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        uint32_t registerBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        void releaseTexture(uint32_t index);
+        void releaseBuffer(uint32_t index);
+
+        void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+        VkDescriptorSetLayout getLayout() const { return m_layout; }
+        uint32_t textureCapacity() const { return m_textureCapacity; }
+        uint32_t bufferCapacity() const { return m_bufferCapacity; }
+
+    private:
+        struct SlotAllocator {
+            uint32_t next = 0;
+            uint32_t capacity = 0;
+            std::vector<uint32_t> freeSlots;
+
+            uint32_t acquire();
+            void release(uint32_t index);
+        };
+
+        Device& m_device;
+        VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+        VkDescriptorPool m_pool = VK_NULL_HANDLE;
+        VkDescriptorSet m_set = VK_NULL_HANDLE;
+        uint32_t m_textureCapacity = 0;
+        uint32_t m_bufferCapacity = 0;
+        SlotAllocator m_textureSlots;
+        SlotAllocator m_bufferSlots;
+    };
+
+}
@@ -0,0 +1,305 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    bool DynamicResolution::isSupported(Device& device, SwapChain& swapChain) {
+        if (!device.supportsTimestamps() || !swapChain.supportsTransferDst()) {
+            return false;
+        }
+        VkFormat format = swapChain.getSwapChainImageFormat();
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (device.getFormatProperties(format).optimalTilingFeatures & required) == required;
+    }
+
+    DynamicResolution::DynamicResolution(Device& device, DeletionQueue& deletionQueue, double targetGpuMillis)
+        : m_device(device), m_deletionQueue(deletionQueue) {
+        m_stats.targetMillis = targetGpuMillis;
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = QUERIES_PER_FRAME * SwapChain::MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateQueryPool(m_device.device(), &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+
+    DynamicResolution::~DynamicResolution() {
+        // the owner drains the device first
+        VkDevice device = m_device.device();
+        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyFramebuffer(device, m_framebuffers[i], nullptr);
+            vkDestroyImageView(device, m_colorViews[i], nullptr);
+            vkDestroyImage(device, m_colorImages[i], nullptr);
+            vkFreeMemory(device, m_colorMemory[i], nullptr);
+        }
+        vkDestroyRenderPass(device, m_renderPass, nullptr);
+        vkDestroyQueryPool(device, m_queryPool, nullptr);
+    }
+
+    void DynamicResolution::resize(SwapChain& swapChain) {
+        VkFormat colorFormat = swapChain.getSwapChainImageFormat();
+        VkFormat depthFormat = swapChain.findDepthFormat();
+        VkExtent2D extent = swapChain.getSwapChainExtent();
+        if (m_colorImages[0] != VK_NULL_HANDLE && colorFormat == m_colorFormat && depthFormat == m_depthFormat &&
+            extent.width == m_maxExtent.width && extent.height == m_maxExtent.height) {
+            return;
+        }
+        bool formatChanged = colorFormat != m_colorFormat || depthFormat != m_depthFormat;
+        m_colorFormat = colorFormat;
+        m_depthFormat = depthFormat;
+
+        retireTargets();
+        // same formats as the swapchain pass, so pipelines are only rebuilt when those change
+        if (!m_device.supportsDynamicRendering() && (formatChanged || m_renderPass == VK_NULL_HANDLE)) {
+            if (m_renderPass != VK_NULL_HANDLE) {
+                VkDevice device = m_device.device();
+                m_deletionQueue.push([device, renderPass = m_renderPass]() {
+                    vkDestroyRenderPass(device, renderPass, nullptr);
+                });
+            }
+            createRenderPass();
+        }
+        createTargets(swapChain);
+
+        m_stats.renderExtent = {
+            std::max(1u, static_cast<uint32_t>(m_maxExtent.width * m_scale)),
+            std::max(1u, static_cast<uint32_t>(m_maxExtent.height * m_scale))};
+    }
+
+    void DynamicResolution::createRenderPass() {
+        // the render graph owns the layout transitions, so the attachments stay in their attachment layouts
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = m_colorFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = m_depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scaled scene render pass!");
+        }
+    }
+
+    void DynamicResolution::createTargets(SwapChain& swapChain) {
+        m_maxExtent = swapChain.getSwapChainExtent();
+
+        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = {m_maxExtent.width, m_maxExtent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = m_colorFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorImages[i], m_colorMemory[i]);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = m_colorImages[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = m_colorFormat;
+            viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &m_colorViews[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create scaled scene image view!");
+            }
+
+            if (m_renderPass == VK_NULL_HANDLE) {
+                continue;
+            }
+            // the swapchain's depth capacity is at least its extent
+            std::array<VkImageView, 2> attachments = {m_colorViews[i], swapChain.getDepthImageView(i)};
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = m_renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = m_maxExtent.width;
+            framebufferInfo.height = m_maxExtent.height;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(m_device.device(), &framebufferInfo, nullptr, &m_framebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create scaled scene framebuffer!");
+            }
+        }
+    }
+
+    void DynamicResolution::retireTargets() {
+        // frames in flight may still render to or blit from them
+        VkDevice device = m_device.device();
+        m_deletionQueue.push([device, framebuffers = m_framebuffers, views = m_colorViews,
+                              images = m_colorImages, memory = m_colorMemory]() {
+            for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+                vkDestroyFramebuffer(device, framebuffers[i], nullptr);
+                vkDestroyImageView(device, views[i], nullptr);
+                vkDestroyImage(device, images[i], nullptr);
+                vkFreeMemory(device, memory[i], nullptr);
+            }
+        });
+        m_framebuffers = {};
+        m_colorViews = {};
+        m_colorImages = {};
+        m_colorMemory = {};
+    }
+
+    void DynamicResolution::beginFrame(VkCommandBuffer commandBuffer, size_t frameIndex) {
+        uint32_t firstQuery = static_cast<uint32_t>(frameIndex) * QUERIES_PER_FRAME;
+        if (m_queriesWritten[frameIndex]) {
+            std::array<uint64_t, QUERIES_PER_FRAME> timestamps{};
+            VkResult result = vkGetQueryPoolResults(
+                m_device.device(), m_queryPool, firstQuery, QUERIES_PER_FRAME,
+                sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            if (result == VK_SUCCESS) {
+                uint32_t validBits = m_device.timestampValidBits();
+                uint64_t mask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+                uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+                updateScale(static_cast<double>(ticks) * m_device.timestampPeriod() * 1e-6);
+            }
+        }
+
+        vkCmdResetQueryPool(commandBuffer, m_queryPool, firstQuery, QUERIES_PER_FRAME);
+        m_queriesWritten[frameIndex] = true;
+    }
+
+    void DynamicResolution::updateScale(double gpuMillis) {
+        m_stats.gpuMillis = gpuMillis;
+        if (gpuMillis <= 0.0) {
+            return;
+        }
+
+        // GPU time grows with the pixel count, i.e. with the square of the scale
+        float ideal = m_scale * static_cast<float>(std::sqrt(m_stats.targetMillis / gpuMillis));
+        if (ideal < m_scale) {
+            m_scale = ideal;
+        }
+        else if (gpuMillis < m_stats.targetMillis * RAISE_HEADROOM) {
+            m_scale += (ideal - m_scale) * RAISE_RATE;
+        }
+        m_scale = std::clamp(m_scale, MIN_SCALE, MAX_SCALE);
+
+        m_stats.scale = m_scale;
+        m_stats.renderExtent = {
+            std::max(1u, static_cast<uint32_t>(m_maxExtent.width * m_scale)),
+            std::max(1u, static_cast<uint32_t>(m_maxExtent.height * m_scale))};
+    }
+
+    void DynamicResolution::beginRendering(VkCommandBuffer commandBuffer, size_t frameIndex, VkImageView depthView,
+                                           const VkClearColorValue& clearColor) {
+        // starts once the pass may write color, i.e. after the acquire wait, so vsync stalls aren't
+        // counted as GPU work
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_queryPool,
+                            static_cast<uint32_t>(frameIndex) * QUERIES_PER_FRAME);
+
+        VkRect2D renderArea{{0, 0}, m_stats.renderExtent};
+        if (m_renderPass != VK_NULL_HANDLE) {
+            std::array<VkClearValue, 2> clearValues = {};
+            clearValues[0].color = clearColor;
+            clearValues[1].depthStencil = {1.0f, 0};
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = m_renderPass;
+            renderPassInfo.framebuffer = m_framebuffers[frameIndex];
+            renderPassInfo.renderArea = renderArea;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+            renderPassInfo.pClearValues = clearValues.data();
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            return;
+        }
+
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = m_colorViews[frameIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = clearColor;
+
+        VkRenderingAttachmentInfo depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = depthView;
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea = renderArea;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        m_device.cmdBeginRendering(commandBuffer, renderingInfo);
+    }
+
+    void DynamicResolution::endRendering(VkCommandBuffer commandBuffer, size_t frameIndex) {
+        if (m_renderPass != VK_NULL_HANDLE) {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+        else {
+            m_device.cmdEndRendering(commandBuffer);
+        }
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool,
+                            static_cast<uint32_t>(frameIndex) * QUERIES_PER_FRAME + 1);
+    }
+
+    void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, size_t frameIndex, VkImage target,
+                                          VkExtent2D targetExtent) {
+        assert(targetExtent.width <= m_maxExtent.width && targetExtent.height <= m_maxExtent.height &&
+               "Upscale target is larger than the scene target.");
+
+        VkImageBlit blit{};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        blit.srcOffsets[1] = {static_cast<int32_t>(m_stats.renderExtent.width),
+                              static_cast<int32_t>(m_stats.renderExtent.height), 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        blit.dstOffsets[1] = {static_cast<int32_t>(targetExtent.width), static_cast<int32_t>(targetExtent.height), 1};
+
+        vkCmdBlitImage(commandBuffer,
+                       m_colorImages[frameIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+    }
+
+}
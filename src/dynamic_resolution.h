@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vk_device.h"
+#include "vk_swapchain.h"
+#include "deletion_queue.h"
+
+#include <array>
+#include <cstdint>
+
+namespace VKEngine {
+
+    // Renders the scene into an offscreen target at a fraction of the output resolution and blits it
+    // up to the swapchain image. The target is allocated at the full output size and only the viewport
+    // shrinks, so changing the scale never reallocates.
+    //
+    // The scale is driven by GPU timestamps around the scene pass: a frame's timings are read back once
+    // its fence has signalled, and the scale moves towards the one that would hit the target GPU time.
+    // It drops at once when a frame runs over and climbs back slowly, so a load spike costs resolution
+    // for a few frames instead of a missed vblank.
+    class DynamicResolution {
+    public:
+        static constexpr float MIN_SCALE = 0.5f;
+        static constexpr float MAX_SCALE = 1.0f;
+
+        struct Stats {
+            float scale = MAX_SCALE;
+            VkExtent2D renderExtent = {0, 0};
+            double gpuMillis = 0.0;     // scene pass, last frame read back
+            double targetMillis = 0.0;
+        };
+
+        // Needs timestamps, a swapchain that can be blitted to and a color format that can be
+        // rendered to and linearly blitted from
+        static bool isSupported(Device& device, SwapChain& swapChain);
+
+        DynamicResolution(Device& device, DeletionQueue& deletionQueue, double targetGpuMillis);
+        ~DynamicResolution();
+
+        DynamicResolution(const DynamicResolution&) = delete;
+        DynamicResolution &operator=(const DynamicResolution&) = delete;
+
+        // (Re)creates the targets at the swapchain's size, reusing its per-frame depth images
+        void resize(SwapChain& swapChain);
+
+        // Reads back the timings of the frame that last used frameIndex (its fence has been waited on),
+        // updates the scale and starts timing this frame. Call right after vkBeginCommandBuffer.
+        void beginFrame(VkCommandBuffer commandBuffer, size_t frameIndex);
+
+        // Scene pass: the graph has already moved the color target and depth into attachment layouts
+        void beginRendering(VkCommandBuffer commandBuffer, size_t frameIndex, VkImageView depthView,
+                            const VkClearColorValue& clearColor);
+        void endRendering(VkCommandBuffer commandBuffer, size_t frameIndex);
+
+        // Scales the rendered region onto the whole target, which must be in TRANSFER_DST_OPTIMAL
+        void recordUpscale(VkCommandBuffer commandBuffer, size_t frameIndex, VkImage target, VkExtent2D targetExtent);
+
+        // Scene pipelines are built against this when dynamic rendering isn't used
+        VkRenderPass getRenderPass() const { return m_renderPass; }
+        VkImage getColorImage(size_t frameIndex) const { return m_colorImages[frameIndex]; }
+        VkExtent2D renderExtent() const { return m_stats.renderExtent; }
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        static constexpr uint32_t QUERIES_PER_FRAME = 2;
+        static constexpr float RAISE_RATE = 0.05f;     // fraction of the gap closed per frame when under budget
+        static constexpr float RAISE_HEADROOM = 0.85f;  // only raise when this far under the target
+
+        void createRenderPass();
+        void createTargets(SwapChain& swapChain);
+        void retireTargets();
+        void updateScale(double gpuMillis);
+
+        Device& m_device;
+        DeletionQueue& m_deletionQueue;
+        VkQueryPool m_queryPool = VK_NULL_HANDLE;
+        std::array<bool, SwapChain::MAX_FRAMES_IN_FLIGHT> m_queriesWritten{};
+
+        VkFormat m_colorFormat = VK_FORMAT_UNDEFINED;
+        VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+        VkExtent2D m_maxExtent = {0, 0};
+        VkRenderPass m_renderPass = VK_NULL_HANDLE;  // only without dynamic rendering
+        std::array<VkImage, SwapChain::MAX_FRAMES_IN_FLIGHT> m_colorImages{};
+        std::array<VkDeviceMemory, SwapChain::MAX_FRAMES_IN_FLIGHT> m_colorMemory{};
+        std::array<VkImageView, SwapChain::MAX_FRAMES_IN_FLIGHT> m_colorViews{};
+        std::array<VkFramebuffer, SwapChain::MAX_FRAMES_IN_FLIGHT> m_framebuffers{};
+
+        float m_scale = MAX_SCALE;
+        Stats m_stats;
+    };
+
+}
@@ -0,0 +1,236 @@
+#include "frame_capture.h"
+#include "image_writer.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace VKEngine {
+
+    namespace {
+
+        bool isBgra(VkFormat format) {
+            return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+        }
+
+        bool isRgba(VkFormat format) {
+            return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+        }
+
+    }
+
+    bool FrameCapture::isSupported(SwapChain& swapChain) {
+        VkFormat format = swapChain.getSwapChainImageFormat();
+        return swapChain.supportsTransferSrc() && (isBgra(format) || isRgba(format));
+    }
+
+    FrameCapture::FrameCapture(Device& device, const std::string& directory, Format format)
+        : m_device(device), m_directory(directory), m_format(format) {}
+
+    FrameCapture::~FrameCapture() {
+        // the owner drains the device first, so only the writer can still be using a slot
+        for (Slot& slot : m_slots) {
+            while (slot.state.load(std::memory_order_acquire) == SlotState::Writing) {
+                std::this_thread::yield();
+            }
+        }
+        for (Slot& slot : m_slots) {
+            destroySlot(slot);
+        }
+    }
+
+    void FrameCapture::start() {
+        if (m_recording) {
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+
+        m_recording = true;
+        LOG_INFO("capture started: " << m_directory << (m_format == Format::Png ? " (png)" : " (raw)"));
+        if (m_format == Format::Raw) {
+            std::string path = m_directory + "/capture.rgba";
+            m_writer.submit([this, path]() {
+                m_rawFile.open(path, std::ios::binary | std::ios::app);
+                if (!m_rawFile.is_open()) {
+                    LOG_ERROR("capture: failed to open " << path);
+                }
+            });
+        }
+    }
+
+    void FrameCapture::stop() {
+        if (!m_recording) {
+            return;
+        }
+        m_recording = false;
+        LOG_INFO("capture stopped after " << m_sequence << " frames (" << m_dropped << " dropped)");
+        if (m_format == Format::Raw) {
+            // queued behind the frames still being read back
+            m_writer.submit([this]() {
+                m_rawFile.close();
+            });
+        }
+    }
+
+    void FrameCapture::ensureCapacity(Slot& slot, VkDeviceSize size) {
+        if (slot.capacity >= size) {
+            return;
+        }
+        // a free slot is no longer referenced by the GPU or the writer
+        destroySlot(slot);
+
+        // cached memory makes the CPU reads fast; coherent memory is the fallback every device has
+        VkMemoryPropertyFlags properties = m_device.createBuffer(
+            size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            slot.buffer, slot.memory);
+        vkMapMemory(m_device.device(), slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped);
+        slot.capacity = size;
+        slot.coherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+
+    void FrameCapture::destroySlot(Slot& slot) {
+        if (slot.memory != VK_NULL_HANDLE) {
+            vkUnmapMemory(m_device.device(), slot.memory);
+        }
+        vkDestroyBuffer(m_device.device(), slot.buffer, nullptr);
+        vkFreeMemory(m_device.device(), slot.memory, nullptr);
+        slot.buffer = VK_NULL_HANDLE;
+        slot.memory = VK_NULL_HANDLE;
+        slot.mapped = nullptr;
+        slot.capacity = 0;
+    }
+
+    bool FrameCapture::record(VkCommandBuffer commandBuffer, size_t frameIndex, VkImage image, VkImageLayout layout,
+                              VkFormat format, VkExtent2D extent) {
+        if (!m_recording) {
+            return false;
+        }
+        assert((isBgra(format) || isRgba(format)) && "Frame capture needs an 8-bit RGBA or BGRA image.");
+
+        auto slot = std::find_if(m_slots.begin(), m_slots.end(), [](const Slot& s) {
+            return s.state.load(std::memory_order_acquire) == SlotState::Free;
+        });
+        if (slot == m_slots.end()) {
+            m_dropped++;
+            return false;
+        }
+        ensureCapacity(*slot, VkDeviceSize(extent.width) * extent.height * 4);
+
+        VkImageMemoryBarrier toTransfer{};
+        toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        toTransfer.oldLayout = layout;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.image = image;
+        toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+        }
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {extent.width, extent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+        // the copy is made visible to host reads, and the image goes back to where it was
+        VkBufferMemoryBarrier toHost{};
+        toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.buffer = slot->buffer;
+        toHost.size = VK_WHOLE_SIZE;
+
+        VkImageMemoryBarrier restore = toTransfer;
+        restore.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        restore.dstAccessMask = 0;
+        restore.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        restore.newLayout = layout;
+        uint32_t imageBarrierCount = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 1 : 0;
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 1, &toHost, imageBarrierCount, &restore);
+
+        slot->frameIndex = frameIndex;
+        slot->sequence = m_sequence++;
+        slot->extent = extent;
+        slot->bgra = isBgra(format);
+        slot->state.store(SlotState::Copying, std::memory_order_release);
+        return true;
+    }
+
+    void FrameCapture::collect(size_t frameIndex) {
+        for (Slot& slot : m_slots) {
+            if (slot.state.load(std::memory_order_acquire) != SlotState::Copying || slot.frameIndex != frameIndex) {
+                continue;
+            }
+            if (!slot.coherent) {
+                VkMappedMemoryRange range{};
+                range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                range.memory = slot.memory;
+                range.size = VK_WHOLE_SIZE;
+                vkInvalidateMappedMemoryRanges(m_device.device(), 1, &range);
+            }
+            slot.state.store(SlotState::Writing, std::memory_order_release);
+            m_writer.submit([this, &slot]() { write(slot); });
+        }
+    }
+
+    void FrameCapture::write(Slot& slot) {
+        // runs on the writer thread; the slot is returned to the ring once its pixels are on disk
+        size_t pixelCount = size_t(slot.extent.width) * slot.extent.height;
+        const uint8_t* source = static_cast<const uint8_t*>(slot.mapped);
+        std::vector<uint8_t> rgba(pixelCount * 4);
+        for (size_t i = 0; i < pixelCount; i++) {
+            const uint8_t* texel = source + i * 4;
+            rgba[i * 4 + 0] = slot.bgra ? texel[2] : texel[0];
+            rgba[i * 4 + 1] = texel[1];
+            rgba[i * 4 + 2] = slot.bgra ? texel[0] : texel[2];
+            rgba[i * 4 + 3] = 255;  // presentation ignores alpha, so it holds nothing meaningful
+        }
+
+        if (m_format == Format::Png) {
+            std::ostringstream path;
+            path << m_directory << "/frame_" << std::setw(6) << std::setfill('0') << slot.sequence << ".png";
+            std::string error;
+            if (!writePng(path.str(), slot.extent.width, slot.extent.height, rgba.data(), error)) {
+                LOG_ERROR("capture: " << error);
+            }
+        }
+        else if (m_rawFile.is_open()) {
+            uint32_t header[2] = {slot.extent.width, slot.extent.height};
+            m_rawFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+            m_rawFile.write(reinterpret_cast<const char*>(rgba.data()), static_cast<std::streamsize>(rgba.size()));
+        }
+
+        slot.state.store(SlotState::Free, std::memory_order_release);
+    }
+
+    FrameCapture::Stats FrameCapture::getStats() {
+        Stats stats;
+        stats.recording = m_recording;
+        stats.captured = m_sequence;
+        stats.dropped = m_dropped;
+        for (const Slot& slot : m_slots) {
+            stats.pendingWrites += slot.state.load(std::memory_order_acquire) == SlotState::Writing ? 1 : 0;
+        }
+        return stats;
+    }
+
+}
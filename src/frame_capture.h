@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vk_device.h"
+#include "vk_swapchain.h"
+#include "parallel.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace VKEngine {
+
+    // Records rendered frames to disk without stalling the render loop. Each captured frame is copied
+    // into one buffer of a ring of host-visible readback buffers; the CPU only reads a buffer once the
+    // fence of the frame that filled it has been waited on, and a background thread converts and
+    // writes it, after which the buffer returns to the ring. If the writer falls behind and the ring
+    // is full, frames are dropped instead of waited for.
+    //
+    // PNG writes one numbered file per frame. Raw appends every frame to a single .rgba file, each
+    // preceded by its width and height as two little-endian uint32s, for sessions too long for PNG.
+    class FrameCapture {
+    public:
+        enum class Format {
+            Png,
+            Raw,
+        };
+
+        // Frames in flight, plus slack for the writer thread
+        static constexpr size_t RING_SIZE = SwapChain::MAX_FRAMES_IN_FLIGHT + 3;
+
+        struct Stats {
+            bool recording = false;
+            uint64_t captured = 0;  // handed to the writer
+            uint64_t dropped = 0;   // ring was full
+            size_t pendingWrites = 0;
+        };
+
+        // 8-bit RGBA or BGRA images only
+        static bool isSupported(SwapChain& swapChain);
+
+        FrameCapture(Device& device, const std::string& directory, Format format);
+        // Waits for the writer to finish the frames already read back
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture &operator=(const FrameCapture&) = delete;
+
+        void start();
+        void stop();
+        bool isRecording() const { return m_recording; }
+
+        // Hands the frames copied by the last use of frameIndex to the writer; call after its fence wait
+        void collect(size_t frameIndex);
+
+        // Copies the image, in the given layout, into a free readback buffer. Anything but
+        // TRANSFER_SRC_OPTIMAL is transitioned there and back around the copy, waiting for color
+        // attachment and transfer writes. Returns false if not recording or the frame was dropped.
+        bool record(VkCommandBuffer commandBuffer, size_t frameIndex, VkImage image, VkImageLayout layout,
+                    VkFormat format, VkExtent2D extent);
+
+        Stats getStats();
+
+    private:
+        enum class SlotState : uint32_t {
+            Free,
+            Copying,  // GPU copy recorded, waiting for the frame's fence
+            Writing,  // owned by the writer thread
+        };
+
+        struct Slot {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mapped = nullptr;
+            VkDeviceSize capacity = 0;
+            bool coherent = false;
+            std::atomic<SlotState> state{SlotState::Free};
+            size_t frameIndex = 0;
+            uint64_t sequence = 0;
+            VkExtent2D extent{};
+            bool bgra = false;
+        };
+
+        void ensureCapacity(Slot& slot, VkDeviceSize size);
+        void destroySlot(Slot& slot);
+        void write(Slot& slot);
+
+        Device& m_device;
+        std::string m_directory;
+        Format m_format;
+        std::array<Slot, RING_SIZE> m_slots;
+        bool m_recording = false;
+        uint64_t m_sequence = 0;
+        uint64_t m_dropped = 0;
+
+        std::ofstream m_rawFile;  // writer thread only
+        TaskQueue m_writer{1};    // one thread keeps frames in order
+    };
+
+}
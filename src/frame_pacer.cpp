@@ -0,0 +1,99 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+namespace VKEngine {
+
+    FramePacer::Settings FramePacer::settingsFromEnvironment() {
+        Settings settings;
+        if (const char* fps = std::getenv("VKENGINE_FPS")) {
+            settings.targetFps = std::max(0.0, std::atof(fps));
+        }
+        if (const char* onDemand = std::getenv("VKENGINE_ON_DEMAND")) {
+            settings.onDemand = std::string(onDemand) != "0";
+        }
+        return settings;
+    }
+
+    FramePacer::FramePacer(const Settings& settings) : m_settings(settings) {
+        m_stats.onDemand = settings.onDemand;
+    }
+
+    void FramePacer::invalidate() {
+        m_invalidated.store(true, std::memory_order_release);
+        // wakes the main thread if it is blocked waiting for events
+        glfwPostEmptyEvent();
+    }
+
+    double FramePacer::effectiveFps(const Window& window) const {
+        double fps = m_settings.targetFps;
+        if (!window.isFocused() && m_settings.backgroundFps > 0.0) {
+            fps = fps > 0.0 ? std::min(fps, m_settings.backgroundFps) : m_settings.backgroundFps;
+        }
+        return fps;
+    }
+
+    bool FramePacer::waitForFrame(Window& window) {
+        Clock::time_point waitStart = Clock::now();
+        double fps = effectiveFps(window);
+
+        if (m_settings.onDemand) {
+            glfwPollEvents();
+            if (window.consumeEvents()) {
+                m_invalidated.store(true, std::memory_order_relaxed);
+            }
+            if (!m_invalidated.load(std::memory_order_acquire)) {
+                // blocks until an event or invalidate(); the caller comes straight back here
+                glfwWaitEvents();
+                m_stats.idleWakeups++;
+                return false;
+            }
+        }
+
+        Clock::time_point now = Clock::now();
+        if (fps > 0.0) {
+            auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+            // after a stall or an idle stretch, restart the schedule instead of rushing to catch up
+            if (now - m_nextFrame > period) {
+                m_nextFrame = now;
+            }
+            sleepUntil(m_nextFrame);
+            m_nextFrame += period;
+        }
+        // polled after the wait so the frame sees the newest input
+        glfwPollEvents();
+        if (m_settings.onDemand) {
+            window.consumeEvents();
+            m_invalidated.store(false, std::memory_order_relaxed);
+        }
+
+        m_stats.targetFps = fps;
+        m_stats.waitMillis = std::chrono::duration<double, std::milli>(Clock::now() - waitStart).count();
+        m_stats.idleWakeups = 0;
+        return true;
+    }
+
+    void FramePacer::sleepUntil(Clock::time_point deadline) {
+        m_stats.spinMillis = 0.0;
+        auto spin = std::chrono::duration<double, std::milli>(m_spinMillis);
+
+        // one sleep to just before the deadline, so an idle pacer wakes once per frame
+        Clock::time_point wake = deadline - std::chrono::duration_cast<Clock::duration>(spin);
+        if (wake > Clock::now()) {
+            std::this_thread::sleep_until(wake);
+            double oversleep = std::chrono::duration<double, std::milli>(Clock::now() - wake).count();
+            // rise at once on a late wakeup, decay slowly
+            m_spinMillis = std::clamp(std::max(oversleep, m_spinMillis * 0.99), MIN_SPIN_MILLIS, MAX_SPIN_MILLIS);
+        }
+
+        Clock::time_point spinStart = Clock::now();
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        m_stats.spinMillis = std::chrono::duration<double, std::milli>(Clock::now() - spinStart).count();
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vk_window.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace VKEngine {
+
+    // Decides when the main loop draws. Pumps the window's events itself, so it replaces the
+    // glfwPollEvents call in the loop.
+    //
+    // With a target rate, each frame starts on a fixed schedule: the pacer sleeps in the OS until
+    // just before the deadline and spins the rest of the way, the spin margin tracking how far the
+    // OS has been oversleeping. An unfocused window is held to the background rate.
+    //
+    // In on-demand mode nothing is drawn until the frame is invalidated, by a window event or an
+    // invalidate() call from any thread. Until then the thread blocks in glfwWaitEvents and the
+    // GPU gets no work at all.
+    class FramePacer {
+    public:
+        struct Settings {
+            double targetFps = 0.0;       // 0 leaves the rate to presentation
+            double backgroundFps = 10.0;  // cap while unfocused, 0 for none
+            bool onDemand = false;
+        };
+
+        struct Stats {
+            bool onDemand = false;
+            double targetFps = 0.0;    // in effect for the last frame, 0 when unlimited
+            double waitMillis = 0.0;   // spent waiting before the last frame
+            double spinMillis = 0.0;   // of which spinning
+            uint64_t idleWakeups = 0;  // woke up without drawing since the last frame
+        };
+
+        // Reads VKENGINE_FPS=<target rate> and VKENGINE_ON_DEMAND=1
+        static Settings settingsFromEnvironment();
+
+        explicit FramePacer(const Settings& settings);
+
+        FramePacer(const FramePacer&) = delete;
+        FramePacer &operator=(const FramePacer&) = delete;
+
+        // Processes window events and waits until the next frame is due. Returns false when the loop
+        // should check for shutdown without drawing.
+        bool waitForFrame(Window& window);
+
+        // Requests a frame in on-demand mode; safe from any thread
+        void invalidate();
+
+        const Settings& getSettings() const { return m_settings; }
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr double MIN_SPIN_MILLIS = 0.25;
+        static constexpr double MAX_SPIN_MILLIS = 4.0;
+
+        double effectiveFps(const Window& window) const;
+        void sleepUntil(Clock::time_point deadline);
+
+        Settings m_settings;
+        std::atomic<bool> m_invalidated{true};  // the first frame is always drawn
+        Clock::time_point m_nextFrame = Clock::now();
+        double m_spinMillis = 1.0;  // how early to stop sleeping, follows the observed oversleep
+        Stats m_stats;
+    };
+
+}
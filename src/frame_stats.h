@@ -0,0 +1,85 @@
+#pragma once
+
+#include "render_queue.h"
+#include "cpu_culling.h"
+#include "scene.h"
+#include "simulation.h"
+#include "texture_manager.h"
+#include "render_graph.h"
+#include "dynamic_resolution.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "asset_pipeline.h"
+
+#include <cstdint>
+#include <ostream>
+
+namespace VKEngine {
+
+    // Per-frame counters gathered from the renderer subsystems, printed periodically by Application
+    struct FrameStats {
+        uint64_t frameCount = 0;
+        const char* profile = "";  // launch profile the device runs with
+        double cpuFrameMillis = 0.0;
+        RenderQueue::Stats renderQueue;
+        Scene::Stats scene;
+        Simulation::Stats simulation;
+        CpuCulling::Stats culling;
+        AssetPipeline::Stats assets;
+        TextureManager::Stats textures;
+        size_t pendingDeletions = 0;
+        RenderGraph::Stats renderGraph;
+        DynamicResolution::Stats dynamicResolution;
+        FrameCapture::Stats capture;
+        FramePacer::Stats pacing;
+
+        void print(std::ostream& out) const {
+            out << "[stats] frame " << frameCount
+                << " | profile " << profile
+                << " | cpu " << cpuFrameMillis << " ms"
+                << " | queue items " << renderQueue.items
+                << " sort " << renderQueue.sortMicros << " us"
+                << " | pipeline binds " << renderQueue.pipelineBinds
+                << " (avoided " << renderQueue.pipelineBindsAvoided << ")"
+                << " | geometry binds " << renderQueue.geometryBinds
+                << " (avoided " << renderQueue.geometryBindsAvoided << ")"
+                << " | scene " << scene.entities << " entities"
+                << " changed " << scene.changed
+                << " update " << scene.updateMicros << " us"
+                << " | sim tick " << simulation.ticks
+                << " (" << simulation.tickMicros << " us, skipped " << simulation.skippedTicks << ")"
+                << " blend " << simulation.alpha
+                << " applied " << simulation.interpolated
+                << " | cpu cull " << culling.visible << " visible"
+                << " " << culling.culled << " culled"
+                << " " << culling.triangles << " tris"
+                << " " << culling.cullMicros << " us"
+                << " | assets queued " << assets.queued
+                << " decoding " << assets.decoding
+                << " read " << (assets.bytesRead >> 20) << " MiB (" << assets.readMiBPerSecond << " MiB/s)"
+                << " | textures " << textures.textures
+                << " loading " << textures.loading
+                << " resident " << (textures.residentBytes >> 20) << "/" << (textures.budgetBytes >> 20) << " MiB"
+                << " evicted mips " << textures.evictedLevels
+                << " transcoded " << textures.transcoded
+                << " | pending deletions " << pendingDeletions
+                << " | graph passes " << renderGraph.passes
+                << " (culled " << renderGraph.culledPasses << ")"
+                << " barriers " << renderGraph.barrierBatches
+                << " (" << renderGraph.imageBarriers << " image " << renderGraph.memoryBarriers << " memory)"
+                << " transient " << (renderGraph.transientBytes >> 10) << " KiB"
+                << " (unaliased " << (renderGraph.unaliasedTransientBytes >> 10) << " KiB)"
+                << " | render scale " << dynamicResolution.scale
+                << " (" << dynamicResolution.renderExtent.width << "x" << dynamicResolution.renderExtent.height << ")"
+                << " gpu " << dynamicResolution.gpuMillis << "/" << dynamicResolution.targetMillis << " ms"
+                << " | capture " << (capture.recording ? "on" : "off")
+                << " " << capture.captured << " frames"
+                << " (dropped " << capture.dropped << " pending " << capture.pendingWrites << ")"
+                << " | pacing " << (pacing.onDemand ? "on demand" : "continuous")
+                << " target " << pacing.targetFps << " fps"
+                << " wait " << pacing.waitMillis << " ms (spin " << pacing.spinMillis << ")"
+                << '\n';
+        }
+    };
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace VKEngine {
+
+    // Normalized world-space frustum planes (xyz = inward normal, w = distance), Gribb/Hartmann
+    // extraction for a [0, 1] clip-space depth range. Order: left, right, bottom, top, near, far.
+    inline void extractFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]) {
+        glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row2;
+        planes[5] = row3 - row2;
+
+        for (int i = 0; i < 6; i++) {
+            float length = glm::length(glm::vec3(planes[i]));
+            if (length > 0.0f) {
+                planes[i] /= length;
+            }
+        }
+    }
+
+}
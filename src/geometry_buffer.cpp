@@ -0,0 +1,411 @@
+#include "geometry_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    RangeAllocator::RangeAllocator(uint32_t capacity) { reset(capacity, 0); }
+
+    uint32_t RangeAllocator::allocate(uint32_t count) {
+        for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it) {
+            if (it->second < count) {
+                continue;
+            }
+            uint32_t offset = it->first;
+            uint32_t remaining = it->second - count;
+            m_freeBlocks.erase(it);
+            if (remaining > 0) {
+                m_freeBlocks.emplace(offset + count, remaining);
+            }
+            m_used += count;
+            return offset;
+        }
+        return INVALID_OFFSET;
+    }
+
+    void RangeAllocator::free(uint32_t offset, uint32_t count) {
+        if (count == 0) {
+            return;
+        }
+        assert(offset + count <= m_capacity && "Freed range is outside the allocator.");
+        m_used -= count;
+
+        auto next = m_freeBlocks.lower_bound(offset);
+        // merge with the following block
+        if (next != m_freeBlocks.end() && offset + count == next->first) {
+            count += next->second;
+            next = m_freeBlocks.erase(next);
+        }
+        // merge with the preceding block
+        if (next != m_freeBlocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += count;
+                return;
+            }
+        }
+        m_freeBlocks.emplace(offset, count);
+    }
+
+    void RangeAllocator::reset(uint32_t capacity, uint32_t usedPrefix) {
+        m_freeBlocks.clear();
+        m_capacity = capacity;
+        m_used = usedPrefix;
+        if (capacity > usedPrefix) {
+            m_freeBlocks.emplace(usedPrefix, capacity - usedPrefix);
+        }
+    }
+
+    uint32_t RangeAllocator::largestFreeBlock() const {
+        uint32_t largest = 0;
+        for (const auto& block : m_freeBlocks) {
+            largest = std::max(largest, block.second);
+        }
+        return largest;
+    }
+
+    GeometryBuffer::GeometryBuffer(Device& device, DeletionQueue& deletionQueue, uint32_t vertexStride,
+                                   uint32_t vertexCapacity, uint32_t indexCapacity)
+        : m_device(device),
+          m_deletionQueue(deletionQueue),
+          m_vertexStride(vertexStride),
+          m_vertexAllocator(vertexCapacity),
+          m_indexAllocator(indexCapacity) {
+        createBuffers(vertexCapacity, indexCapacity, m_vertexBuffer, m_vertexMemory, m_indexBuffer, m_indexMemory);
+    }
+
+    GeometryBuffer::~GeometryBuffer() {
+        // in-flight transfers still read their staging buffers
+        vkQueueWaitIdle(m_device.graphicsQueue());
+        for (Transfer& transfer : m_transfers) {
+            releaseTransfer(transfer);
+        }
+        vkDestroyBuffer(m_device.device(), m_vertexBuffer, nullptr);
+        vkFreeMemory(m_device.device(), m_vertexMemory, nullptr);
+        vkDestroyBuffer(m_device.device(), m_indexBuffer, nullptr);
+        vkFreeMemory(m_device.device(), m_indexMemory, nullptr);
+    }
+
+    void GeometryBuffer::createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity, VkBuffer& vertexBuffer,
+        VkDeviceMemory& vertexMemory, VkBuffer& indexBuffer, VkDeviceMemory& indexMemory) {
+        m_device.createBuffer(
+            static_cast<VkDeviceSize>(vertexCapacity) * m_vertexStride,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            vertexBuffer,
+            vertexMemory);
+        m_device.createBuffer(
+            static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            indexBuffer,
+            indexMemory);
+    }
+
+    GeometryBuffer::AllocationId GeometryBuffer::allocate(
+        const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount) {
+        assert(vertexCount > 0 && indexCount > 0 && "Cannot allocate empty geometry.");
+        ensureSpace(vertexCount, indexCount);
+
+        Allocation allocation;
+        allocation.range.vertexOffset = m_vertexAllocator.allocate(vertexCount);
+        allocation.range.vertexCount = vertexCount;
+        allocation.range.firstIndex = m_indexAllocator.allocate(indexCount);
+        allocation.range.indexCount = indexCount;
+        allocation.state = AllocationState::Live;
+
+        upload(m_vertexBuffer,
+            static_cast<VkDeviceSize>(allocation.range.vertexOffset) * m_vertexStride,
+            vertexData,
+            static_cast<VkDeviceSize>(vertexCount) * m_vertexStride);
+        upload(m_indexBuffer,
+            static_cast<VkDeviceSize>(allocation.range.firstIndex) * sizeof(uint32_t),
+            indexData,
+            static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t));
+
+        AllocationId id;
+        if (!m_freeAllocationIds.empty()) {
+            id = m_freeAllocationIds.back();
+            m_freeAllocationIds.pop_back();
+            m_allocations[id] = allocation;
+        }
+        else {
+            id = static_cast<AllocationId>(m_allocations.size());
+            m_allocations.push_back(allocation);
+        }
+        return id;
+    }
+
+    void GeometryBuffer::free(AllocationId allocation) {
+        assert(allocation < m_allocations.size() && m_allocations[allocation].state == AllocationState::Live
+               && "Invalid geometry allocation.");
+        // frames already submitted may still draw the range, so it is not handed out again until they finish
+        m_allocations[allocation].state = AllocationState::Retiring;
+        m_allocations[allocation].relocation = m_relocations;
+        m_deletionQueue.push([this, allocation]() { releaseAllocation(allocation); });
+    }
+
+    void GeometryBuffer::releaseAllocation(AllocationId allocation) {
+        Allocation& retired = m_allocations[allocation];
+        // a relocation since the free already left the range behind in the old buffers
+        if (retired.relocation == m_relocations) {
+            m_vertexAllocator.free(retired.range.vertexOffset, retired.range.vertexCount);
+            m_indexAllocator.free(retired.range.firstIndex, retired.range.indexCount);
+        }
+        retired.state = AllocationState::Free;
+        m_freeAllocationIds.push_back(allocation);
+    }
+
+    void GeometryBuffer::ensureSpace(uint32_t vertexCount, uint32_t indexCount) {
+        bool vertexFits = m_vertexAllocator.largestFreeBlock() >= vertexCount;
+        bool indexFits = m_indexAllocator.largestFreeBlock() >= indexCount;
+        if (vertexFits && indexFits) {
+            return;
+        }
+
+        uint32_t vertexCapacity = m_vertexAllocator.capacity();
+        uint32_t indexCapacity = m_indexAllocator.capacity();
+        uint32_t vertexNeeded = m_vertexAllocator.used() + vertexCount;
+        uint32_t indexNeeded = m_indexAllocator.used() + indexCount;
+
+        // fragmented but large enough: packing the live ranges is enough
+        if (vertexNeeded <= vertexCapacity && indexNeeded <= indexCapacity) {
+            compact();
+            return;
+        }
+
+        while (vertexCapacity < vertexNeeded) vertexCapacity = std::max(vertexCapacity * 2, 1024u);
+        while (indexCapacity < indexNeeded) indexCapacity = std::max(indexCapacity * 2, 1024u);
+        relocate(vertexCapacity, indexCapacity);
+    }
+
+    void GeometryBuffer::compact() {
+        relocate(m_vertexAllocator.capacity(), m_indexAllocator.capacity());
+        m_compactions++;
+    }
+
+    void GeometryBuffer::relocate(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        // queued data targets the current buffers and offsets
+        flushUploads();
+
+        VkBuffer newVertexBuffer;
+        VkDeviceMemory newVertexMemory;
+        VkBuffer newIndexBuffer;
+        VkDeviceMemory newIndexMemory;
+        createBuffers(vertexCapacity, indexCapacity, newVertexBuffer, newVertexMemory, newIndexBuffer, newIndexMemory);
+
+        std::vector<VkBufferCopy> vertexCopies;
+        std::vector<VkBufferCopy> indexCopies;
+        uint32_t vertexCursor = 0;
+        uint32_t indexCursor = 0;
+
+        // pack live ranges in their current order; indices are relative to vertexOffset so they copy verbatim
+        std::vector<Allocation*> live;
+        for (auto& allocation : m_allocations) {
+            if (allocation.state == AllocationState::Live) live.push_back(&allocation);
+        }
+        std::sort(live.begin(), live.end(), [](const Allocation* a, const Allocation* b) {
+            return a->range.vertexOffset < b->range.vertexOffset;
+        });
+
+        for (Allocation* allocation : live) {
+            Range& range = allocation->range;
+            uint32_t newVertexOffset = vertexCursor;
+            uint32_t newFirstIndex = indexCursor;
+
+            vertexCopies.push_back({
+                static_cast<VkDeviceSize>(range.vertexOffset) * m_vertexStride,
+                static_cast<VkDeviceSize>(newVertexOffset) * m_vertexStride,
+                static_cast<VkDeviceSize>(range.vertexCount) * m_vertexStride});
+            indexCopies.push_back({
+                static_cast<VkDeviceSize>(range.firstIndex) * sizeof(uint32_t),
+                static_cast<VkDeviceSize>(newFirstIndex) * sizeof(uint32_t),
+                static_cast<VkDeviceSize>(range.indexCount) * sizeof(uint32_t)});
+
+            range.vertexOffset = newVertexOffset;
+            range.firstIndex = newFirstIndex;
+            vertexCursor += range.vertexCount;
+            indexCursor += range.indexCount;
+        }
+
+        // frames in flight keep reading the old buffers, and the copy only reads them too, so nothing waits
+        if (!vertexCopies.empty()) {
+            Transfer transfer;
+            VkCommandBuffer commandBuffer = beginTransfer(transfer);
+            vkCmdCopyBuffer(commandBuffer, m_vertexBuffer, newVertexBuffer,
+                static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+            vkCmdCopyBuffer(commandBuffer, m_indexBuffer, newIndexBuffer,
+                static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+            submitTransfer(transfer);
+        }
+
+        m_deletionQueue.push([device = m_device.device(), vertexBuffer = m_vertexBuffer, vertexMemory = m_vertexMemory,
+                              indexBuffer = m_indexBuffer, indexMemory = m_indexMemory]() {
+            vkDestroyBuffer(device, vertexBuffer, nullptr);
+            vkFreeMemory(device, vertexMemory, nullptr);
+            vkDestroyBuffer(device, indexBuffer, nullptr);
+            vkFreeMemory(device, indexMemory, nullptr);
+        });
+        m_vertexBuffer = newVertexBuffer;
+        m_vertexMemory = newVertexMemory;
+        m_indexBuffer = newIndexBuffer;
+        m_indexMemory = newIndexMemory;
+
+        m_vertexAllocator.reset(vertexCapacity, vertexCursor);
+        m_indexAllocator.reset(indexCapacity, indexCursor);
+        m_relocations++;
+    }
+
+    void GeometryBuffer::beginUploads() {
+        collectTransfers();
+        m_batchingUploads = true;
+    }
+
+    void GeometryBuffer::endUploads() {
+        flushUploads();
+        m_batchingUploads = false;
+    }
+
+    void GeometryBuffer::flushUploads() {
+        if (m_pendingUploads.empty()) {
+            return;
+        }
+        VkDeviceSize totalSize = 0;
+        for (const PendingUpload& pending : m_pendingUploads) {
+            totalSize += pending.data.size();
+        }
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        m_device.createBuffer(
+            totalSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer,
+            stagingMemory);
+
+        void* mapped;
+        vkMapMemory(m_device.device(), stagingMemory, 0, totalSize, 0, &mapped);
+        std::vector<VkBufferCopy> vertexCopies;
+        std::vector<VkBufferCopy> indexCopies;
+        VkDeviceSize stagingOffset = 0;
+        for (const PendingUpload& pending : m_pendingUploads) {
+            memcpy(static_cast<uint8_t*>(mapped) + stagingOffset, pending.data.data(), pending.data.size());
+            VkBufferCopy copy{stagingOffset, pending.dstOffset, pending.data.size()};
+            (pending.dstBuffer == m_vertexBuffer ? vertexCopies : indexCopies).push_back(copy);
+            stagingOffset += pending.data.size();
+        }
+        vkUnmapMemory(m_device.device(), stagingMemory);
+
+        Transfer transfer;
+        transfer.staging = stagingBuffer;
+        transfer.stagingMemory = stagingMemory;
+        VkCommandBuffer commandBuffer = beginTransfer(transfer);
+        if (!vertexCopies.empty()) {
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_vertexBuffer,
+                static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+        }
+        if (!indexCopies.empty()) {
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_indexBuffer,
+                static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+        }
+        submitTransfer(transfer);
+        m_pendingUploads.clear();
+    }
+
+    void GeometryBuffer::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_pendingUploads.push_back({dstBuffer, dstOffset, std::vector<uint8_t>(bytes, bytes + size)});
+        if (!m_batchingUploads) {
+            flushUploads();
+        }
+    }
+
+    VkCommandBuffer GeometryBuffer::beginTransfer(Transfer& transfer) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_device.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &transfer.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate geometry transfer command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(transfer.commandBuffer, &beginInfo);
+        return transfer.commandBuffer;
+    }
+
+    void GeometryBuffer::submitTransfer(Transfer& transfer) {
+        // the barrier also covers commands submitted later to the queue: the next relocation's reads
+        // and writes, and every draw that fetches from the buffers
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                                | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(transfer.commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(transfer.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &transfer.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create geometry transfer fence!");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &transfer.commandBuffer;
+        if (vkQueueSubmit(m_device.graphicsQueue(), 1, &submitInfo, transfer.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit geometry transfer command buffer!");
+        }
+        m_transfers.push_back(transfer);
+    }
+
+    void GeometryBuffer::collectTransfers() {
+        while (!m_transfers.empty() && vkGetFenceStatus(m_device.device(), m_transfers.front().fence) == VK_SUCCESS) {
+            releaseTransfer(m_transfers.front());
+            m_transfers.pop_front();
+        }
+    }
+
+    void GeometryBuffer::releaseTransfer(Transfer& transfer) {
+        vkDestroyFence(m_device.device(), transfer.fence, nullptr);
+        vkFreeCommandBuffers(m_device.device(), m_device.getCommandPool(), 1, &transfer.commandBuffer);
+        if (transfer.staging != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device.device(), transfer.staging, nullptr);
+            vkFreeMemory(m_device.device(), transfer.stagingMemory, nullptr);
+        }
+    }
+
+    void GeometryBuffer::bind(VkCommandBuffer commandBuffer) {
+        VkBuffer buffers[] = { m_vertexBuffer };
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    GeometryBuffer::Stats GeometryBuffer::getStats() const {
+        Stats stats{};
+        stats.allocationCount = static_cast<uint32_t>(std::count_if(m_allocations.begin(), m_allocations.end(),
+            [](const Allocation& allocation) { return allocation.state == AllocationState::Live; }));
+        stats.vertexUsed = m_vertexAllocator.used();
+        stats.vertexCapacity = m_vertexAllocator.capacity();
+        stats.indexUsed = m_indexAllocator.used();
+        stats.indexCapacity = m_indexAllocator.capacity();
+        stats.compactions = m_compactions;
+        stats.transfersInFlight = static_cast<uint32_t>(m_transfers.size());
+        return stats;
+    }
+
+}
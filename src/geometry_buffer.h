@@ -0,0 +1,153 @@
+#pragma once
+
+#include "deletion_queue.h"
+#include "vk_device.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace VKEngine {
+
+    // First-fit sub-allocator over a range of elements, with coalescing of adjacent free blocks
+    class RangeAllocator {
+    public:
+        static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+        explicit RangeAllocator(uint32_t capacity = 0);
+
+        uint32_t allocate(uint32_t count);
+        void free(uint32_t offset, uint32_t count);
+        void reset(uint32_t capacity, uint32_t usedPrefix);
+
+        uint32_t capacity() const { return m_capacity; }
+        uint32_t used() const { return m_used; }
+        uint32_t largestFreeBlock() const;
+        size_t freeBlockCount() const { return m_freeBlocks.size(); }
+
+    private:
+        std::map<uint32_t, uint32_t> m_freeBlocks;  // offset -> count
+        uint32_t m_capacity = 0;
+        uint32_t m_used = 0;
+    };
+
+    // One device-local vertex buffer and one index buffer shared by every Model. Models own an
+    // allocation (a vertex range and an index range) and draw with vertexOffset/firstIndex, so the
+    // buffers are bound once per frame.
+    //
+    // Nothing here waits for the GPU. Uploads and relocation copies are submitted with a fence that
+    // later frames poll, ordered before the draws that follow by a barrier; replaced buffers and freed
+    // ranges go through the deletion queue, so frames in flight keep reading valid data.
+    class GeometryBuffer {
+    public:
+        using AllocationId = uint32_t;
+        static constexpr AllocationId INVALID_ALLOCATION = UINT32_MAX;
+
+        struct Range {
+            uint32_t vertexOffset = 0;
+            uint32_t vertexCount = 0;
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+        };
+
+        struct Stats {
+            uint32_t allocationCount;
+            uint32_t vertexUsed;
+            uint32_t vertexCapacity;
+            uint32_t indexUsed;
+            uint32_t indexCapacity;
+            uint32_t compactions;
+            uint32_t transfersInFlight;
+        };
+
+        GeometryBuffer(Device& device, DeletionQueue& deletionQueue, uint32_t vertexStride, uint32_t vertexCapacity,
+                       uint32_t indexCapacity);
+        ~GeometryBuffer();
+
+        GeometryBuffer(const GeometryBuffer&) = delete;
+        GeometryBuffer &operator=(const GeometryBuffer&) = delete;
+
+        AllocationId allocate(const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount);
+
+        // Allocations made in between queue their data, and endUploads() copies all of it through one
+        // staging buffer and a single submit instead of one per buffer. Call once per frame, also when
+        // nothing is loading: beginUploads() releases the transfers the GPU has finished.
+        void beginUploads();
+        void endUploads();
+        // The range stays reserved until the frames that may still draw it have completed
+        void free(AllocationId allocation);
+
+        // Moves every live range to the front of the buffers so the free space becomes one block.
+        // Ranges change; callers must re-query them after compaction.
+        void compact();
+
+        const Range& getRange(AllocationId allocation) const { return m_allocations[allocation].range; }
+        void bind(VkCommandBuffer commandBuffer);
+
+        VkBuffer getVertexBuffer() const { return m_vertexBuffer; }
+        VkBuffer getIndexBuffer() const { return m_indexBuffer; }
+        Stats getStats() const;
+
+    private:
+        enum class AllocationState {
+            Free,
+            Live,
+            Retiring,  // freed, waiting for the deletion queue
+        };
+
+        struct Allocation {
+            Range range;
+            AllocationState state = AllocationState::Free;
+            uint32_t relocation = 0;  // m_relocations when retired; a relocation drops retiring ranges
+        };
+
+        struct PendingUpload {
+            VkBuffer dstBuffer;
+            VkDeviceSize dstOffset;
+            std::vector<uint8_t> data;
+        };
+
+        struct Transfer {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            VkBuffer staging = VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+        };
+
+        void createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity, VkBuffer& vertexBuffer,
+            VkDeviceMemory& vertexMemory, VkBuffer& indexBuffer, VkDeviceMemory& indexMemory);
+        // Copies every live range, packed, into freshly created buffers of the given capacity
+        void relocate(uint32_t vertexCapacity, uint32_t indexCapacity);
+        void ensureSpace(uint32_t vertexCount, uint32_t indexCount);
+        void upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+        void flushUploads();
+        void releaseAllocation(AllocationId allocation);
+        VkCommandBuffer beginTransfer(Transfer& transfer);
+        // Makes the copies visible to later copies and vertex input, then submits without waiting
+        void submitTransfer(Transfer& transfer);
+        void collectTransfers();
+        void releaseTransfer(Transfer& transfer);
+
+        Device& m_device;
+        DeletionQueue& m_deletionQueue;
+        uint32_t m_vertexStride;
+
+        VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_vertexMemory = VK_NULL_HANDLE;
+        VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory m_indexMemory = VK_NULL_HANDLE;
+
+        RangeAllocator m_vertexAllocator;
+        RangeAllocator m_indexAllocator;
+
+        std::vector<Allocation> m_allocations;
+        std::vector<AllocationId> m_freeAllocationIds;
+        uint32_t m_compactions = 0;
+        uint32_t m_relocations = 0;
+
+        bool m_batchingUploads = false;
+        std::vector<PendingUpload> m_pendingUploads;
+        std::deque<Transfer> m_transfers;  // submitted in order, so they complete in order
+    };
+
+}
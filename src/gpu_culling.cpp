@@ -0,0 +1,383 @@
+#include "gpu_culling.h"
+#include "frustum.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace VKEngine {
+
+    GpuCulling::GpuCulling(Device& device, const std::string& cullShaderPath)
+        : m_device(device) {
+        createDescriptorSetLayout();
+        createDescriptorPool();
+        createPipelineLayouts();
+        createCullPipeline(cullShaderPath);
+    }
+
+    GpuCulling::~GpuCulling() {
+        for (auto& frame : m_frames) {
+            destroyFrameBuffers(frame);
+        }
+        m_cullPipeline.reset();
+        vkDestroyPipelineLayout(m_device.device(), m_cullPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(m_device.device(), m_drawPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(m_device.device(), m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(m_device.device(), m_descriptorSetLayout, nullptr);
+    }
+
+    bool GpuCulling::isSupported(Device& device) {
+        // firstInstance carries the object index into indirect.vert
+        return device.supportsMultiDrawIndirect() && device.supportsDrawIndirectFirstInstance();
+    }
+
+    uint32_t GpuCulling::addObject(Model* model, const glm::mat4& transform) {
+        assert(model != nullptr && "Cannot add a culling object without a model.");
+        const auto& bounds = model->getBoundingSphere();
+
+        ObjectData object{};
+        object.model = transform;
+        object.sphere = glm::vec4(bounds.center, bounds.radius);
+        m_objects.push_back(object);
+        m_objectModels.push_back(model);
+
+        m_batchesDirty = true;
+        m_version++;
+        return static_cast<uint32_t>(m_objects.size() - 1);
+    }
+
+    void GpuCulling::setTransform(uint32_t objectIndex, const glm::mat4& transform) {
+        assert(objectIndex < m_objects.size() && "Culling object index out of range.");
+        m_objects[objectIndex].model = transform;
+        markObjectsDirty(objectIndex, objectIndex + 1);
+    }
+
+    void GpuCulling::setTransforms(uint32_t firstObject, const glm::mat4* transforms, uint32_t count) {
+        assert(firstObject + count <= m_objects.size() && "Culling object range out of range.");
+        for (uint32_t i = 0; i < count; i++) {
+            m_objects[firstObject + i].model = transforms[i];
+        }
+        markObjectsDirty(firstObject, firstObject + count);
+    }
+
+    void GpuCulling::markObjectsDirty(uint32_t begin, uint32_t end) {
+        // every frame in flight has its own copy of the object buffer, so each needs the update
+        for (auto& frame : m_frames) {
+            auto& ranges = frame.dirtyObjects;
+            if (!ranges.empty() && begin <= ranges.back().end && end >= ranges.back().begin) {
+                ranges.back().begin = std::min(ranges.back().begin, begin);
+                ranges.back().end = std::max(ranges.back().end, end);
+            }
+            else {
+                ranges.push_back({begin, end});
+            }
+        }
+    }
+
+    void GpuCulling::clearObjects() {
+        m_objects.clear();
+        m_objectModels.clear();
+        m_batches.clear();
+        m_batchesDirty = false;
+        m_version++;
+    }
+
+    void GpuCulling::createDescriptorSetLayout() {
+        // 0: objects, 1: draw commands, 2: draw count, 3: batch info
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(m_device.device(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor set layout!");
+        }
+    }
+
+    void GpuCulling::createDescriptorPool() {
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 4 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+        if (vkCreateDescriptorPool(m_device.device(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor pool!");
+        }
+
+        std::array<VkDescriptorSetLayout, SwapChain::MAX_FRAMES_IN_FLIGHT> layouts;
+        layouts.fill(m_descriptorSetLayout);
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> sets;
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(m_device.device(), &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate culling descriptor sets!");
+        }
+        for (size_t i = 0; i < m_frames.size(); i++) {
+            m_frames[i].descriptorSet = sets[i];
+        }
+    }
+
+    void GpuCulling::createPipelineLayouts() {
+        VkPushConstantRange cullRange = {};
+        cullRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        cullRange.offset = 0;
+        cullRange.size = sizeof(CullPushConstants);
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &cullRange;
+
+        if (vkCreatePipelineLayout(m_device.device(), &layoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline layout!");
+        }
+
+        VkPushConstantRange drawRange = {};
+        drawRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        drawRange.offset = 0;
+        drawRange.size = sizeof(DrawPushConstants);
+        layoutInfo.pPushConstantRanges = &drawRange;
+
+        if (vkCreatePipelineLayout(m_device.device(), &layoutInfo, nullptr, &m_drawPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create indirect draw pipeline layout!");
+        }
+    }
+
+    void GpuCulling::createCullPipeline(const std::string& cullShaderPath) {
+        ComputePipelineConfigInfo configInfo{};
+        configInfo.pipelineLayout = m_cullPipelineLayout;
+        m_cullPipeline = std::make_unique<Pipeline>(m_device, cullShaderPath, configInfo);
+    }
+
+    void GpuCulling::rebuildBatches() {
+        m_batches.clear();
+        std::unordered_map<Model*, uint32_t> batchIndices;
+
+        for (size_t i = 0; i < m_objects.size(); i++) {
+            Model* model = m_objectModels[i];
+            auto it = batchIndices.find(model);
+            if (it == batchIndices.end()) {
+                it = batchIndices.emplace(model, static_cast<uint32_t>(m_batches.size())).first;
+                m_batches.push_back(model);
+            }
+            m_objects[i].batch = it->second;
+        }
+        m_batchesDirty = false;
+    }
+
+    void GpuCulling::createFrameBuffers(FrameResources& frame, uint32_t objectCapacity, uint32_t batchCapacity) {
+        m_device.createBuffer(
+            sizeof(ObjectData) * objectCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.objectBuffer,
+            frame.objectMemory);
+        vkMapMemory(m_device.device(), frame.objectMemory, 0, VK_WHOLE_SIZE, 0, &frame.objectMapped);
+
+        m_device.createBuffer(
+            sizeof(BatchData) * batchCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.batchBuffer,
+            frame.batchMemory);
+        vkMapMemory(m_device.device(), frame.batchMemory, 0, VK_WHOLE_SIZE, 0, &frame.batchMapped);
+
+        m_device.createBuffer(
+            sizeof(VkDrawIndexedIndirectCommand) * objectCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            frame.commandBuffer,
+            frame.commandMemory);
+
+        m_device.createBuffer(
+            sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            frame.countBuffer,
+            frame.countMemory);
+
+        frame.objectCapacity = objectCapacity;
+        frame.batchCapacity = batchCapacity;
+        writeDescriptorSet(frame);
+    }
+
+    void GpuCulling::destroyFrameBuffers(FrameResources& frame) {
+        if (frame.objectBuffer == VK_NULL_HANDLE) {
+            return;
+        }
+        vkUnmapMemory(m_device.device(), frame.objectMemory);
+        vkUnmapMemory(m_device.device(), frame.batchMemory);
+        vkDestroyBuffer(m_device.device(), frame.objectBuffer, nullptr);
+        vkFreeMemory(m_device.device(), frame.objectMemory, nullptr);
+        vkDestroyBuffer(m_device.device(), frame.batchBuffer, nullptr);
+        vkFreeMemory(m_device.device(), frame.batchMemory, nullptr);
+        vkDestroyBuffer(m_device.device(), frame.commandBuffer, nullptr);
+        vkFreeMemory(m_device.device(), frame.commandMemory, nullptr);
+        vkDestroyBuffer(m_device.device(), frame.countBuffer, nullptr);
+        vkFreeMemory(m_device.device(), frame.countMemory, nullptr);
+
+        frame.objectBuffer = VK_NULL_HANDLE;
+        frame.objectMapped = nullptr;
+        frame.batchMapped = nullptr;
+        frame.objectCapacity = 0;
+        frame.batchCapacity = 0;
+        frame.uploadedVersion = 0;
+    }
+
+    void GpuCulling::writeDescriptorSet(FrameResources& frame) {
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+        bufferInfos[0] = {frame.objectBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {frame.commandBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {frame.countBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[3] = {frame.batchBuffer, 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 4> writes = {};
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(m_device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    void GpuCulling::prepareFrame(size_t frameIndex) {
+        if (m_batchesDirty) {
+            rebuildBatches();
+        }
+        if (m_objects.empty()) {
+            return;
+        }
+
+        FrameResources& frame = m_frames[frameIndex];
+        if (frame.uploadedVersion == m_version) {
+            writeBatchData(frame);
+            for (const auto& range : frame.dirtyObjects) {
+                memcpy(static_cast<ObjectData*>(frame.objectMapped) + range.begin, m_objects.data() + range.begin,
+                       sizeof(ObjectData) * (range.end - range.begin));
+            }
+            frame.dirtyObjects.clear();
+            return;
+        }
+
+        // the frame's fence has already been waited on, so its buffers are idle and can be replaced
+        uint32_t count = objectCount();
+        uint32_t batchCount = static_cast<uint32_t>(m_batches.size());
+        if (count > frame.objectCapacity || batchCount > frame.batchCapacity) {
+            uint32_t objectCapacity = std::max<uint32_t>(WORKGROUP_SIZE, frame.objectCapacity);
+            while (objectCapacity < count) objectCapacity *= 2;
+            uint32_t batchCapacity = std::max<uint32_t>(16, frame.batchCapacity);
+            while (batchCapacity < batchCount) batchCapacity *= 2;
+
+            destroyFrameBuffers(frame);
+            createFrameBuffers(frame, objectCapacity, batchCapacity);
+        }
+        writeBatchData(frame);
+
+        memcpy(frame.objectMapped, m_objects.data(), sizeof(ObjectData) * count);
+        frame.uploadedVersion = m_version;
+        frame.dirtyObjects.clear();
+    }
+
+    void GpuCulling::writeBatchData(FrameResources& frame) {
+        // tiny, and geometry ranges move when the GeometryBuffer compacts, so rewrite every frame
+        auto* batchData = static_cast<BatchData*>(frame.batchMapped);
+        for (size_t i = 0; i < m_batches.size(); i++) {
+            const Model& model = *m_batches[i];
+            const auto& range = model.getRange();
+
+            BatchData batch{};
+            batch.vertexOffset = static_cast<int32_t>(range.vertexOffset);
+            batch.lodCount = model.getLodCount();
+            for (uint32_t lod = 0; lod < batch.lodCount; lod++) {
+                const auto& level = model.getLod(lod);
+                batch.lods[lod] = {range.firstIndex + level.firstIndex, level.indexCount, level.error, 0};
+            }
+            batchData[i] = batch;
+        }
+    }
+
+    void GpuCulling::recordCull(VkCommandBuffer commandBuffer, size_t frameIndex, const glm::mat4& viewProj,
+                                const glm::vec3& cameraPosition, float lodScale) {
+        prepareFrame(frameIndex);
+        if (m_objects.empty()) {
+            return;
+        }
+        FrameResources& frame = m_frames[frameIndex];
+
+        // reset the draw count before the cull shader appends to it
+        vkCmdFillBuffer(commandBuffer, frame.countBuffer, 0, sizeof(uint32_t), 0);
+
+        VkMemoryBarrier fillBarrier = {};
+        fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+        CullPushConstants push{};
+        extractFrustumPlanes(viewProj, push.planes);
+        push.camera = glm::vec4(cameraPosition, lodScale);
+        push.objectCount = objectCount();
+        push.compact = m_device.supportsDrawIndirectCount() ? 1 : 0;
+
+        m_cullPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(
+            commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+        m_cullPipeline->dispatchForCount(commandBuffer, push.objectCount, WORKGROUP_SIZE);
+    }
+
+    void GpuCulling::recordDraw(VkCommandBuffer commandBuffer, size_t frameIndex, const glm::mat4& viewProj) {
+        if (m_objects.empty()) {
+            return;
+        }
+        FrameResources& frame = m_frames[frameIndex];
+
+        DrawPushConstants push{viewProj};
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_drawPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(
+            commandBuffer, m_drawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &push);
+
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (m_device.supportsDrawIndirectCount()) {
+            m_device.cmdDrawIndexedIndirectCount(
+                commandBuffer, frame.commandBuffer, 0, frame.countBuffer, 0, objectCount(), stride);
+        }
+        else {
+            // without a GPU count every slot is drawn; culled objects were written with instanceCount = 0
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.commandBuffer, 0, objectCount(), stride);
+        }
+    }
+
+}
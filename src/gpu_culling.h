@@ -0,0 +1,140 @@
+#pragma once
+
+#include "vk_device.h"
+#include "vk_swapchain.h"
+#include "vk_pipeline.h"
+#include "model.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VKEngine {
+
+    // GPU-driven draw path: object transforms and bounds live in storage buffers, a compute pass
+    // frustum-culls them and compacts the survivors into indexed indirect draw commands, and the frame
+    // then issues a single multi-draw-indirect call over the shared GeometryBuffer. CPU cost is
+    // independent of object count.
+    class GpuCulling {
+    public:
+        static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+        // std430 mirror of ObjectData in cull.comp / indirect.vert
+        struct ObjectData {
+            glm::mat4 model;
+            glm::vec4 sphere;   // object-space centre (xyz) and radius (w)
+            uint32_t batch;
+            uint32_t padding[3];
+        };
+
+        // Graphics push constants for indirect.vert
+        struct DrawPushConstants {
+            glm::mat4 viewProj;
+        };
+
+        GpuCulling(Device& device, const std::string& cullShaderPath);
+        ~GpuCulling();
+
+        GpuCulling(const GpuCulling&) = delete;
+        GpuCulling &operator=(const GpuCulling&) = delete;
+
+        // Returns false when the device lacks the features the indirect path relies on
+        static bool isSupported(Device& device);
+
+        // Objects reference one batch per model; returns the object index
+        uint32_t addObject(Model* model, const glm::mat4& transform);
+        // Transform changes only upload the touched objects; adding or clearing objects re-uploads everything
+        void setTransform(uint32_t objectIndex, const glm::mat4& transform);
+        void setTransforms(uint32_t firstObject, const glm::mat4* transforms, uint32_t count);
+        void clearObjects();
+        uint32_t objectCount() const { return static_cast<uint32_t>(m_objects.size()); }
+
+        VkPipelineLayout getDrawPipelineLayout() const { return m_drawPipelineLayout; }
+
+        // Must be called outside a render pass, after the frame's fence has been waited on. The caller
+        // orders the indirect draw after the compute writes (the render graph does this). LODs are
+        // picked per object from cameraPosition and lodScale (see Model::selectLod); the GPU keeps no
+        // per-object state, so unlike the CPU path there is no hysteresis.
+        void recordCull(VkCommandBuffer commandBuffer, size_t frameIndex, const glm::mat4& viewProj,
+                        const glm::vec3& cameraPosition, float lodScale);
+        // Must be called inside the render pass with the indirect pipeline and the GeometryBuffer bound
+        void recordDraw(VkCommandBuffer commandBuffer, size_t frameIndex, const glm::mat4& viewProj);
+
+    private:
+        // std430 mirrors of Lod and Batch in cull.comp
+        struct LodData {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            float error;
+            uint32_t padding;
+        };
+
+        struct BatchData {
+            int32_t vertexOffset;
+            uint32_t lodCount;
+            uint32_t padding[2];
+            LodData lods[Model::MAX_LODS];
+        };
+
+        struct CullPushConstants {
+            glm::vec4 planes[6];
+            glm::vec4 camera;   // world position (xyz) and LOD scale (w)
+            uint32_t objectCount;
+            uint32_t compact;
+        };
+
+
+        struct ObjectRange {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        struct FrameResources {
+            VkBuffer objectBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+            void* objectMapped = nullptr;
+            VkBuffer batchBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory batchMemory = VK_NULL_HANDLE;
+            void* batchMapped = nullptr;
+            VkBuffer commandBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory commandMemory = VK_NULL_HANDLE;
+            VkBuffer countBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory countMemory = VK_NULL_HANDLE;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            uint32_t objectCapacity = 0;
+            uint32_t batchCapacity = 0;
+            uint64_t uploadedVersion = 0;
+            std::vector<ObjectRange> dirtyObjects;  // changed since this frame last uploaded
+        };
+
+        void createDescriptorSetLayout();
+        void createDescriptorPool();
+        void createPipelineLayouts();
+        void createCullPipeline(const std::string& cullShaderPath);
+
+        void prepareFrame(size_t frameIndex);
+        void createFrameBuffers(FrameResources& frame, uint32_t objectCapacity, uint32_t batchCapacity);
+        void destroyFrameBuffers(FrameResources& frame);
+        void writeDescriptorSet(FrameResources& frame);
+        void writeBatchData(FrameResources& frame);
+        void rebuildBatches();
+        void markObjectsDirty(uint32_t begin, uint32_t end);
+
+        Device& m_device;
+        VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+        VkPipelineLayout m_drawPipelineLayout = VK_NULL_HANDLE;
+        std::unique_ptr<Pipeline> m_cullPipeline;
+
+        std::vector<ObjectData> m_objects;
+        std::vector<Model*> m_objectModels;
+        std::vector<Model*> m_batches;
+        bool m_batchesDirty = false;
+        uint64_t m_version = 1;
+
+        std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frames;
+    };
+
+}
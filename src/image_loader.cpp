@@ -0,0 +1,270 @@
+#include "image_loader.h"
+#include "block_compression.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+
+namespace VKEngine {
+
+    namespace {
+
+        bool readFile(const std::string& path, std::vector<uint8_t>& bytes) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                return false;
+            }
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            return true;
+        }
+
+        void setSingleLevel(ImageData& image, uint32_t width, uint32_t height, VkFormat format) {
+            image.format = format;
+            image.width = width;
+            image.height = height;
+            image.data.assign(size_t(width) * height * 4, 0);
+            image.levels = {{0, image.data.size(), width, height}};
+        }
+
+        bool decodePpm(const std::vector<uint8_t>& bytes, VkFormat format, ImageData& image, std::string& error) {
+            // header: "P6" <whitespace/comments> width height maxval <single whitespace> pixels
+            size_t pos = 2;
+            auto nextNumber = [&](uint32_t& value) {
+                while (pos < bytes.size()) {
+                    if (bytes[pos] == '#') {
+                        while (pos < bytes.size() && bytes[pos] != '\n') pos++;
+                    }
+                    else if (std::isspace(bytes[pos])) {
+                        pos++;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                if (pos >= bytes.size() || !std::isdigit(bytes[pos])) {
+                    return false;
+                }
+                value = 0;
+                while (pos < bytes.size() && std::isdigit(bytes[pos])) {
+                    value = value * 10 + (bytes[pos++] - '0');
+                }
+                return true;
+            };
+
+            uint32_t width, height, maxValue;
+            if (!nextNumber(width) || !nextNumber(height) || !nextNumber(maxValue) || maxValue != 255) {
+                error = "unsupported PPM header";
+                return false;
+            }
+            if (pos >= bytes.size()) {
+                error = "truncated PPM data";
+                return false;
+            }
+            pos++;
+
+            if (width == 0 || height == 0 || bytes.size() - pos < size_t(width) * height * 3) {
+                error = "truncated PPM data";
+                return false;
+            }
+
+            setSingleLevel(image, width, height, format);
+            for (size_t i = 0; i < size_t(width) * height; i++) {
+                image.data[i * 4 + 0] = bytes[pos + i * 3 + 0];
+                image.data[i * 4 + 1] = bytes[pos + i * 3 + 1];
+                image.data[i * 4 + 2] = bytes[pos + i * 3 + 2];
+                image.data[i * 4 + 3] = 255;
+            }
+            return true;
+        }
+
+        bool decodeTga(const std::vector<uint8_t>& bytes, VkFormat format, ImageData& image, std::string& error) {
+            if (bytes.size() < 18) {
+                error = "truncated TGA header";
+                return false;
+            }
+            uint8_t idLength = bytes[0];
+            uint8_t colorMapType = bytes[1];
+            uint8_t imageType = bytes[2];
+            uint32_t width = bytes[12] | (bytes[13] << 8);
+            uint32_t height = bytes[14] | (bytes[15] << 8);
+            uint8_t bitsPerPixel = bytes[16];
+            bool topLeftOrigin = (bytes[17] & 0x20) != 0;
+
+            // 2 = uncompressed true colour, 10 = run-length encoded true colour
+            if (colorMapType != 0 || (imageType != 2 && imageType != 10) || (bitsPerPixel != 24 && bitsPerPixel != 32)) {
+                error = "unsupported TGA variant";
+                return false;
+            }
+            if (width == 0 || height == 0) {
+                error = "empty TGA image";
+                return false;
+            }
+
+            const size_t pixelSize = bitsPerPixel / 8;
+            const size_t pixelCount = size_t(width) * height;
+            size_t pos = 18 + idLength;
+            setSingleLevel(image, width, height, format);
+
+            auto writePixel = [&](size_t index, const uint8_t* bgra) {
+                // TGA rows start at the bottom unless the descriptor says otherwise
+                size_t x = index % width;
+                size_t y = index / width;
+                size_t row = topLeftOrigin ? y : height - 1 - y;
+                uint8_t* out = &image.data[(row * width + x) * 4];
+                out[0] = bgra[2];
+                out[1] = bgra[1];
+                out[2] = bgra[0];
+                out[3] = pixelSize == 4 ? bgra[3] : 255;
+            };
+
+            size_t index = 0;
+            while (index < pixelCount) {
+                if (imageType == 2) {
+                    if (pos + pixelSize > bytes.size()) break;
+                    writePixel(index++, &bytes[pos]);
+                    pos += pixelSize;
+                    continue;
+                }
+
+                if (pos >= bytes.size()) break;
+                uint8_t header = bytes[pos++];
+                size_t count = (header & 0x7F) + 1;
+                if (header & 0x80) {
+                    if (pos + pixelSize > bytes.size()) break;
+                    for (size_t i = 0; i < count && index < pixelCount; i++) {
+                        writePixel(index++, &bytes[pos]);
+                    }
+                    pos += pixelSize;
+                }
+                else {
+                    for (size_t i = 0; i < count && index < pixelCount; i++) {
+                        if (pos + pixelSize > bytes.size()) break;
+                        writePixel(index++, &bytes[pos]);
+                        pos += pixelSize;
+                    }
+                }
+            }
+
+            if (index < pixelCount) {
+                error = "truncated TGA data";
+                return false;
+            }
+            return true;
+        }
+
+        template <typename T>
+        T readLittleEndian(const std::vector<uint8_t>& bytes, size_t offset) {
+            T value = 0;
+            for (size_t i = 0; i < sizeof(T); i++) {
+                value |= T(bytes[offset + i]) << (8 * i);
+            }
+            return value;
+        }
+
+        bool decodeKtx2(const std::vector<uint8_t>& bytes, ImageData& image, std::string& error) {
+            constexpr size_t HEADER_SIZE = 80;
+            constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+            if (bytes.size() < HEADER_SIZE) {
+                error = "truncated KTX2 header";
+                return false;
+            }
+
+            VkFormat format = static_cast<VkFormat>(readLittleEndian<uint32_t>(bytes, 12));
+            uint32_t width = readLittleEndian<uint32_t>(bytes, 20);
+            uint32_t height = readLittleEndian<uint32_t>(bytes, 24);
+            uint32_t depth = readLittleEndian<uint32_t>(bytes, 28);
+            uint32_t layerCount = readLittleEndian<uint32_t>(bytes, 32);
+            uint32_t faceCount = readLittleEndian<uint32_t>(bytes, 36);
+            uint32_t levelCount = readLittleEndian<uint32_t>(bytes, 40);
+            uint32_t supercompression = readLittleEndian<uint32_t>(bytes, 44);
+
+            if (formatBlockBytes(format) == 0) {
+                error = "unsupported KTX2 format " + std::to_string(format);
+                return false;
+            }
+            if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+                error = "only single 2D KTX2 images are supported";
+                return false;
+            }
+            if (supercompression != 0) {
+                error = "supercompressed KTX2 files are not supported";
+                return false;
+            }
+
+            // the level count comes from the file: a full chain is the most a size can have
+            uint32_t maxLevels = 1;
+            while (maxLevels < 32 && (std::max(width, height) >> maxLevels) > 0) maxLevels++;
+            if (levelCount == 0 || levelCount > maxLevels) {
+                error = "invalid KTX2 level count " + std::to_string(levelCount);
+                return false;
+            }
+            if (bytes.size() < HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE) {
+                error = "truncated KTX2 level index";
+                return false;
+            }
+
+            image = {};
+            image.format = format;
+            image.width = width;
+            image.height = height;
+            for (uint32_t level = 0; level < levelCount; level++) {
+                size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+                uint64_t byteOffset = readLittleEndian<uint64_t>(bytes, entry);
+                uint64_t byteLength = readLittleEndian<uint64_t>(bytes, entry + 8);
+
+                uint32_t levelWidth = std::max(1u, width >> level);
+                uint32_t levelHeight = std::max(1u, height >> level);
+                size_t expected = levelByteSize(format, levelWidth, levelHeight);
+                if (byteLength != expected || byteOffset > bytes.size() || bytes.size() - byteOffset < byteLength) {
+                    error = "invalid KTX2 level " + std::to_string(level);
+                    return false;
+                }
+
+                // levels are stored smallest first in the file but kept largest first here
+                size_t offset = image.data.size();
+                image.data.insert(image.data.end(), bytes.begin() + byteOffset, bytes.begin() + byteOffset + byteLength);
+                image.levels.push_back({offset, expected, levelWidth, levelHeight});
+            }
+            return true;
+        }
+
+        bool hasExtension(const std::string& path, const char* extension) {
+            std::string lower;
+            for (char c : path) {
+                lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            std::string suffix = extension;
+            return lower.size() >= suffix.size() && lower.compare(lower.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+    }
+
+    bool loadImage(const std::string& path, bool srgb, ImageData& image, std::string& error) {
+        std::vector<uint8_t> bytes;
+        if (!readFile(path, bytes)) {
+            error = "failed to open " + path;
+            return false;
+        }
+        return decodeImage(path, bytes, srgb, image, error);
+    }
+
+    bool decodeImage(const std::string& path, const std::vector<uint8_t>& bytes, bool srgb, ImageData& image, std::string& error) {
+        if (bytes.size() >= sizeof(KTX2_IDENTIFIER) && std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+            return decodeKtx2(bytes, image, error);
+        }
+
+        VkFormat format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        if (bytes.size() >= 2 && bytes[0] == 'P' && bytes[1] == '6') {
+            return decodePpm(bytes, format, image, error);
+        }
+        if (hasExtension(path, ".tga")) {
+            return decodeTga(bytes, format, image, error);
+        }
+
+        error = "unrecognised image format: " + path;
+        return false;
+    }
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VKEngine {
+
+    // Decoded image ready for upload: every level's texels back to back in data, largest level first
+    struct ImageData {
+        struct Level {
+            size_t offset;
+            size_t size;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<Level> levels;
+        std::vector<uint8_t> data;
+    };
+
+    inline constexpr uint8_t KTX2_IDENTIFIER[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    // Decodes binary PPM (P6) and uncompressed or RLE TGA files into single-level RGBA8 images, and
+    // reads KTX2 files holding RGBA8 or BC1/BC3/BC5/BC7 data with their stored mip chain as is.
+    // The srgb flag only applies to the PPM/TGA paths; KTX2 files carry their own format.
+    // Thread-safe; returns false and fills error on failure.
+    bool loadImage(const std::string& path, bool srgb, ImageData& image, std::string& error);
+
+    // Same, for a file already read into memory; the path only picks the format when the contents can't
+    bool decodeImage(const std::string& path, const std::vector<uint8_t>& bytes, bool srgb, ImageData& image,
+                     std::string& error);
+
+}
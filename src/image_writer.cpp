@@ -0,0 +1,119 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace VKEngine {
+
+    namespace {
+
+        constexpr size_t MAX_STORED_BLOCK = 65535;
+
+        const std::array<uint32_t, 256>& crcTable() {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> t{};
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    t[n] = c;
+                }
+                return t;
+            }();
+            return table;
+        }
+
+        uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+            const std::array<uint32_t, 256>& table = crcTable();
+            for (size_t i = 0; i < size; i++) {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+        void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+            out.push_back(static_cast<uint8_t>(value >> 24));
+            out.push_back(static_cast<uint8_t>(value >> 16));
+            out.push_back(static_cast<uint8_t>(value >> 8));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        void appendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+            appendBigEndian(out, static_cast<uint32_t>(data.size()));
+            size_t typeOffset = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data.begin(), data.end());
+            uint32_t crc = updateCrc(0xFFFFFFFFu, out.data() + typeOffset, out.size() - typeOffset) ^ 0xFFFFFFFFu;
+            appendBigEndian(out, crc);
+        }
+
+    }
+
+    bool writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba, std::string& error) {
+        std::vector<uint8_t> header;
+        appendBigEndian(header, width);
+        appendBigEndian(header, height);
+        header.insert(header.end(), {8, 6, 0, 0, 0});  // 8-bit RGBA, deflate, adaptive filtering, no interlace
+
+        // scanlines each prefixed with filter type 0 (none)
+        size_t rowBytes = size_t(width) * 4;
+        size_t rawSize = (rowBytes + 1) * height;
+        size_t blockCount = (rawSize + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+
+        std::vector<uint8_t> zlib;
+        zlib.reserve(2 + rawSize + blockCount * 5 + 4);
+        zlib.push_back(0x78);  // deflate, 32K window
+        zlib.push_back(0x01);  // no preset dictionary, check bits
+
+        uint32_t adlerA = 1;
+        uint32_t adlerB = 0;
+        size_t blockRemaining = 0;
+        size_t written = 0;
+        auto put = [&](uint8_t byte) {
+            if (blockRemaining == 0) {
+                size_t length = std::min(MAX_STORED_BLOCK, rawSize - written);
+                zlib.push_back(written + length == rawSize ? 1 : 0);  // BFINAL, BTYPE 00
+                zlib.push_back(static_cast<uint8_t>(length));
+                zlib.push_back(static_cast<uint8_t>(length >> 8));
+                zlib.push_back(static_cast<uint8_t>(~length));
+                zlib.push_back(static_cast<uint8_t>(~length >> 8));
+                blockRemaining = length;
+            }
+            zlib.push_back(byte);
+            blockRemaining--;
+            written++;
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        };
+        for (uint32_t y = 0; y < height; y++) {
+            put(0);
+            const uint8_t* row = rgba + y * rowBytes;
+            for (size_t x = 0; x < rowBytes; x++) {
+                put(row[x]);
+            }
+        }
+        appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+        std::vector<uint8_t> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        file.reserve(file.size() + zlib.size() + 64);
+        appendChunk(file, "IHDR", header);
+        appendChunk(file, "IDAT", zlib);
+        appendChunk(file, "IEND", {});
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            error = "failed to open " + path;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!out) {
+            error = "failed to write " + path;
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace VKEngine {
+
+    // Writes tightly packed RGBA8 pixels as a PNG. The image data is stored with deflate's
+    // uncompressed blocks: files are larger than a real encoder's, but writing costs little more
+    // than the copy, which keeps up with capturing every frame.
+    // Thread-safe; returns false and fills error on failure.
+    bool writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba, std::string& error);
+
+}
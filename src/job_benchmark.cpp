@@ -0,0 +1,103 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace VKEngine {
+
+    namespace {
+
+        constexpr size_t LOOP_ITEMS = 1 << 22;
+        constexpr size_t LOOP_BATCH = 1024;
+        constexpr uint32_t TREE_DEPTH = 14;     // 2^14 leaf jobs
+        constexpr uint32_t LEAF_WORK = 500;     // iterations per leaf, a few microseconds
+        constexpr int REPEATS = 5;
+
+        volatile double g_sink = 0.0;
+
+        double leafWork(uint32_t seed, uint32_t iterations) {
+            double value = seed;
+            for (uint32_t i = 0; i < iterations; i++) {
+                value = std::sqrt(value * 1.0001 + i);
+            }
+            return value;
+        }
+
+        // fork-join: every node starts two children and waits on them, so waits nest
+        void forkTree(JobSystem& jobs, uint32_t depth, uint32_t seed, std::atomic<uint64_t>& leaves) {
+            if (depth == 0) {
+                g_sink = leafWork(seed, LEAF_WORK);
+                leaves.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            JobCounter counter;
+            jobs.run([&jobs, depth, seed, &leaves]() { forkTree(jobs, depth - 1, seed * 2, leaves); }, &counter);
+            forkTree(jobs, depth - 1, seed * 2 + 1, leaves);
+            jobs.wait(counter);
+        }
+
+        template <typename F>
+        double bestMillis(F&& function) {
+            double best = 1e30;
+            for (int i = 0; i < REPEATS; i++) {
+                auto start = std::chrono::steady_clock::now();
+                function();
+                auto end = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            return best;
+        }
+
+    }
+
+    int runJobBenchmark() {
+        size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<float> data(LOOP_ITEMS);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<float>(i % 1000) * 0.01f;
+        }
+
+        std::printf("job system scaling, best of %d runs\n", REPEATS);
+        std::printf("%8s | %12s %8s %6s | %12s %8s %6s\n",
+                    "threads", "parallelFor", "speedup", "eff", "fork-join", "speedup", "eff");
+
+        double loopBase = 0.0;
+        double treeBase = 0.0;
+        for (size_t threads = 1; threads <= maxThreads; threads++) {
+            // the calling thread counts as one of them
+            JobSystem jobs(threads - 1, true);
+
+            double loopMillis = bestMillis([&]() {
+                std::atomic<uint64_t> total{0};
+                jobs.parallelFor(data.size(), LOOP_BATCH, [&](size_t begin, size_t end) {
+                    double sum = 0.0;
+                    for (size_t i = begin; i < end; i++) {
+                        sum += std::sqrt(data[i]) * std::sin(data[i]);
+                    }
+                    total.fetch_add(static_cast<uint64_t>(sum), std::memory_order_relaxed);
+                });
+                g_sink = static_cast<double>(total.load());
+            });
+
+            double treeMillis = bestMillis([&]() {
+                std::atomic<uint64_t> leaves{0};
+                forkTree(jobs, TREE_DEPTH, 1, leaves);
+            });
+
+            if (threads == 1) {
+                loopBase = loopMillis;
+                treeBase = treeMillis;
+            }
+            double loopSpeedup = loopBase / loopMillis;
+            double treeSpeedup = treeBase / treeMillis;
+            std::printf("%8zu | %9.2f ms %7.2fx %5.0f%% | %9.2f ms %7.2fx %5.0f%%\n", threads,
+                        loopMillis, loopSpeedup, 100.0 * loopSpeedup / threads,
+                        treeMillis, treeSpeedup, 100.0 * treeSpeedup / threads);
+        }
+        return 0;
+    }
+
+}
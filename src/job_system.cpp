@@ -0,0 +1,378 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace VKEngine {
+
+    struct Job {
+        JobSystem::Function function;
+        // parallelFor jobs carry a range instead of a function, so splitting doesn't allocate
+        const JobSystem::RangeFunction* range = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t batchSize = 0;
+        JobCounter* counter = nullptr;
+    };
+
+    namespace {
+
+        constexpr size_t MAX_CACHED_JOBS = 256;
+
+        // jobs are freed by whichever thread ran them and reused by the next job that thread starts
+        struct JobCache {
+            std::vector<Job*> jobs;
+            ~JobCache() {
+                for (Job* job : jobs) {
+                    delete job;
+                }
+            }
+        };
+
+        thread_local JobCache t_jobCache;
+        thread_local JobSystem* t_system = nullptr;  // the pool this thread is a worker of
+        thread_local size_t t_workerIndex = 0;
+        thread_local uint32_t t_random = 0x9e3779b9u;
+
+        Job* allocateJob() {
+            if (t_jobCache.jobs.empty()) {
+                return new Job();
+            }
+            Job* job = t_jobCache.jobs.back();
+            t_jobCache.jobs.pop_back();
+            return job;
+        }
+
+        void recycleJob(Job* job) {
+            if (t_jobCache.jobs.size() >= MAX_CACHED_JOBS) {
+                delete job;
+                return;
+            }
+            job->function = nullptr;
+            job->range = nullptr;
+            job->counter = nullptr;
+            t_jobCache.jobs.push_back(job);
+        }
+
+        uint32_t nextRandom() {
+            // xorshift32, only used to spread steal attempts
+            t_random ^= t_random << 13;
+            t_random ^= t_random >> 17;
+            t_random ^= t_random << 5;
+            return t_random;
+        }
+
+        void pinToCore(std::thread& thread, size_t slot) {
+#if defined(__linux__)
+            // cores outside the process's affinity mask can't be used, e.g. under taskset or in containers
+            cpu_set_t allowed;
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+                return;
+            }
+            size_t target = slot % static_cast<size_t>(CPU_COUNT(&allowed));
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(cpu, &set);
+                    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+                    return;
+                }
+            }
+#elif defined(_WIN32)
+            size_t cores = std::max(1u, std::thread::hardware_concurrency());
+            SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (slot % cores));
+#else
+            (void)thread;
+            (void)slot;
+#endif
+        }
+
+    }
+
+    WorkStealingDeque::WorkStealingDeque(size_t capacity)
+        : m_buffer(new std::atomic<Job*>[capacity]), m_mask(static_cast<int64_t>(capacity) - 1) {
+        assert((capacity & (capacity - 1)) == 0 && "Deque capacity must be a power of two.");
+    }
+
+    bool WorkStealingDeque::push(Job* job) {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top > m_mask) {
+            return false;
+        }
+        m_buffer[bottom & m_mask].store(job, std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job* WorkStealingDeque::pop() {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = m_buffer[bottom & m_mask].load(std::memory_order_acquire);
+        if (top == bottom) {
+            // last element: race the thieves for it
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job* WorkStealingDeque::steal() {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+        Job* job = m_buffer[top & m_mask].load(std::memory_order_acquire);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+    JobSystem::JobSystem(size_t workerCount, bool pinWorkers) {
+        m_workers.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; i++) {
+            m_workers.push_back(std::make_unique<Worker>(DEQUE_CAPACITY));
+        }
+        // every deque exists before the first worker can try to steal from it
+        for (size_t i = 0; i < workerCount; i++) {
+            m_workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+            if (pinWorkers) {
+                // the first core is left to the thread that created the pool
+                pinToCore(m_workers[i]->thread, i + 1);
+            }
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) {
+            worker->thread.join();
+        }
+        assert(m_queued.load() == 0 && "Job system destroyed with jobs still queued.");
+    }
+
+    JobSystem& JobSystem::shared() {
+        // hardware_concurrency() may report 0
+        static JobSystem system(std::max(1u, std::thread::hardware_concurrency()) - 1, true);
+        return system;
+    }
+
+    void JobSystem::run(Function function, JobCounter* counter) {
+        Job* job = allocateJob();
+        job->function = std::move(function);
+        job->counter = counter;
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        submit(job);
+    }
+
+    void JobSystem::runBackground(Function function, JobCounter* counter) {
+        Job* job = allocateJob();
+        job->function = std::move(function);
+        job->counter = counter;
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (m_workers.empty()) {
+            execute(job);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_backgroundMutex);
+            m_backgroundJobs.push_back(job);
+            m_backgroundCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_queued.fetch_add(1, std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wake.notify_one();
+        }
+    }
+
+    void JobSystem::submit(Job* job) {
+        // without workers nobody would pick the job up unless its starter waited for it
+        if (m_workers.empty()) {
+            execute(job);
+            return;
+        }
+        if (t_system == this) {
+            if (!m_workers[t_workerIndex]->deque.push(job)) {
+                // a full deque means plenty of queued work already; this one runs right away
+                execute(job);
+                return;
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> lock(m_externalMutex);
+            m_externalJobs.push_back(job);
+            m_externalCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // pairs with the sleeping worker checking m_queued after announcing itself
+        m_queued.fetch_add(1, std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wake.notify_one();
+        }
+    }
+
+    Job* JobSystem::findJob(bool includeBackground) {
+        Job* job = nullptr;
+        bool isWorker = t_system == this;
+        if (isWorker) {
+            job = m_workers[t_workerIndex]->deque.pop();
+        }
+        if (job == nullptr && m_externalCount.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_externalMutex);
+            if (!m_externalJobs.empty()) {
+                job = m_externalJobs.front();
+                m_externalJobs.pop_front();
+                m_externalCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if (job == nullptr && !m_workers.empty()) {
+            size_t start = nextRandom() % m_workers.size();
+            for (size_t i = 0; i < m_workers.size() && job == nullptr; i++) {
+                size_t victim = (start + i) % m_workers.size();
+                if (!(isWorker && victim == t_workerIndex)) {
+                    job = m_workers[victim]->deque.steal();
+                }
+            }
+        }
+        // last, so background work only runs when nothing else is waiting for a thread
+        if (job == nullptr && includeBackground && m_backgroundCount.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_backgroundMutex);
+            if (!m_backgroundJobs.empty()) {
+                job = m_backgroundJobs.front();
+                m_backgroundJobs.pop_front();
+                m_backgroundCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if (job != nullptr) {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    void JobSystem::execute(Job* job) {
+        if (job->range != nullptr) {
+            runRange(job->begin, job->end, job->batchSize, *job->range, *job->counter);
+        }
+        else {
+            job->function();
+        }
+        JobCounter* counter = job->counter;
+        recycleJob(job);
+        // last touch of the counter: the waiter may return and destroy it right after
+        if (counter != nullptr) {
+            counter->pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void JobSystem::wait(JobCounter& counter) {
+        while (!counter.isDone()) {
+            if (Job* job = findJob(false)) {
+                execute(job);
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void JobSystem::parallelFor(size_t count, size_t minBatch, const RangeFunction& function) {
+        if (count == 0) {
+            return;
+        }
+        minBatch = std::max<size_t>(minBatch, 1);
+
+        // small loops are not worth waking anyone up for
+        if (m_workers.empty() || count <= minBatch) {
+            function(0, count);
+            return;
+        }
+
+        // a few batches per thread keeps the load balanced when some threads are busy elsewhere
+        size_t threadCount = m_workers.size() + 1;
+        size_t batchSize = std::max(minBatch, (count + threadCount * 4 - 1) / (threadCount * 4));
+
+        JobCounter counter;
+        runRange(0, count, batchSize, function, counter);
+        wait(counter);
+    }
+
+    void JobSystem::runRange(size_t begin, size_t end, size_t batchSize, const RangeFunction& function,
+                             JobCounter& counter) {
+        // hand the upper half to whoever steals it and keep splitting the lower half
+        while (end - begin > batchSize) {
+            size_t middle = begin + (end - begin) / 2;
+            Job* job = allocateJob();
+            job->range = &function;
+            job->begin = middle;
+            job->end = end;
+            job->batchSize = batchSize;
+            job->counter = &counter;
+            counter.pending.fetch_add(1, std::memory_order_relaxed);
+            submit(job);
+            end = middle;
+        }
+        function(begin, end);
+    }
+
+    void JobSystem::workerLoop(size_t index) {
+        t_system = this;
+        t_workerIndex = index;
+        t_random ^= static_cast<uint32_t>(index + 1) * 0x85ebca6bu;
+
+        uint32_t idleSpins = 0;
+        while (true) {
+            if (Job* job = findJob(true)) {
+                execute(job);
+                idleSpins = 0;
+                continue;
+            }
+            if (m_stopping.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (++idleSpins < IDLE_SPINS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+            m_wake.wait(lock, [this]() {
+                return m_stopping.load(std::memory_order_relaxed) || m_queued.load(std::memory_order_seq_cst) > 0;
+            });
+            m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+            idleSpins = 0;
+        }
+    }
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VKEngine {
+
+    struct Job;
+
+    // Chase-Lev work-stealing deque of fixed capacity. The owning thread pushes and pops at the
+    // bottom without contention; any other thread may steal from the top. Only the last element
+    // is ever contended, and then a single compare-exchange decides who gets it.
+    class WorkStealingDeque {
+    public:
+        explicit WorkStealingDeque(size_t capacity);  // power of two
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque&) = delete;
+
+        // Owner only. Returns false when full.
+        bool push(Job* job);
+        Job* pop();
+        // Any thread; nullptr when empty or another thread won the race
+        Job* steal();
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::unique_ptr<std::atomic<Job*>[]> m_buffer;
+        int64_t m_mask;
+    };
+
+    // Fork-join counter: incremented for every job started against it, decremented as each one
+    // finishes. A counter must outlive the jobs it tracks, which wait() guarantees.
+    struct JobCounter {
+        std::atomic<uint32_t> pending{0};
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    // Engine-wide task scheduler. Every worker owns a work-stealing deque, takes jobs from its own
+    // bottom and steals from the top of a random other deque when it runs dry; jobs started on a
+    // worker go to its own deque, so nested parallelism stays local until someone is idle. Threads
+    // outside the pool hand their jobs over through a shared queue. Workers are pinned to cores
+    // where the platform allows it, and sleep when no work is left.
+    //
+    // A thread waiting on a counter runs jobs instead of blocking, so any thread, including the
+    // main thread, can fork work and take part in it, and nested waits can't deadlock the pool.
+    // Background jobs are the exception: they sit in a lane of their own that only idle workers
+    // take from, so long work such as asset decoding never ends up inside a frame's wait().
+    class JobSystem {
+    public:
+        using Function = std::function<void()>;
+        using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+        static constexpr size_t DEQUE_CAPACITY = 4096;
+
+        JobSystem(size_t workerCount, bool pinWorkers);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem &operator=(const JobSystem&) = delete;
+
+        // One pinned worker per additional hardware thread
+        static JobSystem& shared();
+
+        size_t workerCount() const { return m_workers.size(); }
+
+        // Starts a job, counted against counter if given
+        void run(Function function, JobCounter* counter = nullptr);
+
+        // Starts a long, latency-tolerant job that only idle workers pick up. Without workers it
+        // runs right away on the calling thread.
+        void runBackground(Function function, JobCounter* counter = nullptr);
+
+        // Runs jobs until the counter reaches zero; never takes background jobs
+        void wait(JobCounter& counter);
+
+        // Splits [0, count) into batches of at least minBatch items and returns once all are done.
+        // Ranges are split in halves, so the batches other threads steal stay large.
+        void parallelFor(size_t count, size_t minBatch, const RangeFunction& function);
+
+    private:
+        struct Worker {
+            explicit Worker(size_t capacity) : deque(capacity) {}
+            WorkStealingDeque deque;
+            std::thread thread;
+        };
+
+        static constexpr uint32_t IDLE_SPINS = 64;  // look for work this often before sleeping
+
+        void submit(Job* job);
+        Job* findJob(bool includeBackground);
+        void execute(Job* job);
+        void runRange(size_t begin, size_t end, size_t batchSize, const RangeFunction& function, JobCounter& counter);
+        void workerLoop(size_t index);
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+
+        // jobs started by threads outside the pool
+        std::mutex m_externalMutex;
+        std::deque<Job*> m_externalJobs;
+        std::atomic<size_t> m_externalCount{0};
+
+        // background jobs, from any thread
+        std::mutex m_backgroundMutex;
+        std::deque<Job*> m_backgroundJobs;
+        std::atomic<size_t> m_backgroundCount{0};
+
+        // sleeping workers; m_queued is an estimate that only has to be non-zero while jobs exist
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wake;
+        std::atomic<int64_t> m_queued{0};
+        std::atomic<uint32_t> m_sleeping{0};
+        std::atomic<bool> m_stopping{false};
+    };
+
+    // Times parallelFor and fork-join workloads with 1..N threads and prints the speedup.
+    // Run with --bench-jobs.
+    int runJobBenchmark();
+
+}
@@ -0,0 +1,124 @@
+#include "launch_profile.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    namespace {
+
+        constexpr VkDebugUtilsMessageSeverityFlagsEXT WARNINGS_AND_ERRORS =
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+
+        // the command line wins over the environment
+        const char* findOption(int argc, char** argv, const char* option, const char* variable) {
+            size_t length = std::strlen(option);
+            for (int i = 1; i < argc; i++) {
+                if (std::strcmp(argv[i], option) == 0) {
+                    if (i + 1 >= argc) {
+                        throw std::runtime_error(std::string("missing value for ") + option + "!");
+                    }
+                    return argv[i + 1];
+                }
+                if (std::strncmp(argv[i], option, length) == 0 && argv[i][length] == '=') {
+                    return argv[i] + length + 1;
+                }
+            }
+            return std::getenv(variable);
+        }
+
+        LaunchProfile::Kind parseKind(const std::string& name) {
+            if (name == "release") {
+                return LaunchProfile::Kind::Release;
+            }
+            if (name == "validation") {
+                return LaunchProfile::Kind::Validation;
+            }
+            if (name == "gpu-assisted") {
+                return LaunchProfile::Kind::GpuAssisted;
+            }
+            if (name == "sync") {
+                return LaunchProfile::Kind::Synchronization;
+            }
+            throw std::runtime_error("unknown launch profile " + name + "!");
+        }
+
+        // the lowest severity still reported, everything above it included
+        VkDebugUtilsMessageSeverityFlagsEXT parseSeverity(const std::string& name) {
+            if (name == "verbose") {
+                return VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT
+                    | WARNINGS_AND_ERRORS;
+            }
+            if (name == "info") {
+                return VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT | WARNINGS_AND_ERRORS;
+            }
+            if (name == "warning") {
+                return WARNINGS_AND_ERRORS;
+            }
+            if (name == "error") {
+                return VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+            }
+            throw std::runtime_error("unknown validation severity " + name + "!");
+        }
+
+    }
+
+    LaunchProfile LaunchProfile::make(Kind kind) {
+        LaunchProfile profile;
+        profile.kind = kind;
+        if (kind == Kind::Release) {
+            return profile;
+        }
+        profile.validationLayers = true;
+        profile.debugMessenger = true;
+        profile.severities = WARNINGS_AND_ERRORS;
+
+        if (kind == Kind::GpuAssisted) {
+            profile.validationFeatures = {
+                VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT,
+                VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT,
+            };
+            profile.shaderStoresAndAtomics = true;
+        }
+        else if (kind == Kind::Synchronization) {
+            profile.validationFeatures = {VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT};
+        }
+        return profile;
+    }
+
+    LaunchProfile LaunchProfile::select(int argc, char** argv) {
+#if defined(DEBUG)
+        Kind kind = Kind::Validation;
+#else
+        Kind kind = Kind::Release;
+#endif
+        if (const char* name = findOption(argc, argv, "--profile", "VKENGINE_PROFILE")) {
+            kind = parseKind(name);
+        }
+        LaunchProfile profile = make(kind);
+
+        if (const char* severity = findOption(argc, argv, "--severity", "VKENGINE_SEVERITY")) {
+            profile.severities = parseSeverity(severity);
+        }
+        if (const char* device = findOption(argc, argv, "--gpu", "VKENGINE_GPU")) {
+            profile.preferredDevice = device;
+        }
+        return profile;
+    }
+
+    const char* LaunchProfile::name() const {
+        switch (kind) {
+            case Kind::Release:
+                return "release";
+            case Kind::Validation:
+                return "validation";
+            case Kind::GpuAssisted:
+                return "gpu-assisted";
+            case Kind::Synchronization:
+                return "sync";
+        }
+        return "unknown";
+    }
+
+}
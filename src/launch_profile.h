@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace VKEngine {
+
+    // How much debugging the Vulkan instance and device are created with. Release loads no layers
+    // and installs no debug messenger, so it pays nothing for validation. The other profiles load the
+    // Khronos validation layer; gpu-assisted and sync also turn on the layer's shader instrumentation
+    // and synchronization checks, which are much slower again and only worth it while hunting a bug.
+    //
+    // Debug builds (DEBUG defined) start with validation, the others with release.
+    struct LaunchProfile {
+        enum class Kind {
+            Release,
+            Validation,
+            GpuAssisted,
+            Synchronization,
+        };
+
+        Kind kind = Kind::Release;
+        bool validationLayers = false;
+        bool debugMessenger = false;
+        VkDebugUtilsMessageSeverityFlagsEXT severities = 0;  // reported by the messenger
+        std::vector<VkValidationFeatureEnableEXT> validationFeatures;
+        bool shaderStoresAndAtomics = false;  // device features GPU-assisted validation instruments with
+        std::string preferredDevice;  // GPU name substring or UUID, overriding the automatic choice
+
+        static LaunchProfile make(Kind kind);
+
+        // Takes "--profile <name>" or "--profile=<name>", else VKENGINE_PROFILE, else the build default;
+        // names are release, validation, gpu-assisted and sync. "--severity" or VKENGINE_SEVERITY set to
+        // verbose, info, warning or error replaces the profile's messenger filter. "--gpu" or VKENGINE_GPU
+        // picks the GPU by name or UUID. Throws on unknown values.
+        static LaunchProfile select(int argc, char** argv);
+
+        const char* name() const;
+    };
+
+}
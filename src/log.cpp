@@ -0,0 +1,290 @@
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace VKEngine {
+
+    namespace {
+
+        constexpr int64_t NANOS_PER_SECOND = 1000000000;
+        constexpr auto REPEAT_CHECK_INTERVAL = std::chrono::milliseconds(250);
+
+        int64_t nowNanos() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        uint64_t hashText(const std::string& text) {
+            uint64_t hash = 14695981039346656037ull;  // FNV-1a
+            for (char c : text) {
+                hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+            }
+            return hash;
+        }
+
+        const char* levelPrefix(LogLevel level) {
+            switch (level) {
+                case LogLevel::Debug: return "[debug] ";
+                case LogLevel::Info: return "";
+                case LogLevel::Warn: return "[warn] ";
+                case LogLevel::Error: return "[error] ";
+            }
+            return "";
+        }
+
+        std::string repeatSummary(const char* text, uint32_t repeats) {
+            return std::string(text) + " (repeated " + std::to_string(repeats) + " times)";
+        }
+
+        class SiteLock {
+        public:
+            explicit SiteLock(std::atomic_flag& flag) : m_flag(flag) {
+                while (m_flag.test_and_set(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+            }
+            ~SiteLock() { m_flag.clear(std::memory_order_release); }
+
+        private:
+            std::atomic_flag& m_flag;
+        };
+
+    }
+
+    LogSite::LogSite(LogLevel level) : m_level(level) {
+        Logger::instance().registerSite(*this);
+    }
+
+    Logger& Logger::instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    Logger::Logger() {
+        for (size_t i = 0; i < QUEUE_CAPACITY; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_writer = std::thread([this]() { writerLoop(); });
+    }
+
+    Logger::~Logger() {
+        // whatever is still queued, and any pending repeat counts, are written before exit
+        m_stopping.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_writerIdle.store(false, std::memory_order_relaxed);
+        }
+        m_wake.notify_one();
+        m_writer.join();
+    }
+
+    void Logger::registerSite(LogSite& site) {
+        LogSite* head = m_sites.load(std::memory_order_relaxed);
+        do {
+            site.m_next = head;
+        } while (!m_sites.compare_exchange_weak(head, &site, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void Logger::log(LogSite& site, const std::string& message) {
+        // trailing newlines are dropped, every record is written as one line
+        size_t length = message.size();
+        while (length > 0 && message[length - 1] == '\n') {
+            length--;
+        }
+        std::string text = message.substr(0, length);
+        uint64_t hash = hashText(text);
+        int64_t now = nowNanos();
+
+        std::string summary;
+        {
+            SiteLock lock(site.m_busy);
+            if (hash == site.m_lastHash && site.m_lastEmitNanos != 0) {
+                site.m_repeats++;
+                if (now - site.m_lastEmitNanos < NANOS_PER_SECOND) {
+                    return;
+                }
+                summary = repeatSummary(site.m_lastText, site.m_repeats);
+                site.m_repeats = 0;
+                site.m_lastEmitNanos = now;
+                text.clear();
+            }
+            else {
+                if (site.m_repeats > 0) {
+                    summary = repeatSummary(site.m_lastText, site.m_repeats);
+                    site.m_repeats = 0;
+                }
+
+                if (now - site.m_windowStartNanos >= NANOS_PER_SECOND) {
+                    site.m_windowStartNanos = now;
+                    site.m_windowCount = 0;
+                }
+                if (site.m_windowCount >= SITE_RECORDS_PER_SECOND) {
+                    site.m_suppressed++;
+                    text.clear();
+                }
+                else {
+                    site.m_windowCount++;
+                    site.m_lastHash = hash;
+                    site.m_lastEmitNanos = now;
+                    size_t copied = std::min(text.size(), LogSite::MAX_SUMMARY_TEXT - 1);
+                    std::memcpy(site.m_lastText, text.data(), copied);
+                    site.m_lastText[copied] = '\0';
+                    if (site.m_suppressed > 0) {
+                        text += " (" + std::to_string(site.m_suppressed) + " similar suppressed)";
+                        site.m_suppressed = 0;
+                    }
+                }
+            }
+        }
+
+        if (!summary.empty()) {
+            enqueue(site.m_level, std::move(summary));
+        }
+        if (!text.empty()) {
+            enqueue(site.m_level, std::move(text));
+        }
+    }
+
+    bool Logger::enqueue(LogLevel level, std::string text) {
+        // bounded multi-producer queue: a producer claims a cell by advancing the enqueue position,
+        // fills it and publishes it through the cell's sequence number
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & (QUEUE_CAPACITY - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (difference == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->level = level;
+        cell->text = std::move(text);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wakeWriter();
+        return true;
+    }
+
+    void Logger::wakeWriter() {
+        // pairs with the fence in writerLoop: either the writer sees the record, or this sees it idle
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_writerIdle.load(std::memory_order_relaxed) || !m_writerIdle.exchange(false)) {
+            return;
+        }
+        { std::lock_guard<std::mutex> lock(m_wakeMutex); }
+        m_wake.notify_one();
+    }
+
+    bool Logger::hasRecord() const {
+        const Cell& cell = m_cells[m_dequeuePos & (QUEUE_CAPACITY - 1)];
+        return cell.sequence.load(std::memory_order_acquire) == m_dequeuePos + 1;
+    }
+
+    bool Logger::dequeue(LogLevel& level, std::string& text) {
+        Cell& cell = m_cells[m_dequeuePos & (QUEUE_CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+            return false;
+        }
+        level = cell.level;
+        text = std::move(cell.text);
+        cell.sequence.store(m_dequeuePos + QUEUE_CAPACITY, std::memory_order_release);
+        m_dequeuePos++;
+        return true;
+    }
+
+    void Logger::flushRepeats(bool force) {
+        int64_t now = nowNanos();
+        for (LogSite* site = m_sites.load(std::memory_order_acquire); site != nullptr; site = site->m_next) {
+            std::string summary;
+            std::string suppressed;
+            {
+                SiteLock lock(site->m_busy);
+                if (site->m_repeats > 0 && (force || now - site->m_lastEmitNanos >= NANOS_PER_SECOND)) {
+                    summary = repeatSummary(site->m_lastText, site->m_repeats);
+                    site->m_repeats = 0;
+                    site->m_lastEmitNanos = now;
+                }
+                if (site->m_suppressed > 0 && (force || now - site->m_windowStartNanos >= NANOS_PER_SECOND)) {
+                    suppressed = std::to_string(site->m_suppressed) + " more like \"" + site->m_lastText + "\" suppressed";
+                    site->m_suppressed = 0;
+                }
+            }
+            if (!summary.empty()) {
+                enqueue(site->m_level, std::move(summary));
+            }
+            if (!suppressed.empty()) {
+                enqueue(site->m_level, std::move(suppressed));
+            }
+        }
+    }
+
+    void Logger::writerLoop() {
+        auto lastRepeatCheck = std::chrono::steady_clock::now();
+        uint64_t reportedDrops = 0;
+        LogLevel level;
+        std::string text;
+
+        while (true) {
+            bool stopping = m_stopping.load(std::memory_order_acquire);
+            if (stopping) {
+                flushRepeats(true);
+            }
+            else if (std::chrono::steady_clock::now() - lastRepeatCheck >= REPEAT_CHECK_INTERVAL) {
+                flushRepeats(false);
+                lastRepeatCheck = std::chrono::steady_clock::now();
+            }
+
+            bool wroteOut = false;
+            bool wroteErr = false;
+            while (dequeue(level, text)) {
+                std::ostream& out = level >= LogLevel::Warn ? std::cerr : std::cout;
+                out << levelPrefix(level) << text << '\n';
+                (level >= LogLevel::Warn ? wroteErr : wroteOut) = true;
+            }
+            uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+            if (dropped != reportedDrops) {
+                std::cerr << "[warn] log queue full, " << (dropped - reportedDrops) << " records dropped\n";
+                reportedDrops = dropped;
+                wroteErr = true;
+            }
+            if (wroteOut) {
+                std::cout.flush();
+            }
+            if (wroteErr) {
+                std::cerr.flush();
+            }
+
+            if (stopping) {
+                return;
+            }
+            if (wroteOut || wroteErr) {
+                continue;
+            }
+
+            // sleep until a record arrives, waking only to report repeat counts
+            m_writerIdle.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (hasRecord() || m_stopping.load(std::memory_order_acquire)) {
+                m_writerIdle.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_until(lock, lastRepeatCheck + REPEAT_CHECK_INTERVAL,
+                [this]() { return !m_writerIdle.load(std::memory_order_relaxed); });
+            m_writerIdle.store(false, std::memory_order_relaxed);
+        }
+    }
+
+}
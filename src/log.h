@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Lowest level that is compiled in: 0 debug, 1 info, 2 warn, 3 error
+#ifndef VKENGINE_LOG_LEVEL
+#if defined(DEBUG)
+#define VKENGINE_LOG_LEVEL 0
+#else
+#define VKENGINE_LOG_LEVEL 1
+#endif
+#endif
+
+namespace VKEngine {
+
+    enum class LogLevel : int {
+        Debug = 0,
+        Info = 1,
+        Warn = 2,
+        Error = 3,
+    };
+
+    // State of one LOG_* statement. A message identical to the site's previous one is counted
+    // instead of printed and reported as "(repeated N times)" once a second; distinct messages beyond
+    // the per-second limit are counted and reported with the next one that gets through.
+    // Trivially destructible, so statements running during static destruction stay safe.
+    class LogSite {
+    public:
+        explicit LogSite(LogLevel level);
+
+        LogSite(const LogSite&) = delete;
+        LogSite &operator=(const LogSite&) = delete;
+
+    private:
+        friend class Logger;
+        static constexpr size_t MAX_SUMMARY_TEXT = 160;
+
+        LogLevel m_level;
+        std::atomic_flag m_busy;  // held for a few instructions, never across I/O
+        uint64_t m_lastHash = 0;
+        char m_lastText[MAX_SUMMARY_TEXT] = {};
+        int64_t m_lastEmitNanos = 0;
+        uint32_t m_repeats = 0;
+        int64_t m_windowStartNanos = 0;
+        uint32_t m_windowCount = 0;
+        uint32_t m_suppressed = 0;
+        LogSite* m_next = nullptr;  // all sites, so the writer can report repeats that stopped
+    };
+
+    // Process-wide logger. Records go into a fixed-size lock-free queue and a background thread
+    // writes them, so a log statement costs a string format and never waits on the terminal. If the
+    // queue is full the record is dropped and counted rather than blocking the caller. The writer
+    // sleeps while the queue is empty and only the record that finds it asleep wakes it; otherwise it
+    // wakes just to report repeat counts.
+    class Logger {
+    public:
+        static constexpr size_t QUEUE_CAPACITY = 1024;  // power of two
+        static constexpr uint32_t SITE_RECORDS_PER_SECOND = 5;
+
+        static Logger& instance();
+
+        void log(LogSite& site, const std::string& message);
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            LogLevel level;
+            std::string text;
+        };
+
+        Logger();
+        ~Logger();
+
+        void registerSite(LogSite& site);
+        bool enqueue(LogLevel level, std::string text);
+        bool dequeue(LogLevel& level, std::string& text);
+        bool hasRecord() const;
+        void wakeWriter();
+        void writerLoop();
+        void flushRepeats(bool force);
+
+        friend class LogSite;
+
+        std::array<Cell, QUEUE_CAPACITY> m_cells;
+        alignas(64) std::atomic<size_t> m_enqueuePos{0};
+        alignas(64) size_t m_dequeuePos = 0;  // writer thread only
+        std::atomic<LogSite*> m_sites{nullptr};
+        std::atomic<uint64_t> m_dropped{0};
+        std::atomic<bool> m_stopping{false};
+        std::atomic<bool> m_writerIdle{false};  // set once the writer has seen an empty queue
+        std::mutex m_wakeMutex;
+        std::condition_variable m_wake;
+        std::thread m_writer;
+    };
+
+}
+
+#define VKENGINE_LOG(level, expr)                                                          \
+    do {                                                                                   \
+        if constexpr (static_cast<int>(level) >= VKENGINE_LOG_LEVEL) {                     \
+            static ::VKEngine::LogSite vkengineLogSite_(level);                            \
+            std::ostringstream vkengineLogStream_;                                         \
+            vkengineLogStream_ << expr;                                                    \
+            ::VKEngine::Logger::instance().log(vkengineLogSite_, vkengineLogStream_.str()); \
+        }                                                                                  \
+    } while (0)
+
+#define LOG_DEBUG(expr) VKENGINE_LOG(::VKEngine::LogLevel::Debug, expr)
+#define LOG_INFO(expr) VKENGINE_LOG(::VKEngine::LogLevel::Info, expr)
+#define LOG_WARN(expr) VKENGINE_LOG(::VKEngine::LogLevel::Warn, expr)
+#define LOG_ERROR(expr) VKENGINE_LOG(::VKEngine::LogLevel::Error, expr)
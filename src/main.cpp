@@ -1,15 +1,31 @@
 #include <iostream>
 #include <ostream>
 #include <cstdlib>
+#include <cstring>
 
 #include "application.h"
+#include "job_system.h"
 
 void force_x11_if_linux();
 
-int main() {
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--bench-jobs") == 0) {
+            return VKEngine::runJobBenchmark();
+        }
+    }
+
+    VKEngine::LaunchProfile profile;
+    try {
+        profile = VKEngine::LaunchProfile::select(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     force_x11_if_linux();
 
-    VKEngine::Application app;
+    VKEngine::Application app {profile};
 
     try {
         app.run();
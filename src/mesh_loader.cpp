@@ -0,0 +1,106 @@
+#include "mesh_loader.h"
+
+#include <cctype>
+#include <cstdlib>
+
+namespace VKEngine {
+
+    namespace {
+
+        const char* skipSpace(const char* c) {
+            while (*c == ' ' || *c == '\t' || *c == '\r') {
+                c++;
+            }
+            return c;
+        }
+
+        bool isKeyword(const char* c, char keyword) {
+            return c[0] == keyword && (c[1] == ' ' || c[1] == '\t');
+        }
+
+    }
+
+    bool decodeObj(const std::vector<uint8_t>& bytes, std::vector<Model::Vertex>& vertices,
+                   std::vector<uint32_t>& indices, std::string& error) {
+        vertices.clear();
+        indices.clear();
+
+        std::string line;
+        std::vector<uint32_t> face;
+        size_t lineNumber = 0;
+        size_t pos = 0;
+        while (pos < bytes.size()) {
+            size_t end = pos;
+            while (end < bytes.size() && bytes[end] != '\n') {
+                end++;
+            }
+            // a copy keeps strtof/strtol from running past the line
+            line.assign(reinterpret_cast<const char*>(bytes.data()) + pos, end - pos);
+            pos = end + 1;
+            lineNumber++;
+
+            const char* c = skipSpace(line.c_str());
+            if (isKeyword(c, 'v')) {
+                float values[6];
+                int count = 0;
+                c++;
+                while (count < 6) {
+                    char* next;
+                    float value = std::strtof(c, &next);
+                    if (next == c) {
+                        break;
+                    }
+                    values[count++] = value;
+                    c = next;
+                }
+                if (count < 3) {
+                    error = "vertex with fewer than three coordinates on line " + std::to_string(lineNumber);
+                    return false;
+                }
+                glm::vec3 color = count == 6 ? glm::vec3(values[3], values[4], values[5]) : glm::vec3(1.0f);
+                vertices.push_back({{values[0], values[1], values[2]}, color});
+            }
+            else if (isKeyword(c, 'f')) {
+                face.clear();
+                c = skipSpace(c + 1);
+                while (*c != '\0') {
+                    char* next;
+                    long index = std::strtol(c, &next, 10);
+                    if (next == c) {
+                        error = "malformed face on line " + std::to_string(lineNumber);
+                        return false;
+                    }
+                    // negative indices count back from the latest vertex
+                    long resolved = index < 0 ? static_cast<long>(vertices.size()) + index : index - 1;
+                    if (index == 0 || resolved < 0 || resolved >= static_cast<long>(vertices.size())) {
+                        error = "face index out of range on line " + std::to_string(lineNumber);
+                        return false;
+                    }
+                    face.push_back(static_cast<uint32_t>(resolved));
+                    // skip the texture coordinate and normal references
+                    c = next;
+                    while (*c != '\0' && !std::isspace(static_cast<unsigned char>(*c))) {
+                        c++;
+                    }
+                    c = skipSpace(c);
+                }
+                if (face.size() < 3) {
+                    error = "face with fewer than three vertices on line " + std::to_string(lineNumber);
+                    return false;
+                }
+                for (size_t i = 1; i + 1 < face.size(); i++) {
+                    indices.push_back(face[0]);
+                    indices.push_back(face[i]);
+                    indices.push_back(face[i + 1]);
+                }
+            }
+        }
+
+        if (vertices.size() < 3 || indices.empty()) {
+            error = "no triangles";
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VKEngine {
+
+    // Decodes Wavefront OBJ geometry: "v x y z" positions, with the common "v x y z r g b" vertex
+    // color extension, and "f" faces of any size, fan-triangulated, using 1-based or negative
+    // indices. Texture coordinates, normals, groups and materials are ignored; vertices without a
+    // color are white. Thread-safe; returns false and fills error on failure.
+    bool decodeObj(const std::vector<uint8_t>& bytes, std::vector<Model::Vertex>& vertices,
+                   std::vector<uint32_t>& indices, std::string& error);
+
+}
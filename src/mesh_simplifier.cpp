@@ -0,0 +1,287 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace VKEngine {
+
+    namespace {
+
+        // relative weight of the planes that keep open borders in place
+        constexpr double BOUNDARY_WEIGHT = 10.0;
+
+        struct Quadric {
+            double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+            double b0 = 0, b1 = 0, b2 = 0;
+            double c = 0;
+            double weight = 0;
+
+            // weight * (n.p + d)^2
+            static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+                Quadric q;
+                q.a00 = n.x * n.x * weight; q.a01 = n.x * n.y * weight; q.a02 = n.x * n.z * weight;
+                q.a11 = n.y * n.y * weight; q.a12 = n.y * n.z * weight; q.a22 = n.z * n.z * weight;
+                q.b0 = n.x * d * weight; q.b1 = n.y * d * weight; q.b2 = n.z * d * weight;
+                q.c = d * d * weight;
+                q.weight = weight;
+                return q;
+            }
+
+            Quadric& operator+=(const Quadric& o) {
+                a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+                b0 += o.b0; b1 += o.b1; b2 += o.b2;
+                c += o.c;
+                weight += o.weight;
+                return *this;
+            }
+
+            // mean squared distance of p to the accumulated planes
+            double evaluate(const glm::vec3& p) const {
+                double x = p.x, y = p.y, z = p.z;
+                double value = a00 * x * x + a11 * y * y + a22 * z * z
+                             + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                             + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+                return weight > 0.0 ? std::max(value, 0.0) / weight : 0.0;
+            }
+        };
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        }
+
+        bool isDegenerate(const uint32_t* triangle) {
+            return triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2];
+        }
+
+        // Maps every vertex to the first vertex sharing its exact position
+        std::vector<uint32_t> weldPositions(const std::vector<glm::vec3>& positions) {
+            struct KeyHash {
+                size_t operator()(const glm::vec3& p) const {
+                    uint32_t bits[3];
+                    std::memcpy(bits, &p, sizeof(bits));
+                    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+                }
+            };
+            std::unordered_map<glm::vec3, uint32_t, KeyHash> firstByPosition;
+            firstByPosition.reserve(positions.size());
+
+            std::vector<uint32_t> remap(positions.size());
+            for (uint32_t i = 0; i < positions.size(); i++) {
+                remap[i] = firstByPosition.emplace(positions[i], i).first->second;
+            }
+            return remap;
+        }
+
+        std::vector<Quadric> computeQuadrics(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+            std::vector<Quadric> quadrics(positions.size());
+            std::unordered_map<uint64_t, uint32_t> edgeUse;
+            edgeUse.reserve(indices.size());
+
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                glm::dvec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                double length = glm::length(normal);
+                if (length == 0.0) {
+                    continue;
+                }
+                normal /= length;
+
+                Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p0), length * 0.5);
+                for (int k = 0; k < 3; k++) {
+                    quadrics[indices[t + k]] += plane;
+                    edgeUse[edgeKey(indices[t + k], indices[t + (k + 1) % 3])]++;
+                }
+            }
+
+            // edges used by a single triangle lie on a border; pin them with a perpendicular plane
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                glm::dvec3 p0 = positions[indices[t]], p1 = positions[indices[t + 1]], p2 = positions[indices[t + 2]];
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                if (glm::length(normal) == 0.0) {
+                    continue;
+                }
+                normal = glm::normalize(normal);
+
+                for (int k = 0; k < 3; k++) {
+                    uint32_t a = indices[t + k], b = indices[t + (k + 1) % 3];
+                    if (edgeUse[edgeKey(a, b)] != 1) {
+                        continue;
+                    }
+                    glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+                    double edgeLength = glm::length(edge);
+                    if (edgeLength == 0.0) {
+                        continue;
+                    }
+                    glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+                    Quadric border = Quadric::fromPlane(
+                        borderNormal, -glm::dot(borderNormal, glm::dvec3(positions[a])), BOUNDARY_WEIGHT * edgeLength * edgeLength);
+                    border.weight = 0.0;  // constraint only, does not dilute the surface error
+                    quadrics[a] += border;
+                    quadrics[b] += border;
+                }
+            }
+            return quadrics;
+        }
+
+        // Moving `from` onto `to` must not flip any triangle that survives the collapse
+        bool flipsTriangles(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+                            const std::vector<uint32_t>& remap, const uint32_t* adjacency, uint32_t adjacencyCount,
+                            uint32_t from, uint32_t to) {
+            for (uint32_t i = 0; i < adjacencyCount; i++) {
+                const uint32_t* triangle = &indices[adjacency[i] * 3];
+                uint32_t v[3] = {remap[triangle[0]], remap[triangle[1]], remap[triangle[2]]};
+                if (v[0] == to || v[1] == to || v[2] == to || isDegenerate(v)) {
+                    continue;
+                }
+
+                glm::vec3 p[3] = {positions[v[0]], positions[v[1]], positions[v[2]]};
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (int k = 0; k < 3; k++) {
+                    if (v[k] == from) {
+                        p[k] = positions[to];
+                    }
+                }
+                glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::dot(before, after) <= 0.0f) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    }
+
+    std::vector<uint32_t> MeshSimplifier::simplify(
+        const std::vector<glm::vec3>& positions,
+        const std::vector<uint32_t>& indices,
+        size_t targetIndexCount,
+        float& resultError) {
+        assert(indices.size() % 3 == 0 && "Simplifier expects a triangle list.");
+        resultError = 0.0f;
+
+        std::vector<uint32_t> weld = weldPositions(positions);
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            uint32_t triangle[3] = {weld[indices[t]], weld[indices[t + 1]], weld[indices[t + 2]]};
+            if (!isDegenerate(triangle)) {
+                result.insert(result.end(), triangle, triangle + 3);
+            }
+        }
+
+        std::vector<Quadric> quadrics = computeQuadrics(positions, result);
+        const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+        double maxCost = 0.0;
+
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> adjacencyOffsets;
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> locked(vertexCount);
+
+        // each pass collapses the cheapest independent edges, then rebuilds the triangle list
+        while (result.size() > targetIndexCount) {
+            const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+            adjacencyOffsets.assign(vertexCount + 1, 0);
+            for (uint32_t index : result) {
+                adjacencyOffsets[index + 1]++;
+            }
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+            }
+            adjacency.resize(result.size());
+            std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                for (int k = 0; k < 3; k++) {
+                    adjacency[cursor[result[t * 3 + k]]++] = t;
+                }
+            }
+
+            collapses.clear();
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+                    if (a > b) {
+                        continue;  // every interior edge shows up once in each direction
+                    }
+                    Quadric q = quadrics[a];
+                    q += quadrics[b];
+                    double costToB = q.evaluate(positions[b]);
+                    double costToA = q.evaluate(positions[a]);
+                    collapses.push_back(costToB <= costToA ? Collapse{a, b, costToB} : Collapse{b, a, costToA});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                remap[v] = v;
+            }
+            std::fill(locked.begin(), locked.end(), 0);
+
+            // most collapses remove two triangles; anything much costlier than the cheapest
+            // candidates waits for the next pass, when locked neighbours are free again
+            size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+            double costLimit = collapses.empty() ? 0.0 : collapses[std::min(collapses.size() - 1, trianglesToRemove / 2)].cost;
+            size_t removed = 0;
+            size_t applied = 0;
+            for (const Collapse& collapse : collapses) {
+                if (removed >= trianglesToRemove || collapse.cost > costLimit) {
+                    break;
+                }
+                if (locked[collapse.from] || locked[collapse.to]) {
+                    continue;
+                }
+
+                const uint32_t* fromTriangles = &adjacency[adjacencyOffsets[collapse.from]];
+                uint32_t fromCount = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+                if (flipsTriangles(positions, result, remap, fromTriangles, fromCount, collapse.from, collapse.to)) {
+                    continue;
+                }
+
+                for (uint32_t i = 0; i < fromCount; i++) {
+                    const uint32_t* triangle = &result[fromTriangles[i] * 3];
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                        removed++;
+                    }
+                }
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to] += quadrics[collapse.from];
+                locked[collapse.from] = 1;
+                locked[collapse.to] = 1;
+                maxCost = std::max(maxCost, collapse.cost);
+                applied++;
+            }
+
+            if (applied == 0) {
+                break;
+            }
+
+            size_t writeIndex = 0;
+            for (size_t t = 0; t < result.size(); t += 3) {
+                uint32_t triangle[3] = {remap[result[t]], remap[result[t + 1]], remap[result[t + 2]]};
+                if (!isDegenerate(triangle)) {
+                    result[writeIndex++] = triangle[0];
+                    result[writeIndex++] = triangle[1];
+                    result[writeIndex++] = triangle[2];
+                }
+            }
+            result.resize(writeIndex);
+        }
+
+        resultError = static_cast<float>(std::sqrt(maxCost));
+        return result;
+    }
+
+}
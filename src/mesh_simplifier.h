@@ -0,0 +1,27 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace VKEngine {
+
+    // Quadric error metric simplifier (Garland & Heckbert) using half-edge collapses, so simplified
+    // index lists keep referencing the original vertices and every LOD can share one vertex range.
+    // Vertices with identical positions are welded before simplifying; mesh borders are preserved
+    // by extra boundary quadrics.
+    class MeshSimplifier {
+    public:
+        // Reduces a triangle list towards targetIndexCount. resultError receives the largest collapse
+        // error in object-space units (root mean squared distance to the original surface).
+        static std::vector<uint32_t> simplify(
+            const std::vector<glm::vec3>& positions,
+            const std::vector<uint32_t>& indices,
+            size_t targetIndexCount,
+            float& resultError);
+    };
+
+}
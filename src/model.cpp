@@ -1,6 +1,9 @@
 #include "model.h"
+#include "mesh_simplifier.h"
 
-#include <cstring>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 namespace VKEngine {
 
@@ -16,7 +19,7 @@ namespace VKEngine {
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
         attributeDescriptions[0].offset = offsetof(Vertex, position);
         attributeDescriptions[1].binding = 0;
         attributeDescriptions[1].location = 1;
@@ -25,39 +28,130 @@ namespace VKEngine {
         return attributeDescriptions;
     }
 
-    Model::Model(Device& device, const std::vector<Vertex>& vertices)
-        : m_device(device) { createVertexBuffers(vertices); }
+    namespace {
+        // each LOD aims for half the triangles of the previous one
+        constexpr float LOD_REDUCTION = 0.5f;
+        // stop the chain once simplification no longer gets meaningfully below the previous level
+        constexpr float LOD_MIN_SAVING = 0.85f;
+    }
+
+    Model::MeshData Model::buildMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                     uint32_t maxLods) {
+        assert(vertices.size() >= 3 && "Vertex count must be greater than 2.");
+        assert(maxLods >= 1 && maxLods <= MAX_LODS && "LOD count out of range.");
+
+        MeshData mesh;
+        mesh.vertices = vertices;
+        if (indices.empty()) {
+            std::vector<uint32_t> sequential(vertices.size());
+            for (uint32_t i = 0; i < sequential.size(); i++) {
+                sequential[i] = i;
+            }
+            mesh.indices = buildLods(vertices, sequential, maxLods, mesh.lods);
+        }
+        else {
+            mesh.indices = buildLods(vertices, indices, maxLods, mesh.lods);
+        }
+        mesh.boundingSphere = computeBoundingSphere(vertices);
+        return mesh;
+    }
+
+    Model::Model(GeometryBuffer& geometry, const MeshData& mesh)
+        : m_geometry(geometry), m_boundingSphere(mesh.boundingSphere), m_lods(mesh.lods) {
+        m_allocation = m_geometry.allocate(mesh.vertices.data(), (uint32_t)mesh.vertices.size(),
+                                           mesh.indices.data(), (uint32_t)mesh.indices.size());
+    }
+
+    Model::Model(GeometryBuffer& geometry, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                 uint32_t maxLods)
+        : Model(geometry, buildMesh(vertices, indices, maxLods)) {}
 
     Model::~Model() {
-        vkDestroyBuffer(m_device.device(), m_vertexBuffer, nullptr);
-        vkFreeMemory(m_device.device(), m_vertexBufferMemory, nullptr);
+        m_geometry.free(m_allocation);
     }
 
     void Model::bind(VkCommandBuffer commandBuffer) {
-        VkBuffer buffers[] = { m_vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-    }
-
-    void Model::draw(VkCommandBuffer commandBuffer) {
-        vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
-    }
-
-    void Model::createVertexBuffers(const std::vector<Vertex>& vertices) {
-        m_vertexCount = (uint32_t)vertices.size();
-        assert(m_vertexCount >= 3 && "Vertex count must be greater than 2.");
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
-        m_device.createBuffer(
-            bufferSize,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            m_vertexBuffer,
-            m_vertexBufferMemory);
-
-        void* data;
-        vkMapMemory(m_device.device(), m_vertexBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(m_device.device(), m_vertexBufferMemory);
+        m_geometry.bind(commandBuffer);
+    }
+
+    void Model::draw(VkCommandBuffer commandBuffer, uint32_t lod) {
+        assert(lod < m_lods.size() && "LOD index out of range.");
+        const auto& range = getRange();
+        const Lod& level = m_lods[lod];
+        vkCmdDrawIndexed(commandBuffer, level.indexCount, 1, range.firstIndex + level.firstIndex, (int32_t)range.vertexOffset, 0);
+    }
+
+    uint32_t Model::selectLod(float distance, float lodScale, uint32_t currentLod) const {
+        if (lodScale <= 0.0f || m_lods.size() == 1) {
+            return 0;
+        }
+        currentLod = std::min(currentLod, getLodCount() - 1);
+        distance = std::max(distance, 1e-4f);
+
+        // projected error of a level, in units of the pixel threshold
+        auto projectedError = [&](uint32_t lod) { return m_lods[lod].error * lodScale / distance; };
+        auto coarsestWithin = [&](float limit) {
+            for (uint32_t lod = getLodCount() - 1; lod > 0; lod--) {
+                if (projectedError(lod) <= limit) {
+                    return lod;
+                }
+            }
+            return 0u;
+        };
+
+        // refine as soon as the current level is too coarse, but only coarsen with some margin
+        if (projectedError(currentLod) > 1.0f) {
+            return coarsestWithin(1.0f);
+        }
+        return std::max(currentLod, coarsestWithin(1.0f - LOD_HYSTERESIS));
+    }
+
+    std::vector<uint32_t> Model::buildLods(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                           uint32_t maxLods, std::vector<Lod>& lods) {
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i] = vertices[i].position;
+        }
+
+        std::vector<uint32_t> lodIndices = indices;
+        lods.clear();
+        lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+        while (lods.size() < maxLods) {
+            size_t previousCount = lods.back().indexCount;
+            size_t target = static_cast<size_t>(previousCount * LOD_REDUCTION) / 3 * 3;
+
+            float error = 0.0f;
+            std::vector<uint32_t> simplified = MeshSimplifier::simplify(positions, indices, target, error);
+            if (simplified.empty() || simplified.size() > previousCount * LOD_MIN_SAVING) {
+                break;
+            }
+
+            lods.push_back({static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(simplified.size()),
+                            std::max(error, lods.back().error)});
+            lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+        }
+        return lodIndices;
+    }
+
+    Model::BoundingSphere Model::computeBoundingSphere(const std::vector<Vertex>& vertices) {
+        // centre on the AABB midpoint, then grow the radius to enclose every vertex
+        glm::vec3 minPos = vertices[0].position;
+        glm::vec3 maxPos = vertices[0].position;
+        for (const auto& vertex : vertices) {
+            minPos = glm::min(minPos, vertex.position);
+            maxPos = glm::max(maxPos, vertex.position);
+        }
+
+        BoundingSphere sphere;
+        sphere.center = (minPos + maxPos) * 0.5f;
+        float radiusSq = 0.0f;
+        for (const auto& vertex : vertices) {
+            glm::vec3 d = vertex.position - sphere.center;
+            radiusSq = std::max(radiusSq, glm::dot(d, d));
+        }
+        sphere.radius = std::sqrt(radiusSq);
+        return sphere;
     }
 
 } // namespace VKEngine
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vk_device.h"
+#include "geometry_buffer.h"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -10,28 +11,81 @@ namespace VKEngine {
     public:
 
         struct Vertex {
-            glm::vec2 position;
+            glm::vec3 position;
             glm::vec3 color;
 
             static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
             static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
         };
 
-        Model(Device& device, const std::vector<Vertex>& vertices);
+        // Object-space bounding sphere, computed from the vertex data at load time
+        struct BoundingSphere {
+            glm::vec3 center;
+            float radius;
+        };
+
+        static constexpr uint32_t MAX_LODS = 4;
+        // fraction of the error threshold a coarser LOD must stay under before it replaces the current one
+        static constexpr float LOD_HYSTERESIS = 0.25f;
+
+        // Index range of one level of detail; firstIndex is relative to the model's index range and
+        // error is the simplification error in object-space units
+        struct Lod {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            float error;
+        };
+
+        // Geometry with its LOD chain built, ready for the GeometryBuffer. Building it is the expensive
+        // part of loading a model and touches no GPU state, so it can run on any thread.
+        struct MeshData {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;  // every LOD back to back
+            std::vector<Lod> lods;
+            BoundingSphere boundingSphere{};
+        };
+
+        // Without indices a trivial 0..n-1 list is generated. Up to maxLods levels of detail are
+        // simplified from it and stored back to back after LOD 0, all referencing the same vertices.
+        static MeshData buildMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices = {},
+                                  uint32_t maxLods = MAX_LODS);
+
+        // Geometry lives in the shared GeometryBuffer
+        Model(GeometryBuffer& geometry, const MeshData& mesh);
+        Model(GeometryBuffer& geometry, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices = {},
+              uint32_t maxLods = MAX_LODS);
         ~Model();
 
         Model(const Model&) = delete;
         Model &operator=(const Model&) = delete;
 
+        // Binds the shared geometry buffers; only needed once per frame for all models
         void bind(VkCommandBuffer commandBuffer);
-        void draw(VkCommandBuffer commandBuffer);
+        void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+
+        uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+        const Lod& getLod(uint32_t lod) const { return m_lods[lod]; }
+
+        // Picks the coarsest LOD whose projected error stays within the threshold. lodScale is the
+        // projection scale in pixels divided by the error threshold in pixels (0 disables LOD),
+        // distance is from the camera to the nearest point of the bounding sphere.
+        uint32_t selectLod(float distance, float lodScale, uint32_t currentLod) const;
+
+        // Ranges move when the geometry buffer compacts, so query them rather than caching
+        const GeometryBuffer::Range& getRange() const { return m_geometry.getRange(m_allocation); }
+        const BoundingSphere& getBoundingSphere() const { return m_boundingSphere; }
+        const GeometryBuffer& getGeometry() const { return m_geometry; }
+        // Dense and unique among live models, so it fits the render queue's mesh field
+        GeometryBuffer::AllocationId getMeshId() const { return m_allocation; }
 
     private:
-        void createVertexBuffers(const std::vector<Vertex>& vertices);
+        static BoundingSphere computeBoundingSphere(const std::vector<Vertex>& vertices);
+        static std::vector<uint32_t> buildLods(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                               uint32_t maxLods, std::vector<Lod>& lods);
 
-        Device& m_device;
-        VkBuffer m_vertexBuffer;
-        VkDeviceMemory m_vertexBufferMemory;
-        uint32_t m_vertexCount;
+        GeometryBuffer& m_geometry;
+        GeometryBuffer::AllocationId m_allocation;
+        BoundingSphere m_boundingSphere{};
+        std::vector<Lod> m_lods;
     };
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "parallel.h"
+
+namespace VKEngine {
+
+    TaskQueue::TaskQueue(size_t threadCount) {
+        m_threads.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++) {
+            m_threads.emplace_back([this]() { threadLoop(); });
+        }
+    }
+
+    TaskQueue::~TaskQueue() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_tasks.clear();
+        }
+        m_wake.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void TaskQueue::submit(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_wake.notify_one();
+    }
+
+    size_t TaskQueue::pendingCount() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tasks.size();
+    }
+
+    void TaskQueue::threadLoop() {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+                if (m_stopping) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+}
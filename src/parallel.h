@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VKEngine {
+
+    // Background threads running fire-and-forget tasks in submission order, for work such as file
+    // decoding that must not block the frame. Pending tasks are dropped on destruction.
+    class TaskQueue {
+    public:
+        using Task = std::function<void()>;
+
+        explicit TaskQueue(size_t threadCount);
+        ~TaskQueue();
+
+        TaskQueue(const TaskQueue&) = delete;
+        TaskQueue &operator=(const TaskQueue&) = delete;
+
+        void submit(Task task);
+        size_t pendingCount();
+
+    private:
+        void threadLoop();
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<Task> m_tasks;
+        bool m_stopping = false;
+    };
+
+}
@@ -0,0 +1,91 @@
+#include "push_constants.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    DynamicUniformRing::DynamicUniformRing(Device& device, DescriptorLayoutCache& layoutCache, VkShaderStageFlags stages,
+                                           VkDeviceSize elementSize, uint32_t maxElementsPerFrame)
+        : m_device(device), m_elementSize(elementSize), m_capacity(maxElementsPerFrame) {
+        VkDeviceSize alignment = std::max<VkDeviceSize>(device.capabilities().properties.limits.minUniformBufferOffsetAlignment, 1);
+        m_alignedSize = (elementSize + alignment - 1) / alignment * alignment;
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        binding.descriptorCount = 1;
+        binding.stageFlags = stages;
+        m_layout = layoutCache.getLayout({binding});
+
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SwapChain::MAX_FRAMES_IN_FLIGHT};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = SwapChain::MAX_FRAMES_IN_FLIGHT;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(m_device.device(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create per-draw uniform descriptor pool!");
+        }
+
+        for (auto& frame : m_frames) {
+            m_device.createBuffer(
+                m_alignedSize * m_capacity,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.buffer,
+                frame.memory);
+            vkMapMemory(m_device.device(), frame.memory, 0, VK_WHOLE_SIZE, 0, &frame.mapped);
+
+            VkDescriptorSetAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = m_pool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &m_layout;
+            if (vkAllocateDescriptorSets(m_device.device(), &allocInfo, &frame.descriptorSet) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate per-draw uniform descriptor set!");
+            }
+
+            // the range covers one element; the dynamic offset selects which
+            VkDescriptorBufferInfo bufferInfo = {frame.buffer, 0, m_elementSize};
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = frame.descriptorSet;
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            write.pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+        }
+    }
+
+    DynamicUniformRing::~DynamicUniformRing() {
+        for (auto& frame : m_frames) {
+            vkUnmapMemory(m_device.device(), frame.memory);
+            vkDestroyBuffer(m_device.device(), frame.buffer, nullptr);
+            vkFreeMemory(m_device.device(), frame.memory, nullptr);
+        }
+        vkDestroyDescriptorPool(m_device.device(), m_pool, nullptr);
+    }
+
+    void DynamicUniformRing::beginFrame(size_t frameIndex) {
+        m_frameIndex = frameIndex;
+        m_cursor = 0;
+    }
+
+    void DynamicUniformRing::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                  uint32_t set, const void* data) {
+        if (m_cursor >= m_capacity) {
+            throw std::runtime_error("per-draw uniform ring is full!");
+        }
+        FrameResources& frame = m_frames[m_frameIndex];
+
+        VkDeviceSize offset = m_alignedSize * m_cursor++;
+        memcpy(static_cast<char*>(frame.mapped) + offset, data, m_elementSize);
+
+        uint32_t dynamicOffset = static_cast<uint32_t>(offset);
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, set, 1, &frame.descriptorSet, 1, &dynamicOffset);
+    }
+
+}
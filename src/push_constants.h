@@ -0,0 +1,127 @@
+#pragma once
+
+#include "vk_device.h"
+#include "vk_swapchain.h"
+#include "descriptors.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace VKEngine {
+
+    // Per-draw data for shader.vert (block DrawData). Member offsets match the GLSL block layout and
+    // the struct fills the 128 bytes of push constant space every implementation guarantees.
+    struct DrawData {
+        glm::mat4 transform;        // model-view-projection
+        glm::vec4 color;
+        uint32_t transformIndex;
+        uint32_t materialId;
+        uint32_t padding[10];
+    };
+    static_assert(sizeof(DrawData) == 128, "DrawData must stay a 128-byte block.");
+    static_assert(offsetof(DrawData, color) == 64 && offsetof(DrawData, transformIndex) == 80,
+                  "DrawData layout must match the GLSL block.");
+
+    // Per-frame ring of host-visible dynamic uniform buffers. Each write lands in the next aligned
+    // slot of the current frame's buffer and is bound with its dynamic offset; the fallback storage
+    // for per-draw data that does not fit in push constants.
+    class DynamicUniformRing {
+    public:
+        DynamicUniformRing(Device& device, DescriptorLayoutCache& layoutCache, VkShaderStageFlags stages,
+                           VkDeviceSize elementSize, uint32_t maxElementsPerFrame);
+        ~DynamicUniformRing();
+
+        DynamicUniformRing(const DynamicUniformRing&) = delete;
+        DynamicUniformRing &operator=(const DynamicUniformRing&) = delete;
+
+        VkDescriptorSetLayout getLayout() const { return m_layout; }
+
+        // Must be called after the frame's fence has been waited on
+        void beginFrame(size_t frameIndex);
+        void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                  uint32_t set, const void* data);
+
+    private:
+        struct FrameResources {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mapped = nullptr;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        };
+
+        Device& m_device;
+        VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+        VkDescriptorPool m_pool = VK_NULL_HANDLE;
+        VkDeviceSize m_elementSize;
+        VkDeviceSize m_alignedSize;
+        uint32_t m_capacity;
+
+        std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frames;
+        size_t m_frameIndex = 0;
+        uint32_t m_cursor = 0;
+    };
+
+    // Typed per-draw constants. T goes through vkCmdPushConstants when it fits in
+    // maxPushConstantsSize, otherwise through a DynamicUniformRing bound at FALLBACK_SET. The
+    // pipeline layout side is generated by declare(), and shaders pick the matching variant (see
+    // PER_DRAW_UBO in shader.vert).
+    template <typename T>
+    class PerDrawConstants {
+    public:
+        static constexpr uint32_t FALLBACK_SET = 1;
+        static_assert(sizeof(T) % 4 == 0, "Push constant blocks must be a multiple of 4 bytes.");
+
+        PerDrawConstants(Device& device, DescriptorLayoutCache& layoutCache, VkShaderStageFlags stages,
+                         uint32_t maxDrawsPerFrame = 4096)
+            : m_layoutCache(layoutCache), m_stages(stages) {
+            if (sizeof(T) > device.capabilities().properties.limits.maxPushConstantsSize) {
+                m_fallback = std::make_unique<DynamicUniformRing>(device, layoutCache, stages, sizeof(T), maxDrawsPerFrame);
+            }
+        }
+
+        bool usesPushConstants() const { return m_fallback == nullptr; }
+
+        // Adds the push constant range, or the fallback set at FALLBACK_SET, to a pipeline layout
+        // description; lower sets that are not declared yet are filled with empty layouts
+        void declare(std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange>& ranges) const {
+            if (!m_fallback) {
+                ranges.push_back({m_stages, 0, static_cast<uint32_t>(sizeof(T))});
+                return;
+            }
+            assert(setLayouts.size() <= FALLBACK_SET && "Set index of the per-draw fallback is already taken.");
+            while (setLayouts.size() < FALLBACK_SET) {
+                setLayouts.push_back(m_layoutCache.getLayout({}));
+            }
+            setLayouts.push_back(m_fallback->getLayout());
+        }
+
+        void beginFrame(size_t frameIndex) {
+            if (m_fallback) {
+                m_fallback->beginFrame(frameIndex);
+            }
+        }
+
+        void push(VkCommandBuffer commandBuffer, VkPipelineLayout layout, const T& data,
+                  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS) {
+            if (!m_fallback) {
+                vkCmdPushConstants(commandBuffer, layout, m_stages, 0, sizeof(T), &data);
+            }
+            else {
+                m_fallback->bind(commandBuffer, bindPoint, layout, FALLBACK_SET, &data);
+            }
+        }
+
+    private:
+        DescriptorLayoutCache& m_layoutCache;
+        VkShaderStageFlags m_stages;
+        std::unique_ptr<DynamicUniformRing> m_fallback;
+    };
+
+}
@@ -0,0 +1,493 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    namespace {
+
+        VkImageAspectFlags formatAspect(VkFormat format) {
+            switch (format) {
+                case VK_FORMAT_D16_UNORM:
+                case VK_FORMAT_X8_D24_UNORM_PACK32:
+                case VK_FORMAT_D32_SFLOAT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case VK_FORMAT_D16_UNORM_S8_UINT:
+                case VK_FORMAT_D24_UNORM_S8_UINT:
+                case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                default:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+        }
+
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        template<typename T>
+        void appendBytes(std::string& out, const T& value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+    }
+
+    void RenderGraph::PassBuilder::read(Resource resource, Access access) {
+        assert(resource < m_graph.m_resources.size() && "Unknown render graph resource.");
+        m_graph.m_passes[m_pass].accesses.push_back({resource, access, false});
+    }
+
+    void RenderGraph::PassBuilder::write(Resource resource, Access access) {
+        assert(resource < m_graph.m_resources.size() && "Unknown render graph resource.");
+        assert((accessInfo(access).access & WRITE_ACCESS_MASK) != 0 && "Access type cannot write.");
+        m_graph.m_passes[m_pass].accesses.push_back({resource, access, true});
+    }
+
+    void RenderGraph::PassBuilder::sideEffect() {
+        m_graph.m_passes[m_pass].sideEffect = true;
+    }
+
+    RenderGraph::RenderGraph(Device& device, DeletionQueue& deletionQueue)
+        : m_device(device), m_deletionQueue(deletionQueue) {}
+
+    RenderGraph::~RenderGraph() {
+        // the owner drains the device first, so transients go directly
+        for (TransientResource& transient : m_transients) {
+            vkDestroyImageView(m_device.device(), transient.view, nullptr);
+            vkDestroyImage(m_device.device(), transient.image, nullptr);
+            vkDestroyBuffer(m_device.device(), transient.buffer, nullptr);
+        }
+        for (MemoryBlock& block : m_memoryBlocks) {
+            vkFreeMemory(m_device.device(), block.memory, nullptr);
+        }
+    }
+
+    void RenderGraph::reset() {
+        m_resources.clear();
+        m_passes.clear();
+    }
+
+    RenderGraph::Resource RenderGraph::createImage(const std::string& name, const ImageDesc& desc) {
+        ResourceNode node;
+        node.name = name;
+        node.isImage = true;
+        node.imageDesc = desc;
+        node.aspect = formatAspect(desc.format);
+        m_resources.push_back(std::move(node));
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    RenderGraph::Resource RenderGraph::createBuffer(const std::string& name, const BufferDesc& desc) {
+        ResourceNode node;
+        node.name = name;
+        node.bufferDesc = desc;
+        m_resources.push_back(std::move(node));
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    RenderGraph::Resource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+                                                   VkImageAspectFlags aspect, VkImageLayout currentLayout,
+                                                   VkImageLayout finalLayout, VkPipelineStageFlags availableStages) {
+        ResourceNode node;
+        node.name = name;
+        node.isImage = true;
+        node.imported = true;
+        node.image = image;
+        node.view = view;
+        node.aspect = aspect;
+        node.initialLayout = currentLayout;
+        node.finalLayout = finalLayout;
+        node.availableStages = availableStages;
+        m_resources.push_back(std::move(node));
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    RenderGraph::Resource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer) {
+        ResourceNode node;
+        node.name = name;
+        node.imported = true;
+        node.buffer = buffer;
+        m_resources.push_back(std::move(node));
+        return static_cast<Resource>(m_resources.size() - 1);
+    }
+
+    void RenderGraph::addPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute) {
+        PassNode pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        m_passes.push_back(std::move(pass));
+
+        PassBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+        setup(builder);
+    }
+
+    std::string RenderGraph::signature() const {
+        // everything the plan depends on, but none of the per-frame handles of imported resources
+        std::string out;
+        for (const ResourceNode& node : m_resources) {
+            appendBytes(out, node.isImage);
+            appendBytes(out, node.imported);
+            appendBytes(out, node.aspect);
+            appendBytes(out, node.initialLayout);
+            appendBytes(out, node.finalLayout);
+            appendBytes(out, node.availableStages);
+            if (!node.imported) {
+                appendBytes(out, node.imageDesc.format);
+                appendBytes(out, node.imageDesc.extent);
+                appendBytes(out, node.imageDesc.usage);
+                appendBytes(out, node.bufferDesc.size);
+                appendBytes(out, node.bufferDesc.usage);
+            }
+        }
+        for (const PassNode& pass : m_passes) {
+            out += pass.name;
+            out += '\0';
+            appendBytes(out, pass.sideEffect);
+            for (const AccessEntry& entry : pass.accesses) {
+                appendBytes(out, entry.resource);
+                appendBytes(out, entry.access);
+                appendBytes(out, entry.write);
+            }
+            out += '\0';
+        }
+        return out;
+    }
+
+    void RenderGraph::compile() {
+        std::string currentSignature = signature();
+        if (currentSignature == m_compiledSignature) {
+            return;
+        }
+
+        cullPasses();
+        releaseTransients();
+        allocateTransients();
+        m_barriers = planBarriers(m_resources, m_passes, m_culled, m_transientIndex, m_transients);
+
+        m_stats.barrierBatches = 0;
+        m_stats.imageBarriers = 0;
+        m_stats.memoryBarriers = 0;
+        auto count = [&](const BarrierBatch& batch) {
+            if (batch.empty()) {
+                return;
+            }
+            m_stats.barrierBatches++;
+            m_stats.imageBarriers += static_cast<uint32_t>(batch.images.size());
+            m_stats.memoryBarriers += batch.memorySrcAccess != 0 ? 1 : 0;
+        };
+        for (const BarrierBatch& batch : m_barriers.passBarriers) {
+            count(batch);
+        }
+        count(m_barriers.finalBarriers);
+
+        m_compiledSignature = std::move(currentSignature);
+        m_stats.compiles++;
+    }
+
+    void RenderGraph::cullPasses() {
+        // reference counting from the outputs backwards: a pass survives if something reads what it
+        // writes, if it writes an imported resource, or if it declared side effects
+        size_t passCount = m_passes.size();
+        std::vector<uint32_t> passRefs(passCount, 0);
+        std::vector<uint32_t> resourceRefs(m_resources.size(), 0);
+        std::vector<std::vector<uint32_t>> writers(m_resources.size());
+        std::vector<bool> root(passCount, false);
+
+        for (uint32_t p = 0; p < passCount; p++) {
+            const PassNode& pass = m_passes[p];
+            root[p] = pass.sideEffect;
+            for (const AccessEntry& entry : pass.accesses) {
+                if (entry.write) {
+                    writers[entry.resource].push_back(p);
+                    passRefs[p]++;
+                    root[p] = root[p] || m_resources[entry.resource].imported;
+                }
+            }
+            for (const AccessEntry& entry : pass.accesses) {
+                bool writesToo = std::any_of(pass.accesses.begin(), pass.accesses.end(), [&](const AccessEntry& other) {
+                    return other.write && other.resource == entry.resource;
+                });
+                if (!entry.write && !writesToo) {
+                    resourceRefs[entry.resource]++;
+                }
+            }
+        }
+
+        m_culled.assign(passCount, false);
+        std::vector<Resource> unreferenced;
+        for (Resource r = 0; r < m_resources.size(); r++) {
+            if (resourceRefs[r] == 0) {
+                unreferenced.push_back(r);
+            }
+        }
+        while (!unreferenced.empty()) {
+            Resource r = unreferenced.back();
+            unreferenced.pop_back();
+            for (uint32_t p : writers[r]) {
+                if (root[p] || m_culled[p] || --passRefs[p] > 0) {
+                    continue;
+                }
+                m_culled[p] = true;
+                for (const AccessEntry& entry : m_passes[p].accesses) {
+                    if (!entry.write && resourceRefs[entry.resource] > 0 && --resourceRefs[entry.resource] == 0) {
+                        unreferenced.push_back(entry.resource);
+                    }
+                }
+            }
+        }
+
+        m_stats.passes = static_cast<uint32_t>(passCount);
+        m_stats.culledPasses = static_cast<uint32_t>(std::count(m_culled.begin(), m_culled.end(), true));
+    }
+
+    VkFlags RenderGraph::impliedUsage(Resource resource) const {
+        VkFlags usage = 0;
+        for (uint32_t p = 0; p < m_passes.size(); p++) {
+            for (const AccessEntry& entry : m_passes[p].accesses) {
+                if (entry.resource == resource) {
+                    AccessInfo info = accessInfo(entry.access);
+                    usage |= m_resources[resource].isImage ? info.imageUsage : info.bufferUsage;
+                }
+            }
+        }
+        return usage;
+    }
+
+    void RenderGraph::releaseTransients() {
+        // frames in flight may still use the old placement
+        VkDevice device = m_device.device();
+        m_deletionQueue.push([device, transients = std::move(m_transients), blocks = std::move(m_memoryBlocks)]() {
+            for (const TransientResource& transient : transients) {
+                vkDestroyImageView(device, transient.view, nullptr);
+                vkDestroyImage(device, transient.image, nullptr);
+                vkDestroyBuffer(device, transient.buffer, nullptr);
+            }
+            for (const MemoryBlock& block : blocks) {
+                vkFreeMemory(device, block.memory, nullptr);
+            }
+        });
+        m_transients.clear();
+        m_memoryBlocks.clear();
+    }
+
+    void RenderGraph::allocateTransients() {
+        m_transientIndex.assign(m_resources.size(), -1);
+
+        for (Resource r = 0; r < m_resources.size(); r++) {
+            const ResourceNode& node = m_resources[r];
+            if (node.imported) {
+                continue;
+            }
+
+            TransientResource transient;
+            transient.resource = r;
+            transient.firstPass = UINT32_MAX;
+            for (uint32_t p = 0; p < m_passes.size(); p++) {
+                if (m_culled[p]) {
+                    continue;
+                }
+                for (const AccessEntry& entry : m_passes[p].accesses) {
+                    if (entry.resource == r) {
+                        transient.firstPass = std::min(transient.firstPass, p);
+                        transient.lastPass = p;
+                    }
+                }
+            }
+            if (transient.firstPass == UINT32_MAX) {
+                continue;  // only used by culled passes
+            }
+
+            if (node.isImage) {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.extent = {node.imageDesc.extent.width, node.imageDesc.extent.height, 1};
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.format = node.imageDesc.format;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                imageInfo.usage = node.imageDesc.usage | impliedUsage(r);
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                if (vkCreateImage(m_device.device(), &imageInfo, nullptr, &transient.image) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create render graph image!");
+                }
+                vkGetImageMemoryRequirements(m_device.device(), transient.image, &transient.requirements);
+            }
+            else {
+                VkBufferCreateInfo bufferInfo{};
+                bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferInfo.size = node.bufferDesc.size;
+                bufferInfo.usage = node.bufferDesc.usage | impliedUsage(r);
+                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                if (vkCreateBuffer(m_device.device(), &bufferInfo, nullptr, &transient.buffer) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create render graph buffer!");
+                }
+                vkGetBufferMemoryRequirements(m_device.device(), transient.buffer, &transient.requirements);
+            }
+            transient.memoryType = m_device.findMemoryType(
+                transient.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            m_transientIndex[r] = static_cast<int32_t>(m_transients.size());
+            m_transients.push_back(transient);
+        }
+
+        // greedy placement, largest first: each resource goes to the lowest offset that doesn't
+        // overlap a resource already placed in the same block whose lifetime overlaps its own
+        std::vector<uint32_t> order(m_transients.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return m_transients[a].requirements.size > m_transients[b].requirements.size;
+        });
+
+        // images and buffers may share a block, so keep them bufferImageGranularity apart
+        VkDeviceSize granularity = m_device.capabilities().properties.limits.bufferImageGranularity;
+        std::vector<uint32_t> placed;
+        m_stats.unaliasedTransientBytes = 0;
+        for (uint32_t index : order) {
+            TransientResource& transient = m_transients[index];
+            VkDeviceSize alignment = std::max(transient.requirements.alignment, granularity);
+            VkDeviceSize offset = 0;
+            bool moved = true;
+            while (moved) {
+                moved = false;
+                for (uint32_t other : placed) {
+                    const TransientResource& o = m_transients[other];
+                    bool sameBlock = o.memoryType == transient.memoryType;
+                    bool liveTogether = o.firstPass <= transient.lastPass && transient.firstPass <= o.lastPass;
+                    bool overlaps = offset < o.offset + o.requirements.size &&
+                                    o.offset < offset + transient.requirements.size;
+                    if (sameBlock && liveTogether && overlaps) {
+                        offset = alignUp(o.offset + o.requirements.size, alignment);
+                        moved = true;
+                    }
+                }
+            }
+            transient.offset = offset;
+            placed.push_back(index);
+            m_stats.unaliasedTransientBytes += transient.requirements.size;
+
+            auto block = std::find_if(m_memoryBlocks.begin(), m_memoryBlocks.end(), [&](const MemoryBlock& b) {
+                return b.memoryType == transient.memoryType;
+            });
+            if (block == m_memoryBlocks.end()) {
+                m_memoryBlocks.push_back({transient.memoryType});
+                block = m_memoryBlocks.end() - 1;
+            }
+            block->size = std::max(block->size, offset + transient.requirements.size);
+        }
+
+        m_stats.transientBytes = 0;
+        for (MemoryBlock& block : m_memoryBlocks) {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = block.size;
+            allocInfo.memoryTypeIndex = block.memoryType;
+            if (vkAllocateMemory(m_device.device(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate render graph memory!");
+            }
+            m_stats.transientBytes += block.size;
+        }
+
+        for (TransientResource& transient : m_transients) {
+            VkDeviceMemory memory = std::find_if(m_memoryBlocks.begin(), m_memoryBlocks.end(), [&](const MemoryBlock& b) {
+                return b.memoryType == transient.memoryType;
+            })->memory;
+
+            if (transient.buffer != VK_NULL_HANDLE) {
+                vkBindBufferMemory(m_device.device(), transient.buffer, memory, transient.offset);
+                continue;
+            }
+            vkBindImageMemory(m_device.device(), transient.image, memory, transient.offset);
+
+            const ResourceNode& node = m_resources[transient.resource];
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = transient.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = node.imageDesc.format;
+            // views of depth/stencil formats are used as depth attachments or sampled depth
+            viewInfo.subresourceRange.aspectMask =
+                (node.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : node.aspect;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+            if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &transient.view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view!");
+            }
+        }
+
+        m_stats.transientResources = static_cast<uint32_t>(m_transients.size());
+    }
+
+    void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+        assert(m_culled.size() == m_passes.size() && "RenderGraph::compile() must be called before execute().");
+
+        auto record = [&](const BarrierBatch& batch) {
+            if (batch.empty()) {
+                return;
+            }
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+            imageBarriers.reserve(batch.images.size());
+            for (const ImageTransition& transition : batch.images) {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = transition.srcAccess;
+                barrier.dstAccessMask = transition.dstAccess;
+                barrier.oldLayout = transition.oldLayout;
+                barrier.newLayout = transition.newLayout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = getImage(transition.resource);
+                barrier.subresourceRange = {m_resources[transition.resource].aspect, 0, VK_REMAINING_MIP_LEVELS,
+                                            0, VK_REMAINING_ARRAY_LAYERS};
+                imageBarriers.push_back(barrier);
+            }
+
+            VkMemoryBarrier memoryBarrier{};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = batch.memorySrcAccess;
+            memoryBarrier.dstAccessMask = batch.memoryDstAccess;
+            uint32_t memoryBarrierCount = batch.memorySrcAccess != 0 ? 1 : 0;
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                batch.srcStages != 0 ? batch.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                batch.dstStages,
+                0,
+                memoryBarrierCount, &memoryBarrier,
+                0, nullptr,
+                static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        };
+
+        for (uint32_t p = 0; p < m_passes.size(); p++) {
+            if (m_culled[p]) {
+                continue;
+            }
+            record(m_barriers.passBarriers[p]);
+            if (m_passes[p].execute) {
+                m_passes[p].execute(commandBuffer);
+            }
+        }
+        record(m_barriers.finalBarriers);
+    }
+
+    VkImage RenderGraph::getImage(Resource resource) const {
+        int32_t transient = m_transientIndex[resource];
+        return transient >= 0 ? m_transients[transient].image : m_resources[resource].image;
+    }
+
+    VkImageView RenderGraph::getImageView(Resource resource) const {
+        int32_t transient = m_transientIndex[resource];
+        return transient >= 0 ? m_transients[transient].view : m_resources[resource].view;
+    }
+
+    VkBuffer RenderGraph::getBuffer(Resource resource) const {
+        int32_t transient = m_transientIndex[resource];
+        return transient >= 0 ? m_transients[transient].buffer : m_resources[resource].buffer;
+    }
+
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "vk_device.h"
+#include "deletion_queue.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VKEngine {
+
+    // Frame graph over the passes recorded into one command buffer. Passes declare the resources they
+    // read and write; compile() culls passes whose results are never used, places the barriers the
+    // declared accesses need (at most one vkCmdPipelineBarrier per pass, with buffer hazards folded
+    // into a single global memory barrier) and packs transient images and buffers that are never live
+    // at the same time into shared memory.
+    //
+    // Declarations are rebuilt every frame, but the compiled plan and the transient allocations are
+    // kept while the declarations stay the same, so steady-state frames only replay the plan.
+    //
+    // Passes that render begin and end rendering themselves; the graph has already moved their
+    // attachments into the layout of the declared access.
+    class RenderGraph {
+    public:
+        using Resource = uint32_t;
+        static constexpr Resource INVALID_RESOURCE = UINT32_MAX;
+
+        enum class Access {
+            ColorAttachmentWrite,
+            DepthAttachmentWrite,
+            DepthAttachmentRead,
+            FragmentSampled,
+            ComputeSampled,
+            ComputeStorageRead,
+            ComputeStorageWrite,
+            VertexStorageRead,
+            IndirectRead,
+            TransferRead,
+            TransferWrite,
+        };
+
+        struct ImageDesc {
+            VkFormat format;
+            VkExtent2D extent;
+            VkImageUsageFlags usage = 0;  // usage implied by the declared accesses is added
+        };
+
+        struct BufferDesc {
+            VkDeviceSize size;
+            VkBufferUsageFlags usage = 0;
+        };
+
+        struct Stats {
+            uint32_t passes = 0;
+            uint32_t culledPasses = 0;
+            uint32_t barrierBatches = 0;  // vkCmdPipelineBarrier calls per frame
+            uint32_t imageBarriers = 0;
+            uint32_t memoryBarriers = 0;
+            uint32_t transientResources = 0;
+            VkDeviceSize transientBytes = 0;           // peak, with aliasing
+            VkDeviceSize unaliasedTransientBytes = 0;  // what one allocation per resource would need
+            uint64_t compiles = 0;                     // plans built, as opposed to replayed
+        };
+
+        class PassBuilder {
+        public:
+            void read(Resource resource, Access access);
+            void write(Resource resource, Access access);
+            // Keeps the pass even if no other pass reads its outputs (presentation, readback)
+            void sideEffect();
+
+        private:
+            friend class RenderGraph;
+            PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+            RenderGraph& m_graph;
+            uint32_t m_pass;
+        };
+
+        using SetupFunction = std::function<void(PassBuilder&)>;
+        using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+
+        RenderGraph(Device& device, DeletionQueue& deletionQueue);
+        ~RenderGraph();
+
+        RenderGraph(const RenderGraph&) = delete;
+        RenderGraph &operator=(const RenderGraph&) = delete;
+
+        // Drops the previous frame's declarations; the compiled plan survives if they are declared again
+        void reset();
+
+        Resource createImage(const std::string& name, const ImageDesc& desc);
+        Resource createBuffer(const std::string& name, const BufferDesc& desc);
+        // Resources owned elsewhere are ordered but never aliased. Imported images are left in
+        // finalLayout, or in the layout of their last access if that is UNDEFINED. The first access
+        // waits for availableStages, e.g. the stage a swapchain image's acquire semaphore is waited at.
+        Resource importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+                             VkImageLayout currentLayout, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                             VkPipelineStageFlags availableStages = 0);
+        Resource importBuffer(const std::string& name, VkBuffer buffer = VK_NULL_HANDLE);
+
+        void addPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute);
+
+        void compile();
+        void execute(VkCommandBuffer commandBuffer);
+
+        // Physical handles, valid after compile()
+        VkImage getImage(Resource resource) const;
+        VkImageView getImageView(Resource resource) const;
+        VkBuffer getBuffer(Resource resource) const;
+
+        const Stats& getStats() const { return m_stats; }
+
+        // The compiled graph as barrier planning sees it. planBarriers() touches no Vulkan objects, so
+        // the barriers a graph gets can be checked without a device.
+        struct AccessInfo {
+            VkPipelineStageFlags stages;
+            VkAccessFlags access;
+            VkImageLayout layout;
+            VkImageUsageFlags imageUsage;
+            VkBufferUsageFlags bufferUsage;
+        };
+
+        static constexpr VkAccessFlags WRITE_ACCESS_MASK =
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        static AccessInfo accessInfo(Access access);
+
+        struct ResourceNode {
+            std::string name;
+            bool isImage = false;
+            bool imported = false;
+            ImageDesc imageDesc{};
+            BufferDesc bufferDesc{};
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkImageAspectFlags aspect = 0;
+            VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags availableStages = 0;
+        };
+
+        struct AccessEntry {
+            Resource resource;
+            Access access;
+            bool write;
+        };
+
+        struct PassNode {
+            std::string name;
+            std::vector<AccessEntry> accesses;
+            bool sideEffect = false;
+            ExecuteFunction execute;
+        };
+
+        struct ImageTransition {
+            Resource resource;
+            VkAccessFlags srcAccess;
+            VkAccessFlags dstAccess;
+            VkImageLayout oldLayout;
+            VkImageLayout newLayout;
+        };
+
+        struct BarrierBatch {
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            VkAccessFlags memorySrcAccess = 0;
+            VkAccessFlags memoryDstAccess = 0;
+            bool executionOnly = false;  // buffer hazards that need ordering but no memory visibility
+            std::vector<ImageTransition> images;
+
+            bool empty() const {
+                return images.empty() && memorySrcAccess == 0 && memoryDstAccess == 0 && !executionOnly;
+            }
+        };
+
+        // Transient resources placed in one allocation; several share it when their lifetimes don't overlap
+        struct TransientResource {
+            Resource resource;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkMemoryRequirements requirements{};
+            uint32_t memoryType = 0;
+            VkDeviceSize offset = 0;
+            uint32_t firstPass = 0;
+            uint32_t lastPass = 0;
+            VkPipelineStageFlags lastStages = 0;       // of the last use in the frame
+            VkPipelineStageFlags lastWriteStages = 0;  // of the last write, and what it wrote
+            VkAccessFlags lastWriteAccess = 0;
+        };
+
+        struct BarrierPlan {
+            std::vector<BarrierBatch> passBarriers;  // recorded before each pass, empty for culled ones
+            BarrierBatch finalBarriers;              // moves imported images into their final layout
+        };
+
+        // Transients are the placed ones of allocateTransients(), indexed through transientIndex;
+        // their last-use fields are filled in here
+        static BarrierPlan planBarriers(const std::vector<ResourceNode>& resources, const std::vector<PassNode>& passes,
+                                        const std::vector<bool>& culled, const std::vector<int32_t>& transientIndex,
+                                        std::vector<TransientResource>& transients);
+
+    private:
+        struct MemoryBlock {
+            uint32_t memoryType;
+            VkDeviceSize size = 0;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+        };
+
+        std::string signature() const;
+        void cullPasses();
+        void allocateTransients();
+        void releaseTransients();
+        VkFlags impliedUsage(Resource resource) const;
+
+        Device& m_device;
+        DeletionQueue& m_deletionQueue;
+
+        // this frame's declarations
+        std::vector<ResourceNode> m_resources;
+        std::vector<PassNode> m_passes;
+
+        // compiled plan, reused while the signature matches
+        std::string m_compiledSignature;
+        std::vector<bool> m_culled;
+        BarrierPlan m_barriers;
+        std::vector<int32_t> m_transientIndex;  // per resource, index into m_transients or -1
+        std::vector<TransientResource> m_transients;
+        std::vector<MemoryBlock> m_memoryBlocks;
+
+        Stats m_stats;
+    };
+
+}
@@ -0,0 +1,232 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace VKEngine {
+
+    RenderGraph::AccessInfo RenderGraph::accessInfo(Access access) {
+        constexpr VkPipelineStageFlags fragmentTests =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        switch (access) {
+            case Access::ColorAttachmentWrite:
+                return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0};
+            case Access::DepthAttachmentWrite:
+                return {fragmentTests,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0};
+            case Access::DepthAttachmentRead:
+                return {fragmentTests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0};
+            case Access::FragmentSampled:
+                return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+            case Access::ComputeSampled:
+                return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+            case Access::ComputeStorageRead:
+                return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+            case Access::ComputeStorageWrite:
+                return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+            case Access::VertexStorageRead:
+                return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+            case Access::IndirectRead:
+                return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                        VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT};
+            case Access::TransferRead:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+            case Access::TransferWrite:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT};
+        }
+        return {};
+    }
+
+    RenderGraph::BarrierPlan RenderGraph::planBarriers(const std::vector<ResourceNode>& resources,
+                                                       const std::vector<PassNode>& passes,
+                                                       const std::vector<bool>& culled,
+                                                       const std::vector<int32_t>& transientIndex,
+                                                       std::vector<TransientResource>& transients) {
+        struct State {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags writeStages = 0;
+            VkAccessFlags writeAccess = 0;
+            VkPipelineStageFlags readStages = 0;  // reads since the last write, already ordered after it
+            VkAccessFlags readAccess = 0;
+            bool used = false;
+        };
+        std::vector<State> states(resources.size());
+        for (Resource r = 0; r < resources.size(); r++) {
+            states[r].layout = resources[r].initialLayout;
+            // behaves like an earlier read: only ordering is needed, the contents are not written here
+            states[r].readStages = resources[r].availableStages;
+        }
+
+        BarrierPlan plan;
+        plan.passBarriers.assign(passes.size(), {});
+        std::vector<uint32_t> firstUseBatch(transients.size(), UINT32_MAX);
+        std::vector<VkAccessFlags> firstUseAccess(transients.size(), 0);
+
+        for (uint32_t p = 0; p < passes.size(); p++) {
+            if (culled[p]) {
+                continue;
+            }
+
+            // a pass may touch one resource several ways (e.g. storage read and write); merge them
+            struct Merged {
+                Resource resource;
+                VkPipelineStageFlags stages;
+                VkAccessFlags access;
+                VkImageLayout layout;
+                bool write;
+            };
+            std::vector<Merged> merged;
+            for (const AccessEntry& entry : passes[p].accesses) {
+                AccessInfo info = accessInfo(entry.access);
+                auto it = std::find_if(merged.begin(), merged.end(), [&](const Merged& m) {
+                    return m.resource == entry.resource;
+                });
+                if (it == merged.end()) {
+                    merged.push_back({entry.resource, info.stages, info.access, info.layout, entry.write});
+                    continue;
+                }
+                assert((!resources[entry.resource].isImage || it->layout == info.layout) &&
+                       "A pass cannot access one image in two layouts.");
+                it->stages |= info.stages;
+                it->access |= info.access;
+                it->write = it->write || entry.write;
+            }
+
+            BarrierBatch& batch = plan.passBarriers[p];
+            for (const Merged& m : merged) {
+                const ResourceNode& node = resources[m.resource];
+                State& state = states[m.resource];
+
+                bool needed = false;
+                VkPipelineStageFlags srcStages = 0;
+                VkAccessFlags srcAccess = 0;
+                if (node.isImage && state.layout != m.layout) {
+                    needed = true;
+                    srcStages |= state.writeStages | state.readStages;
+                    srcAccess |= state.writeAccess;
+                }
+                if (m.write && (state.writeStages | state.readStages) != 0) {
+                    // write after write needs the earlier write made available, write after read only ordering
+                    needed = true;
+                    srcStages |= state.writeStages | state.readStages;
+                    srcAccess |= state.writeAccess;
+                }
+                if (!m.write && state.writeStages != 0 &&
+                    ((m.stages & ~state.readStages) != 0 || (m.access & ~state.readAccess) != 0)) {
+                    needed = true;
+                    srcStages |= state.writeStages;
+                    srcAccess |= state.writeAccess;
+                }
+                int32_t transient = transientIndex[m.resource];
+                if (transient >= 0 && !state.used) {
+                    // memory may still hold an aliased resource or last frame's contents; the source
+                    // stages of those are added once all last uses are known
+                    needed = true;
+                    firstUseBatch[transient] = p;
+                    firstUseAccess[transient] = m.access;
+                }
+
+                if (needed) {
+                    batch.srcStages |= srcStages;
+                    batch.dstStages |= m.stages;
+                    if (node.isImage) {
+                        VkImageLayout oldLayout = (transient >= 0 && !state.used) ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                        batch.images.push_back({m.resource, srcAccess, m.access, oldLayout, m.layout});
+                    }
+                    else if (srcAccess != 0) {
+                        batch.memorySrcAccess |= srcAccess;
+                        batch.memoryDstAccess |= m.access;
+                    }
+                    else {
+                        batch.executionOnly = true;
+                    }
+                }
+
+                if (m.write) {
+                    state.writeStages = m.stages;
+                    state.writeAccess = m.access & WRITE_ACCESS_MASK;
+                    state.readStages = 0;
+                    state.readAccess = 0;
+                }
+                else {
+                    state.readStages |= m.stages;
+                    state.readAccess |= m.access;
+                }
+                if (node.isImage) {
+                    state.layout = m.layout;
+                }
+                state.used = true;
+                if (transient >= 0) {
+                    transients[transient].lastStages = m.stages;
+                    transients[transient].lastWriteStages = state.writeStages;
+                    transients[transient].lastWriteAccess = state.writeAccess;
+                }
+            }
+        }
+
+        // first uses wait for every earlier user of the same memory, which also covers the previous
+        // frame's use of the resource itself. Their writes are made available too: the layout
+        // transition from UNDEFINED writes the memory, and so does the new resource.
+        for (uint32_t t = 0; t < transients.size(); t++) {
+            if (firstUseBatch[t] == UINT32_MAX) {
+                continue;
+            }
+            const TransientResource& transient = transients[t];
+            VkPipelineStageFlags srcStages = 0;
+            VkAccessFlags srcAccess = 0;
+            for (const TransientResource& other : transients) {
+                bool sameMemory = other.memoryType == transient.memoryType &&
+                                  transient.offset < other.offset + other.requirements.size &&
+                                  other.offset < transient.offset + transient.requirements.size;
+                if (sameMemory) {
+                    srcStages |= other.lastStages | other.lastWriteStages;
+                    srcAccess |= other.lastWriteAccess;
+                }
+            }
+
+            BarrierBatch& batch = plan.passBarriers[firstUseBatch[t]];
+            batch.srcStages |= srcStages;
+            auto image = std::find_if(batch.images.begin(), batch.images.end(), [&](const ImageTransition& transition) {
+                return transition.resource == transient.resource;
+            });
+            if (image != batch.images.end()) {
+                image->srcAccess |= srcAccess;
+            }
+            else if (srcAccess != 0) {
+                batch.memorySrcAccess |= srcAccess;
+                batch.memoryDstAccess |= firstUseAccess[t];
+            }
+        }
+
+        for (Resource r = 0; r < resources.size(); r++) {
+            const ResourceNode& node = resources[r];
+            const State& state = states[r];
+            if (!node.imported || !node.isImage || node.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+                node.finalLayout == state.layout) {
+                continue;
+            }
+            plan.finalBarriers.srcStages |= state.writeStages | state.readStages;
+            plan.finalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            plan.finalBarriers.images.push_back({r, state.writeAccess, 0, state.layout, node.finalLayout});
+        }
+
+        return plan;
+    }
+
+}
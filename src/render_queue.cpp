@@ -0,0 +1,87 @@
+#include "render_queue.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace VKEngine {
+
+    uint64_t RenderQueue::makeKey(uint32_t pass, const DrawItem& item) {
+        constexpr uint32_t PIPELINE_MASK = (1u << PIPELINE_BITS) - 1;
+        constexpr uint32_t MATERIAL_MASK = (1u << MATERIAL_BITS) - 1;
+        constexpr uint32_t MESH_MASK = (1u << MESH_BITS) - 1;
+
+        // clip-space z/w is the depth buffer value, front to back in [0, 1]
+        glm::vec4 clip = item.data.transform * glm::vec4(item.model->getBoundingSphere().center, 1.0f);
+        float depth = clip.w > 0.0f ? clip.z / clip.w : 0.0f;
+
+        uint32_t mesh = (item.model->getMeshId() << LOD_BITS) | item.lod;
+        return makeKey(pass, item.pipeline->sortId() & PIPELINE_MASK, item.data.materialId & MATERIAL_MASK, depth,
+                       mesh & MESH_MASK);
+    }
+
+    void RenderQueue::clear() {
+        m_items.clear();
+        m_entries.clear();
+        m_sorted = false;
+    }
+
+    void RenderQueue::reserve(size_t count) {
+        m_items.reserve(count);
+        m_entries.reserve(count);
+        m_scratch.reserve(count);
+    }
+
+    void RenderQueue::submit(uint64_t key, const DrawItem& item) {
+        m_entries.push_back({key, static_cast<uint32_t>(m_items.size())});
+        m_items.push_back(item);
+        m_sorted = false;
+    }
+
+    void RenderQueue::sort() {
+        auto start = std::chrono::high_resolution_clock::now();
+        radixSort(m_entries, m_scratch);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        m_stats.sortMicros = std::chrono::duration<double, std::micro>(end - start).count();
+        m_sorted = true;
+    }
+
+    void RenderQueue::record(VkCommandBuffer commandBuffer, PerDrawConstants<DrawData>& perDraw, VkPipelineLayout layout) {
+        assert(m_sorted && "RenderQueue::sort() must be called before record().");
+
+        m_stats.items = static_cast<uint32_t>(m_entries.size());
+        m_stats.pipelineBinds = 0;
+        m_stats.pipelineBindsAvoided = 0;
+        m_stats.geometryBinds = 0;
+        m_stats.geometryBindsAvoided = 0;
+
+        Pipeline* boundPipeline = nullptr;
+        const GeometryBuffer* boundGeometry = nullptr;
+        for (const auto& entry : m_entries) {
+            const DrawItem& item = m_items[entry.index];
+
+            if (item.pipeline != boundPipeline) {
+                item.pipeline->bind(commandBuffer);
+                boundPipeline = item.pipeline;
+                m_stats.pipelineBinds++;
+            }
+            else {
+                m_stats.pipelineBindsAvoided++;
+            }
+
+            // models share geometry buffers, a bind is only needed when the buffer changes
+            if (&item.model->getGeometry() != boundGeometry) {
+                item.model->bind(commandBuffer);
+                boundGeometry = &item.model->getGeometry();
+                m_stats.geometryBinds++;
+            }
+            else {
+                m_stats.geometryBindsAvoided++;
+            }
+
+            perDraw.push(commandBuffer, layout, item.data);
+            item.model->draw(commandBuffer, item.lod);
+        }
+    }
+
+}
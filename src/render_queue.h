@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vk_pipeline.h"
+#include "model.h"
+#include "push_constants.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace VKEngine {
+
+    // Collects draw submissions for a frame, sorts them by a packed 64-bit key and records them
+    // while skipping pipeline and geometry binds that would not change any state.
+    //
+    // Key layout, most significant first:
+    //   pass(4) | pipeline(12) | material(16) | depth(16) | mesh(16)
+    // where mesh is the model's mesh id with the LOD in its low bits.
+    class RenderQueue {
+    public:
+        static constexpr uint32_t PASS_BITS = 4;
+        static constexpr uint32_t PIPELINE_BITS = 12;
+        static constexpr uint32_t MATERIAL_BITS = 16;
+        static constexpr uint32_t DEPTH_BITS = 16;
+        static constexpr uint32_t MESH_BITS = 16;
+        static constexpr uint32_t LOD_BITS = 2;
+        static_assert(Model::MAX_LODS <= (1u << LOD_BITS), "Every LOD must fit in the mesh field.");
+
+        struct DrawItem {
+            Pipeline* pipeline;
+            Model* model;
+            uint32_t lod = 0;
+            DrawData data{};
+        };
+
+        struct Stats {
+            uint32_t items = 0;
+            uint32_t pipelineBinds = 0;
+            uint32_t pipelineBindsAvoided = 0;
+            uint32_t geometryBinds = 0;
+            uint32_t geometryBindsAvoided = 0;
+            double sortMicros = 0.0;
+        };
+
+        // depth is a normalized view depth in [0, 1]; pass translucent geometry as (1 - depth)
+        // to get back-to-front ordering
+        static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, uint32_t mesh);
+        // Key for an opaque draw from its pipeline, material, model and LOD, and the depth of the model's
+        // bounding sphere center under item.data.transform. Ids too large for their field wrap around,
+        // which only costs binds.
+        static uint64_t makeKey(uint32_t pass, const DrawItem& item);
+
+        void clear();
+        void reserve(size_t count);
+        void submit(uint64_t key, const DrawItem& item);
+
+        void sort();
+        // Records every item in key order, pushing its DrawData; sort() must have been called
+        void record(VkCommandBuffer commandBuffer, PerDrawConstants<DrawData>& perDraw, VkPipelineLayout layout);
+
+        size_t size() const { return m_items.size(); }
+        const Stats& getStats() const { return m_stats; }
+
+        // LSD radix sort on the key, 8 bits per pass, skipping passes where every key shares the digit
+        struct SortEntry {
+            uint64_t key;
+            uint32_t index;
+        };
+        static void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+    private:
+        std::vector<DrawItem> m_items;
+        std::vector<SortEntry> m_entries;
+        std::vector<SortEntry> m_scratch;
+        bool m_sorted = false;
+        Stats m_stats;
+    };
+
+}
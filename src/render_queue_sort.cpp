@@ -0,0 +1,71 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+// Key packing and sorting, kept apart from recording so they build without a device
+
+namespace VKEngine {
+
+    uint64_t RenderQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, uint32_t mesh) {
+        assert(pass < (1u << PASS_BITS) && "Render pass id does not fit in the sort key.");
+        assert(pipeline < (1u << PIPELINE_BITS) && "Pipeline id does not fit in the sort key.");
+        assert(material < (1u << MATERIAL_BITS) && "Material id does not fit in the sort key.");
+        assert(mesh < (1u << MESH_BITS) && "Mesh id does not fit in the sort key.");
+
+        float clamped = std::clamp(depth, 0.0f, 1.0f);
+        auto quantizedDepth = static_cast<uint64_t>(clamped * static_cast<float>((1u << DEPTH_BITS) - 1));
+
+        uint64_t key = pass;
+        key = (key << PIPELINE_BITS) | pipeline;
+        key = (key << MATERIAL_BITS) | material;
+        key = (key << DEPTH_BITS) | quantizedDepth;
+        key = (key << MESH_BITS) | mesh;
+        return key;
+    }
+
+    void RenderQueue::radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+        const size_t count = entries.size();
+        if (count < 2) {
+            return;
+        }
+        scratch.resize(count);
+
+        // one histogram per byte, built in a single pass over the keys
+        std::array<std::array<uint32_t, 256>, 8> histograms{};
+        for (const auto& entry : entries) {
+            for (int digit = 0; digit < 8; digit++) {
+                histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+            }
+        }
+
+        SortEntry* src = entries.data();
+        SortEntry* dst = scratch.data();
+        for (int digit = 0; digit < 8; digit++) {
+            auto& histogram = histograms[digit];
+
+            // unused key fields are common (e.g. a single pass), skip digits where every key agrees
+            uint8_t firstDigit = static_cast<uint8_t>((src[0].key >> (digit * 8)) & 0xFF);
+            if (histogram[firstDigit] == count) {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for (auto& bucket : histogram) {
+                uint32_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; i++) {
+                dst[histogram[(src[i].key >> (digit * 8)) & 0xFF]++] = src[i];
+            }
+            std::swap(src, dst);
+        }
+
+        if (src != entries.data()) {
+            std::copy(src, src + count, entries.data());
+        }
+    }
+
+}
@@ -0,0 +1,453 @@
+#include "scene.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VKENGINE_SCENE_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace VKEngine {
+
+    namespace {
+
+        constexpr size_t LOCAL_GROUPS_PER_BATCH = 256;   // groups of four entities
+        constexpr size_t WORLD_ENTITIES_PER_BATCH = 1024;
+
+        size_t paddedCount(size_t count) {
+            return (count + 3) & ~size_t(3);
+        }
+
+        template <typename T>
+        void gather(std::vector<T>& values, const std::vector<uint32_t>& order, size_t size, const T& fill) {
+            std::vector<T> result(size, fill);
+            for (size_t i = 0; i < order.size(); i++) {
+                result[i] = values[order[i]];
+            }
+            values.swap(result);
+        }
+
+        // out = a * b for column-major 4x4 matrices; out must not alias either input
+        void multiplyMat4(const float* a, const float* b, float* out) {
+#if defined(__AVX__)
+            // two result columns per iteration, each 128-bit lane broadcasts its own column's elements
+            __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 0));
+            __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+            __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+            __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+            for (int column = 0; column < 4; column += 2) {
+                __m256 b01 = _mm256_loadu_ps(b + column * 4);
+                __m256 result = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1))));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2))));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3))));
+                _mm256_storeu_ps(out + column * 4, result);
+            }
+#elif defined(VKENGINE_SCENE_SSE)
+            __m128 a0 = _mm_loadu_ps(a + 0);
+            __m128 a1 = _mm_loadu_ps(a + 4);
+            __m128 a2 = _mm_loadu_ps(a + 8);
+            __m128 a3 = _mm_loadu_ps(a + 12);
+            for (int column = 0; column < 4; column++) {
+                const float* bc = b + column * 4;
+                __m128 result = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+                result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+                result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+                result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+                _mm_storeu_ps(out + column * 4, result);
+            }
+#else
+            for (int column = 0; column < 4; column++) {
+                for (int row = 0; row < 4; row++) {
+                    out[column * 4 + row] = a[0 * 4 + row] * b[column * 4 + 0] +
+                                            a[1 * 4 + row] * b[column * 4 + 1] +
+                                            a[2 * 4 + row] * b[column * 4 + 2] +
+                                            a[3 * 4 + row] * b[column * 4 + 3];
+                }
+            }
+#endif
+        }
+
+    }
+
+    Scene::Entity Scene::createEntity(Entity parent) {
+        assert((parent == INVALID_ENTITY || isAlive(parent)) && "Parent entity does not exist.");
+
+        Entity entity;
+        if (!m_freeEntities.empty()) {
+            entity = m_freeEntities.back();
+            m_freeEntities.pop_back();
+        }
+        else {
+            entity = static_cast<Entity>(m_entityToIndex.size());
+            m_entityToIndex.push_back(NO_INDEX);
+        }
+
+        uint32_t index = size();
+        m_entityToIndex[entity] = index;
+        m_indexToEntity.push_back(entity);
+        m_parentEntity.push_back(parent);
+        m_parentIndex.push_back(parent == INVALID_ENTITY ? NO_INDEX : indexOf(parent));
+        m_world.emplace_back(1.0f);
+        resizeComponents(index + 1);
+
+        m_posX[index] = m_posY[index] = m_posZ[index] = 0.0f;
+        m_rotX[index] = m_rotY[index] = m_rotZ[index] = 0.0f;
+        m_rotW[index] = 1.0f;
+        m_scaleX[index] = m_scaleY[index] = m_scaleZ[index] = 1.0f;
+        markLocalDirty(index);
+
+        // the new entity is appended at the end, which only stays depth sorted in trivial cases
+        m_orderDirty = true;
+        return entity;
+    }
+
+    void Scene::destroyEntity(Entity entity) {
+        assert(isAlive(entity) && "Entity does not exist.");
+
+        // 0 = unknown, 1 = destroyed, 2 = kept
+        const uint32_t count = size();
+        std::vector<uint8_t> state(count, 0);
+        state[indexOf(entity)] = 1;
+
+        std::vector<uint32_t> chain;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t current = i;
+            while (state[current] == 0 && m_parentIndex[current] != NO_INDEX) {
+                chain.push_back(current);
+                current = m_parentIndex[current];
+            }
+            uint8_t resolved = state[current] == 0 ? 2 : state[current];
+            state[current] = resolved;
+            for (uint32_t index : chain) {
+                state[index] = resolved;
+            }
+            chain.clear();
+        }
+
+        std::vector<uint32_t> kept;
+        kept.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (state[i] == 1) {
+                m_entityToIndex[m_indexToEntity[i]] = NO_INDEX;
+                m_freeEntities.push_back(m_indexToEntity[i]);
+            }
+            else {
+                kept.push_back(i);
+            }
+        }
+
+        applyOrder(kept);
+        m_orderDirty = true;
+    }
+
+    bool Scene::isAlive(Entity entity) const {
+        return entity < m_entityToIndex.size() && m_entityToIndex[entity] != NO_INDEX;
+    }
+
+    void Scene::setParent(Entity entity, Entity parent) {
+        assert(isAlive(entity) && "Entity does not exist.");
+        assert((parent == INVALID_ENTITY || isAlive(parent)) && "Parent entity does not exist.");
+        for (Entity ancestor = parent; ancestor != INVALID_ENTITY; ancestor = getParent(ancestor)) {
+            assert(ancestor != entity && "Reparenting would create a cycle.");
+        }
+
+        uint32_t index = indexOf(entity);
+        m_parentEntity[index] = parent;
+        m_parentIndex[index] = parent == INVALID_ENTITY ? NO_INDEX : indexOf(parent);
+        markLocalDirty(index);
+        m_orderDirty = true;
+    }
+
+    void Scene::setPosition(Entity entity, const glm::vec3& position) {
+        uint32_t index = indexOf(entity);
+        m_posX[index] = position.x;
+        m_posY[index] = position.y;
+        m_posZ[index] = position.z;
+        markLocalDirty(index);
+    }
+
+    void Scene::setRotation(Entity entity, const glm::quat& rotation) {
+        uint32_t index = indexOf(entity);
+        m_rotX[index] = rotation.x;
+        m_rotY[index] = rotation.y;
+        m_rotZ[index] = rotation.z;
+        m_rotW[index] = rotation.w;
+        markLocalDirty(index);
+    }
+
+    void Scene::setScale(Entity entity, const glm::vec3& scale) {
+        uint32_t index = indexOf(entity);
+        m_scaleX[index] = scale.x;
+        m_scaleY[index] = scale.y;
+        m_scaleZ[index] = scale.z;
+        markLocalDirty(index);
+    }
+
+    glm::vec3 Scene::getPosition(Entity entity) const {
+        uint32_t index = indexOf(entity);
+        return {m_posX[index], m_posY[index], m_posZ[index]};
+    }
+
+    glm::quat Scene::getRotation(Entity entity) const {
+        uint32_t index = indexOf(entity);
+        return glm::quat(m_rotW[index], m_rotX[index], m_rotY[index], m_rotZ[index]);
+    }
+
+    glm::vec3 Scene::getScale(Entity entity) const {
+        uint32_t index = indexOf(entity);
+        return {m_scaleX[index], m_scaleY[index], m_scaleZ[index]};
+    }
+
+    void Scene::update() {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (m_orderDirty) {
+            rebuildOrder();
+        }
+
+        JobSystem& jobs = JobSystem::shared();
+        const size_t count = size();
+
+        size_t groupCount = paddedCount(count) / 4;
+        jobs.parallelFor(groupCount, LOCAL_GROUPS_PER_BATCH, [this](size_t begin, size_t end) {
+            updateLocalMatrices(begin * 4, end * 4);
+        });
+
+        // parents always live in an earlier level, so every level only reads finished matrices
+        for (size_t level = 0; level + 1 < m_levelOffsets.size(); level++) {
+            size_t levelBegin = m_levelOffsets[level];
+            size_t levelSize = m_levelOffsets[level + 1] - levelBegin;
+            jobs.parallelFor(levelSize, WORLD_ENTITIES_PER_BATCH, [this, levelBegin](size_t begin, size_t end) {
+                updateWorldMatrices(levelBegin + begin, levelBegin + end);
+            });
+        }
+
+        collectDirtyRanges();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        m_stats.entities = static_cast<uint32_t>(count);
+        m_stats.levels = m_levelOffsets.empty() ? 0 : static_cast<uint32_t>(m_levelOffsets.size() - 1);
+        m_stats.dirtyRanges = static_cast<uint32_t>(m_dirtyRanges.size());
+        m_stats.updateMicros = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    void Scene::rebuildOrder() {
+        const uint32_t count = size();
+
+        // depth of every entity, resolved by walking up to the first known ancestor
+        std::vector<uint32_t> depth(count, NO_INDEX);
+        std::vector<uint32_t> chain;
+        uint32_t maxDepth = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t current = i;
+            while (depth[current] == NO_INDEX && m_parentIndex[current] != NO_INDEX) {
+                chain.push_back(current);
+                current = m_parentIndex[current];
+            }
+            if (depth[current] == NO_INDEX) {
+                depth[current] = 0;
+            }
+            uint32_t currentDepth = depth[current];
+            while (!chain.empty()) {
+                depth[chain.back()] = ++currentDepth;
+                chain.pop_back();
+            }
+            maxDepth = std::max(maxDepth, currentDepth);
+        }
+
+        // counting sort by depth, stable so siblings keep their relative order
+        m_levelOffsets.assign(count == 0 ? 0 : maxDepth + 2, 0);
+        for (uint32_t i = 0; i < count; i++) {
+            m_levelOffsets[depth[i] + 1]++;
+        }
+        for (size_t level = 1; level < m_levelOffsets.size(); level++) {
+            m_levelOffsets[level] += m_levelOffsets[level - 1];
+        }
+
+        std::vector<uint32_t> order(count);
+        std::vector<uint32_t> cursor(m_levelOffsets);
+        for (uint32_t i = 0; i < count; i++) {
+            order[cursor[depth[i]]++] = i;
+        }
+
+        applyOrder(order);
+        m_orderDirty = false;
+    }
+
+    void Scene::applyOrder(const std::vector<uint32_t>& order) {
+        const size_t count = order.size();
+        const size_t padded = paddedCount(count);
+
+        gather(m_posX, order, padded, 0.0f);
+        gather(m_posY, order, padded, 0.0f);
+        gather(m_posZ, order, padded, 0.0f);
+        gather(m_rotX, order, padded, 0.0f);
+        gather(m_rotY, order, padded, 0.0f);
+        gather(m_rotZ, order, padded, 0.0f);
+        gather(m_rotW, order, padded, 1.0f);
+        gather(m_scaleX, order, padded, 1.0f);
+        gather(m_scaleY, order, padded, 1.0f);
+        gather(m_scaleZ, order, padded, 1.0f);
+        gather(m_local, order, padded, glm::mat4(1.0f));
+        gather(m_world, order, count, glm::mat4(1.0f));
+        gather(m_parentEntity, order, count, INVALID_ENTITY);
+        gather(m_indexToEntity, order, count, INVALID_ENTITY);
+
+        for (uint32_t i = 0; i < count; i++) {
+            m_entityToIndex[m_indexToEntity[i]] = i;
+        }
+        m_parentIndex.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            Entity parent = m_parentEntity[i];
+            m_parentIndex[i] = parent == INVALID_ENTITY ? NO_INDEX : m_entityToIndex[parent];
+        }
+
+        // dense indices moved, so every consumer has to see every matrix again
+        m_localDirty.assign(padded, 1);
+        m_worldChanged.assign(padded, 0);
+    }
+
+    void Scene::resizeComponents(size_t count) {
+        const size_t padded = paddedCount(count);
+        m_posX.resize(padded, 0.0f);
+        m_posY.resize(padded, 0.0f);
+        m_posZ.resize(padded, 0.0f);
+        m_rotX.resize(padded, 0.0f);
+        m_rotY.resize(padded, 0.0f);
+        m_rotZ.resize(padded, 0.0f);
+        m_rotW.resize(padded, 1.0f);
+        m_scaleX.resize(padded, 1.0f);
+        m_scaleY.resize(padded, 1.0f);
+        m_scaleZ.resize(padded, 1.0f);
+        m_local.resize(padded, glm::mat4(1.0f));
+        m_localDirty.resize(padded, 0);
+        m_worldChanged.resize(padded, 0);
+    }
+
+    // Builds T * R * S for entities [begin, end); begin and end are multiples of four
+    void Scene::updateLocalMatrices(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i += 4) {
+            uint32_t dirtyMask;
+            std::memcpy(&dirtyMask, &m_localDirty[i], sizeof(dirtyMask));
+            if (dirtyMask == 0) {
+                continue;
+            }
+
+#if defined(VKENGINE_SCENE_SSE)
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+
+            __m128 qx = _mm_loadu_ps(&m_rotX[i]);
+            __m128 qy = _mm_loadu_ps(&m_rotY[i]);
+            __m128 qz = _mm_loadu_ps(&m_rotZ[i]);
+            __m128 qw = _mm_loadu_ps(&m_rotW[i]);
+
+            __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+            __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+            __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+            __m128 sx = _mm_loadu_ps(&m_scaleX[i]);
+            __m128 sy = _mm_loadu_ps(&m_scaleY[i]);
+            __m128 sz = _mm_loadu_ps(&m_scaleZ[i]);
+
+            // one register per matrix element, lane k belongs to entity i + k
+            __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+            __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+            __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+            __m128 c0w = _mm_setzero_ps();
+
+            __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+            __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+            __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+            __m128 c1w = _mm_setzero_ps();
+
+            __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+            __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+            __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+            __m128 c2w = _mm_setzero_ps();
+
+            __m128 c3x = _mm_loadu_ps(&m_posX[i]);
+            __m128 c3y = _mm_loadu_ps(&m_posY[i]);
+            __m128 c3z = _mm_loadu_ps(&m_posZ[i]);
+            __m128 c3w = one;
+
+            // after transposing, register k holds the column for entity i + k
+            _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+            _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+            _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+            _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+            const __m128 columns[4][4] = {
+                {c0x, c1x, c2x, c3x},
+                {c0y, c1y, c2y, c3y},
+                {c0z, c1z, c2z, c3z},
+                {c0w, c1w, c2w, c3w},
+            };
+            for (size_t lane = 0; lane < 4; lane++) {
+                float* out = &m_local[i + lane][0][0];
+                for (int column = 0; column < 4; column++) {
+                    _mm_storeu_ps(out + column * 4, columns[lane][column]);
+                }
+            }
+#else
+            for (size_t k = i; k < i + 4; k++) {
+                glm::mat4 rotation = glm::mat4_cast(glm::quat(m_rotW[k], m_rotX[k], m_rotY[k], m_rotZ[k]));
+                glm::mat4& local = m_local[k];
+                local[0] = rotation[0] * m_scaleX[k];
+                local[1] = rotation[1] * m_scaleY[k];
+                local[2] = rotation[2] * m_scaleZ[k];
+                local[3] = glm::vec4(m_posX[k], m_posY[k], m_posZ[k], 1.0f);
+            }
+#endif
+
+            for (size_t k = i; k < i + 4; k++) {
+                m_worldChanged[k] = m_localDirty[k];
+                m_localDirty[k] = 0;
+            }
+        }
+    }
+
+    void Scene::updateWorldMatrices(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t parent = m_parentIndex[i];
+            if (parent == NO_INDEX) {
+                if (m_worldChanged[i]) {
+                    m_world[i] = m_local[i];
+                }
+                continue;
+            }
+
+            if (m_worldChanged[i] || m_worldChanged[parent]) {
+                multiplyMat4(&m_world[parent][0][0], &m_local[i][0][0], &m_world[i][0][0]);
+                m_worldChanged[i] = 1;
+            }
+        }
+    }
+
+    void Scene::collectDirtyRanges() {
+        m_dirtyRanges.clear();
+        m_stats.changed = 0;
+
+        const uint32_t count = size();
+        for (uint32_t i = 0; i < count; i++) {
+            if (!m_worldChanged[i]) {
+                continue;
+            }
+            m_worldChanged[i] = 0;
+            m_stats.changed++;
+
+            if (!m_dirtyRanges.empty() && i - m_dirtyRanges.back().end < DIRTY_RANGE_MERGE_GAP) {
+                m_dirtyRanges.back().end = i + 1;
+            }
+            else {
+                m_dirtyRanges.push_back({i, i + 1});
+            }
+        }
+    }
+
+}
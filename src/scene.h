@@ -0,0 +1,106 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace VKEngine {
+
+    // Entity/transform store. Transform components are kept as structure-of-arrays and entities are
+    // ordered by hierarchy depth, so every parent precedes its children. update() rebuilds local
+    // matrices four (SSE) entities at a time and composes local-to-world level by level, each level
+    // spread across the shared JobSystem. Only entities whose world matrix changed are reported
+    // through getDirtyRanges(), so uploads can be limited to those ranges. Structural changes
+    // (create, destroy, reparent) re-sort the store on the next update and report everything as changed.
+    class Scene {
+    public:
+        using Entity = uint32_t;
+        static constexpr Entity INVALID_ENTITY = UINT32_MAX;
+
+        // Half-open range of dense indices (see indexOf) whose world matrices changed in the last update
+        struct DirtyRange {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        struct Stats {
+            uint32_t entities = 0;
+            uint32_t levels = 0;
+            uint32_t changed = 0;
+            uint32_t dirtyRanges = 0;
+            double updateMicros = 0.0;
+        };
+
+        Scene() = default;
+        Scene(const Scene&) = delete;
+        Scene &operator=(const Scene&) = delete;
+
+        Entity createEntity(Entity parent = INVALID_ENTITY);
+        // Destroys the entity together with all of its descendants
+        void destroyEntity(Entity entity);
+        bool isAlive(Entity entity) const;
+
+        void setParent(Entity entity, Entity parent);
+        Entity getParent(Entity entity) const { return m_parentEntity[indexOf(entity)]; }
+
+        void setPosition(Entity entity, const glm::vec3& position);
+        void setRotation(Entity entity, const glm::quat& rotation);
+        void setScale(Entity entity, const glm::vec3& scale);
+        glm::vec3 getPosition(Entity entity) const;
+        glm::quat getRotation(Entity entity) const;
+        glm::vec3 getScale(Entity entity) const;
+
+        void update();
+
+        const glm::mat4& getWorldMatrix(Entity entity) const { return m_world[indexOf(entity)]; }
+        const glm::mat4* worldMatrices() const { return m_world.data(); }
+        const std::vector<DirtyRange>& getDirtyRanges() const { return m_dirtyRanges; }
+
+        uint32_t size() const { return static_cast<uint32_t>(m_indexToEntity.size()); }
+        uint32_t indexOf(Entity entity) const { return m_entityToIndex[entity]; }
+        Entity entityAt(uint32_t index) const { return m_indexToEntity[index]; }
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        static constexpr uint32_t NO_INDEX = UINT32_MAX;
+        // gaps smaller than this between changed entities are merged into one upload range
+        static constexpr uint32_t DIRTY_RANGE_MERGE_GAP = 64;
+
+        void rebuildOrder();
+        // Reorders every per-entity array so that new index i holds old index order[i]
+        void applyOrder(const std::vector<uint32_t>& order);
+        void resizeComponents(size_t count);
+        void markLocalDirty(uint32_t index) { m_localDirty[index] = 1; }
+
+        void updateLocalMatrices(size_t begin, size_t end);
+        void updateWorldMatrices(size_t begin, size_t end);
+        void collectDirtyRanges();
+
+        // structure-of-arrays transform components, padded to a multiple of four for SIMD
+        std::vector<float> m_posX, m_posY, m_posZ;
+        std::vector<float> m_rotX, m_rotY, m_rotZ, m_rotW;
+        std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+        std::vector<uint8_t> m_localDirty;
+        std::vector<uint8_t> m_worldChanged;
+
+        std::vector<uint32_t> m_parentIndex;
+        std::vector<Entity> m_parentEntity;
+        std::vector<glm::mat4> m_local;
+        std::vector<glm::mat4> m_world;
+
+        std::vector<uint32_t> m_entityToIndex;
+        std::vector<Entity> m_indexToEntity;
+        std::vector<Entity> m_freeEntities;
+
+        std::vector<uint32_t> m_levelOffsets;  // first dense index of every depth level, plus the end
+        bool m_orderDirty = false;
+
+        std::vector<DirtyRange> m_dirtyRanges;
+        Stats m_stats;
+    };
+
+}
@@ -0,0 +1,148 @@
+#include "simulation.h"
+
+#include <algorithm>
+
+namespace VKEngine {
+
+    Simulation::Simulation(Scene& scene, TickFunction tickFunction, std::function<void()> onChange)
+        : m_scene(scene), m_tickFunction(std::move(tickFunction)), m_onChange(std::move(onChange)) {}
+
+    Simulation::~Simulation() {
+        stop();
+    }
+
+    void Simulation::start() {
+        if (m_thread.joinable()) {
+            return;
+        }
+        // the first snapshot is there before the render thread asks for one
+        step(Clock::now());
+        m_stopping = false;
+        m_thread = std::thread(&Simulation::threadLoop, this);
+    }
+
+    void Simulation::stop() {
+        m_stopping = true;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    void Simulation::threadLoop() {
+        auto tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(TICK_SECONDS));
+        Clock::time_point due = Clock::now() + tick;
+
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            Clock::time_point now = Clock::now();
+            if (now < due) {
+                std::this_thread::sleep_until(due);
+                continue;
+            }
+            if (now - due > tick * MAX_CATCH_UP_TICKS) {
+                m_skippedTicks += static_cast<uint64_t>((now - due) / tick);
+                due = now;
+            }
+            step(due);
+            due += tick;
+        }
+    }
+
+    void Simulation::step(Clock::time_point due) {
+        Clock::time_point start = Clock::now();
+        m_tick++;
+
+        // entities that moved in the last tick start this one at rest
+        for (Scene::Entity entity : m_moved) {
+            m_previous[entity] = m_current[entity];
+        }
+        m_moved.clear();
+
+        if (m_tickFunction) {
+            m_tickFunction(m_scene, TICK_SECONDS);
+        }
+        m_scene.update();
+
+        // the scene only reports entities whose world matrix changed
+        const glm::mat4* world = m_scene.worldMatrices();
+        for (const auto& range : m_scene.getDirtyRanges()) {
+            for (uint32_t i = range.begin; i < range.end; i++) {
+                Scene::Entity entity = m_scene.entityAt(i);
+                if (entity >= m_current.size()) {
+                    m_previous.resize(entity + 1, glm::mat4{1.0f});
+                    m_current.resize(entity + 1, glm::mat4{1.0f});
+                    m_changedTick.resize(entity + 1, 0);
+                    m_isUnapplied.resize(entity + 1, false);
+                }
+                // a new entity appears where it is instead of sliding in from the origin
+                if (m_changedTick[entity] == 0) {
+                    m_previous[entity] = world[i];
+                }
+                m_current[entity] = world[i];
+                m_changedTick[entity] = m_tick;
+                m_moved.push_back(entity);
+                if (!m_isUnapplied[entity]) {
+                    m_isUnapplied[entity] = true;
+                    m_unapplied.push_back(entity);
+                }
+            }
+        }
+
+        // the render thread may skip snapshots, so everything it hasn't applied in full goes out again
+        uint64_t acknowledged = m_acknowledgedTick.load(std::memory_order_acquire);
+        Snapshot& snapshot = m_snapshots.back();
+        snapshot.tick = m_tick;
+        snapshot.time = due;
+        snapshot.changes.clear();
+        size_t kept = 0;
+        for (Scene::Entity entity : m_unapplied) {
+            if (m_changedTick[entity] <= acknowledged) {
+                m_isUnapplied[entity] = false;
+                continue;
+            }
+            m_unapplied[kept++] = entity;
+            snapshot.changes.push_back({entity, m_changedTick[entity], m_previous[entity], m_current[entity]});
+        }
+        m_unapplied.resize(kept);
+        snapshot.skippedTicks = m_skippedTicks;
+        snapshot.scene = m_scene.getStats();
+        snapshot.tickMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        m_snapshots.publish();
+
+        if (!m_moved.empty() && m_onChange) {
+            m_onChange();
+        }
+    }
+
+    uint32_t Simulation::interpolate(Clock::time_point now, const ApplyFunction& apply) {
+        const Snapshot& snapshot = m_snapshots.acquire();
+        if (snapshot.tick == 0) {
+            return 0;
+        }
+
+        double elapsed = std::chrono::duration<double>(now - snapshot.time).count();
+        float alpha = static_cast<float>(std::clamp(elapsed / TICK_SECONDS, 0.0, 1.0));
+
+        uint32_t applied = 0;
+        for (const Change& change : snapshot.changes) {
+            if (change.tick <= m_appliedTick) {
+                continue;
+            }
+            const glm::mat4& previous = change.previous;
+            const glm::mat4& current = change.current;
+            apply(change.entity, alpha >= 1.0f ? current : previous + (current - previous) * alpha);
+            applied++;
+        }
+        // changes from the snapshot's last tick are only final once the blend has reached them
+        m_appliedTick = alpha >= 1.0f ? snapshot.tick : snapshot.tick - 1;
+        m_acknowledgedTick.store(m_appliedTick, std::memory_order_release);
+
+        m_stats.ticks = snapshot.tick;
+        m_stats.skippedTicks = snapshot.skippedTicks;
+        m_stats.tickMicros = snapshot.tickMicros;
+        m_stats.alpha = alpha;
+        m_stats.interpolated = applied;
+        m_stats.scene = snapshot.scene;
+        return applied;
+    }
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "scene.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace VKEngine {
+
+    // Runs the update step on its own thread at a fixed rate, independent of the frame rate. After
+    // every tick the world matrices of the current and previous tick are published through a triple
+    // buffer; the render thread picks up the newest snapshot without waiting and draws in between the
+    // two, one tick behind the simulation. A snapshot only carries the entities the render thread
+    // hasn't applied in full yet, so publishing and interpolating cost follows what moves, not the
+    // size of the scene. A slow frame then doesn't slow the simulation down, and
+    // the update doesn't eat into the frame's CPU time.
+    //
+    // Once start() has been called the scene belongs to the simulation thread; changes to it go
+    // through the tick function. Matrices are blended element-wise, which stays close to rigid for
+    // the small rotation a single tick makes.
+    class Simulation {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using TickFunction = std::function<void(Scene& scene, double seconds)>;
+        using ApplyFunction = std::function<void(Scene::Entity entity, const glm::mat4& world)>;
+
+        static constexpr double TICK_SECONDS = 1.0 / 60.0;
+        // ticks run back to back to catch up after a stall before the schedule is reset instead
+        static constexpr uint32_t MAX_CATCH_UP_TICKS = 5;
+
+        struct Stats {
+            uint64_t ticks = 0;
+            uint64_t skippedTicks = 0;   // dropped after stalls
+            double tickMicros = 0.0;     // last tick, including the scene update
+            float alpha = 0.0f;          // blend between the snapshot's previous and current tick
+            uint32_t interpolated = 0;   // entities applied by the last interpolate()
+            Scene::Stats scene;          // of the last published tick
+        };
+
+        // onChange runs on the simulation thread after a tick that moved something
+        Simulation(Scene& scene, TickFunction tickFunction = {}, std::function<void()> onChange = {});
+        ~Simulation();
+
+        Simulation(const Simulation&) = delete;
+        Simulation &operator=(const Simulation&) = delete;
+
+        // Publishes the scene's current state and hands the scene over to the simulation thread
+        void start();
+        void stop();
+
+        // Render thread: passes the world matrix, blended for the given time, of every entity that
+        // may differ from what was applied last time. Returns the number of entities applied.
+        uint32_t interpolate(Clock::time_point now, const ApplyFunction& apply);
+
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        struct Change {
+            Scene::Entity entity;
+            uint64_t tick;  // last tick the entity's world matrix changed
+            glm::mat4 previous;
+            glm::mat4 current;
+        };
+
+        struct Snapshot {
+            uint64_t tick = 0;
+            Clock::time_point time;       // when the tick was due
+            std::vector<Change> changes;  // changed after the last tick the render thread acknowledged
+            uint64_t skippedTicks = 0;
+            double tickMicros = 0.0;
+            Scene::Stats scene;
+        };
+
+        void threadLoop();
+        void step(Clock::time_point due);
+
+        Scene& m_scene;
+        TickFunction m_tickFunction;
+        std::function<void()> m_onChange;
+        std::thread m_thread;
+        std::atomic<bool> m_stopping{false};
+
+        // simulation thread
+        uint64_t m_tick = 0;
+        uint64_t m_skippedTicks = 0;
+        std::vector<glm::mat4> m_previous;
+        std::vector<glm::mat4> m_current;
+        std::vector<uint64_t> m_changedTick;
+        std::vector<Scene::Entity> m_moved;      // changed in the last tick
+        std::vector<Scene::Entity> m_unapplied;  // changed after m_acknowledgedTick, each once
+        std::vector<bool> m_isUnapplied;         // by entity
+
+        TripleBuffer<Snapshot> m_snapshots;
+        std::atomic<uint64_t> m_acknowledgedTick{0};  // m_appliedTick as last seen by the simulation thread
+
+        // render thread
+        uint64_t m_appliedTick = 0;  // every change up to this tick has been applied in full
+        Stats m_stats;
+    };
+
+}
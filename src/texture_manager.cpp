@@ -0,0 +1,628 @@
+#include "texture_manager.h"
+#include "block_compression.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+namespace VKEngine {
+
+    namespace {
+
+        uint32_t floatBits(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+            uint32_t levels = 1;
+            for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+                levels++;
+            }
+            return levels;
+        }
+
+        int32_t mipExtent(uint32_t size, uint32_t level) {
+            return static_cast<int32_t>(std::max(1u, size >> level));
+        }
+
+        void transitionLevels(
+            VkCommandBuffer commandBuffer,
+            VkImage image,
+            uint32_t baseLevel,
+            uint32_t levelCount,
+            VkImageLayout oldLayout,
+            VkImageLayout newLayout,
+            VkAccessFlags srcAccess,
+            VkAccessFlags dstAccess,
+            VkPipelineStageFlags srcStage,
+            VkPipelineStageFlags dstStage) {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+            vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        constexpr VkPipelineStageFlags SHADER_STAGES =
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    }
+
+    SamplerCache::~SamplerCache() {
+        for (auto& [key, sampler] : m_samplers) {
+            vkDestroySampler(m_device.device(), sampler, nullptr);
+        }
+    }
+
+    VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& info) {
+        assert(info.pNext == nullptr && "Sampler create info extensions are not part of the cache key.");
+
+        SamplerKey key = makeKey(info);
+        auto it = m_samplers.find(key);
+        if (it != m_samplers.end()) {
+            return it->second;
+        }
+
+        VkSampler sampler;
+        if (vkCreateSampler(m_device.device(), &info, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create sampler!");
+        }
+        m_samplers.emplace(key, sampler);
+        return sampler;
+    }
+
+    VkSampler SamplerCache::getDefaultSampler() {
+        VkSamplerCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.magFilter = VK_FILTER_LINEAR;
+        info.minFilter = VK_FILTER_LINEAR;
+        info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        info.anisotropyEnable = VK_TRUE;
+        info.maxAnisotropy = m_device.capabilities().properties.limits.maxSamplerAnisotropy;
+        info.compareOp = VK_COMPARE_OP_ALWAYS;
+        info.minLod = 0.0f;
+        info.maxLod = VK_LOD_CLAMP_NONE;
+        info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        return getSampler(info);
+    }
+
+    SamplerCache::SamplerKey SamplerCache::makeKey(const VkSamplerCreateInfo& info) {
+        return {
+            info.flags,
+            static_cast<uint32_t>(info.magFilter),
+            static_cast<uint32_t>(info.minFilter),
+            static_cast<uint32_t>(info.mipmapMode),
+            static_cast<uint32_t>(info.addressModeU),
+            static_cast<uint32_t>(info.addressModeV),
+            static_cast<uint32_t>(info.addressModeW),
+            floatBits(info.mipLodBias),
+            info.anisotropyEnable,
+            floatBits(info.maxAnisotropy),
+            info.compareEnable,
+            static_cast<uint32_t>(info.compareOp),
+            floatBits(info.minLod),
+            floatBits(info.maxLod),
+            static_cast<uint32_t>(info.borderColor),
+            info.unnormalizedCoordinates,
+        };
+    }
+
+    size_t SamplerCache::SamplerKeyHash::operator()(const SamplerKey& key) const {
+        size_t hash = 0;
+        for (uint32_t value : key) {
+            hash ^= std::hash<uint32_t>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        }
+        return hash;
+    }
+
+    TextureManager::TextureManager(Device& device, DeletionQueue& deletionQueue, AssetPipeline& assets,
+                                   BindlessDescriptors* bindless, VkDeviceSize budgetBytes)
+        : m_device(device), m_deletionQueue(deletionQueue), m_assets(assets), m_bindless(bindless), m_samplers(device),
+          m_budgetBytes(budgetBytes) {
+        m_stats.budgetBytes = budgetBytes;
+
+        // RGBA8 is always sampleable, so findSupportedFormat settles on one of the two
+        for (VkFormat format : BLOCK_COMPRESSED_FORMATS) {
+            VkFormat supported = m_device.supportsTextureCompressionBC()
+                ? m_device.findSupportedFormat(
+                      {format, decompressedFormat(format)},
+                      VK_IMAGE_TILING_OPTIMAL,
+                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)
+                : decompressedFormat(format);
+            if (supported != format) {
+                m_transcodedFormats.push_back(format);
+            }
+        }
+        if (!m_transcodedFormats.empty()) {
+            LOG_INFO("BC textures: " << m_transcodedFormats.size()
+                     << " formats unsupported, expanding them to RGBA8 on load");
+        }
+    }
+
+    TextureManager::~TextureManager() {
+        // nothing is deferred from here on, the queue may already be gone
+        vkQueueWaitIdle(m_device.graphicsQueue());
+        for (Batch& batch : m_batches) {
+            for (const Replacement& replacement : batch.replacements) {
+                destroyImage(replacement.image, replacement.memory, replacement.view, BindlessDescriptors::INVALID_INDEX);
+            }
+            releaseBatch(batch);
+        }
+        for (Texture& texture : m_textures) {
+            if (texture.image != VK_NULL_HANDLE) {
+                destroyImage(texture.image, texture.memory, texture.view, texture.bindlessIndex);
+            }
+        }
+    }
+
+    TextureManager::Handle TextureManager::load(const std::string& path, bool srgb, bool generateMips, int priority) {
+        Handle handle = static_cast<Handle>(m_textures.size());
+        Texture texture;
+        texture.path = path;
+        texture.srgb = srgb;
+        texture.generateMips = generateMips;
+        texture.priority = priority;
+        texture.sampler = m_samplers.getDefaultSampler();
+        texture.lastUsed = m_frame;
+        m_textures.push_back(std::move(texture));
+
+        requestDecode(handle);
+        return handle;
+    }
+
+    void TextureManager::setPriority(Handle handle, int priority) {
+        Texture& texture = m_textures[handle];
+        texture.priority = priority;
+        if (texture.request != AssetPipeline::INVALID_HANDLE) {
+            m_assets.setPriority(texture.request, priority);
+        }
+    }
+
+    void TextureManager::touch(Handle handle) {
+        Texture& texture = m_textures[handle];
+        texture.lastUsed = m_frame;
+        if (texture.droppedLevels > 0) {
+            texture.wantsFullResolution = true;
+        }
+    }
+
+    TextureManager::State TextureManager::getState(Handle handle) const {
+        return m_textures[handle].state;
+    }
+
+    VkImageView TextureManager::getImageView(Handle handle) const {
+        return m_textures[handle].view;
+    }
+
+    VkSampler TextureManager::getSampler(Handle handle) const {
+        return m_textures[handle].sampler;
+    }
+
+    uint32_t TextureManager::getBindlessIndex(Handle handle) const {
+        return m_textures[handle].bindlessIndex;
+    }
+
+    void TextureManager::requestDecode(Handle handle) {
+        Texture& texture = m_textures[handle];
+        texture.busy = true;
+
+        auto result = std::make_shared<DecodeResult>(DecodeResult{handle, false, {}, {}, false});
+        auto decode = [this, result, path = texture.path, srgb = texture.srgb](std::vector<uint8_t>& bytes, std::string& error) {
+            if (!decodeImage(path, bytes, srgb, result->image, error)) {
+                return false;
+            }
+            if (needsTranscode(result->image.format)) {
+                result->transcoded = true;
+                return decompressImage(result->image, error);
+            }
+            return true;
+        };
+        auto finish = [this, result](bool success, const std::string& error) {
+            result->success = success;
+            result->error = error;
+            m_decoded.push_back(std::move(*result));
+        };
+        texture.request = m_assets.load(texture.path, texture.priority, std::move(decode), std::move(finish));
+    }
+
+    void TextureManager::update() {
+        m_frame++;
+        completeBatches();
+
+        std::vector<DecodeResult> decoded;
+        decoded.swap(m_decoded);
+
+        // every decoded texture shares one staging buffer, levels kept back to back
+        std::vector<VkDeviceSize> stagingOffsets(decoded.size());
+        VkDeviceSize stagingSize = 0;
+        for (size_t i = 0; i < decoded.size(); i++) {
+            DecodeResult& result = decoded[i];
+            Texture& texture = m_textures[result.handle];
+            if (!result.success) {
+                LOG_ERROR("failed to load texture: " << result.error);
+                texture.busy = false;
+                if (texture.image == VK_NULL_HANDLE) {
+                    texture.state = State::Failed;
+                }
+                continue;
+            }
+            if (result.transcoded) {
+                m_transcodedCount++;
+            }
+            stagingSize = (stagingSize + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+            stagingOffsets[i] = stagingSize;
+            stagingSize += result.image.data.size();
+        }
+
+        Batch batch;
+        VkDeviceSize projectedBytes = m_stats.residentBytes;
+
+        if (stagingSize > 0) {
+            m_device.createBuffer(
+                stagingSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                batch.staging,
+                batch.stagingMemory);
+
+            void* mapped;
+            vkMapMemory(m_device.device(), batch.stagingMemory, 0, stagingSize, 0, &mapped);
+            for (size_t i = 0; i < decoded.size(); i++) {
+                if (decoded[i].success) {
+                    const std::vector<uint8_t>& data = decoded[i].image.data;
+                    std::memcpy(static_cast<uint8_t*>(mapped) + stagingOffsets[i], data.data(), data.size());
+                }
+            }
+            vkUnmapMemory(m_device.device(), batch.stagingMemory);
+
+            for (size_t i = 0; i < decoded.size(); i++) {
+                if (decoded[i].success) {
+                    recordUpload(batch, decoded[i].handle, decoded[i].image, stagingOffsets[i]);
+                    projectedBytes += batch.replacements.back().bytes - m_textures[decoded[i].handle].bytes;
+                }
+            }
+        }
+
+        enforceBudget(batch, projectedBytes);
+
+        if (batch.commandBuffer != VK_NULL_HANDLE) {
+            vkEndCommandBuffer(batch.commandBuffer);
+
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create texture upload fence!");
+            }
+
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &batch.commandBuffer;
+            if (vkQueueSubmit(m_device.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit texture upload command buffer!");
+            }
+            m_batches.push_back(std::move(batch));
+        }
+
+        restreamUsedTextures(projectedBytes);
+
+        m_stats.textures = static_cast<uint32_t>(m_textures.size());
+        m_stats.loading = static_cast<uint32_t>(std::count_if(m_textures.begin(), m_textures.end(),
+            [](const Texture& texture) { return texture.state == State::Loading; }));
+        m_stats.uploadsInFlight = static_cast<uint32_t>(m_batches.size());
+        m_stats.transcoded = m_transcodedCount;
+    }
+
+    void TextureManager::completeBatches() {
+        // batches are submitted in order to one queue, so they also complete in order
+        size_t completed = 0;
+        for (Batch& batch : m_batches) {
+            if (vkGetFenceStatus(m_device.device(), batch.fence) != VK_SUCCESS) {
+                break;
+            }
+            for (const Replacement& replacement : batch.replacements) {
+                applyReplacement(replacement);
+            }
+            releaseBatch(batch);
+            completed++;
+        }
+        m_batches.erase(m_batches.begin(), m_batches.begin() + completed);
+    }
+
+    void TextureManager::releaseBatch(Batch& batch) {
+        vkDestroyFence(m_device.device(), batch.fence, nullptr);
+        vkFreeCommandBuffers(m_device.device(), m_device.getCommandPool(), 1, &batch.commandBuffer);
+        if (batch.staging != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device.device(), batch.staging, nullptr);
+            vkFreeMemory(m_device.device(), batch.stagingMemory, nullptr);
+        }
+    }
+
+    void TextureManager::applyReplacement(const Replacement& replacement) {
+        Texture& texture = m_textures[replacement.handle];
+        if (texture.image != VK_NULL_HANDLE) {
+            // frames already submitted may still sample the old image through its old slot
+            m_deletionQueue.push([this, image = texture.image, memory = texture.memory, view = texture.view,
+                                  bindlessIndex = texture.bindlessIndex]() {
+                destroyImage(image, memory, view, bindlessIndex);
+            });
+        }
+
+        m_stats.residentBytes = m_stats.residentBytes - texture.bytes + replacement.bytes;
+
+        texture.image = replacement.image;
+        texture.memory = replacement.memory;
+        texture.view = replacement.view;
+        texture.format = replacement.format;
+        texture.width = replacement.width;
+        texture.height = replacement.height;
+        texture.levelCount = replacement.levelCount;
+        texture.droppedLevels = replacement.droppedLevels;
+        texture.bytes = replacement.bytes;
+        texture.state = State::Ready;
+        texture.busy = false;
+
+        // a fresh slot rather than rewriting the old one, which frames in flight may still read
+        texture.bindlessIndex = m_bindless ? m_bindless->registerTexture(texture.view, texture.sampler)
+                                           : BindlessDescriptors::INVALID_INDEX;
+    }
+
+    void TextureManager::destroyImage(VkImage image, VkDeviceMemory memory, VkImageView view, uint32_t bindlessIndex) {
+        vkDestroyImageView(m_device.device(), view, nullptr);
+        vkDestroyImage(m_device.device(), image, nullptr);
+        vkFreeMemory(m_device.device(), memory, nullptr);
+        if (m_bindless && bindlessIndex != BindlessDescriptors::INVALID_INDEX) {
+            m_bindless->releaseTexture(bindlessIndex);
+        }
+    }
+
+    TextureManager::Replacement TextureManager::createImage(
+        Handle handle, VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t droppedLevels) {
+        Replacement replacement = {};
+        replacement.handle = handle;
+        replacement.format = format;
+        replacement.width = width;
+        replacement.height = height;
+        replacement.levelCount = levelCount;
+        replacement.droppedLevels = droppedLevels;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // transfer source for mip generation and for copying levels out when the top one is dropped
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, replacement.image, replacement.memory);
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_device.device(), replacement.image, &requirements);
+        replacement.bytes = requirements.size;
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = replacement.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+        if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &replacement.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+
+        return replacement;
+    }
+
+    VkCommandBuffer TextureManager::beginBatch(Batch& batch) {
+        if (batch.commandBuffer != VK_NULL_HANDLE) {
+            return batch.commandBuffer;
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_device.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate texture upload command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+        return batch.commandBuffer;
+    }
+
+    bool TextureManager::canGenerateMips(VkFormat format) {
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (m_device.getFormatProperties(format).optimalTilingFeatures & required) == required;
+    }
+
+    bool TextureManager::needsTranscode(VkFormat format) const {
+        return std::find(m_transcodedFormats.begin(), m_transcodedFormats.end(), format) != m_transcodedFormats.end();
+    }
+
+    void TextureManager::recordUpload(Batch& batch, Handle handle, const ImageData& image, VkDeviceSize stagingOffset) {
+        VkCommandBuffer commandBuffer = beginBatch(batch);
+        const Texture& texture = m_textures[handle];
+
+        uint32_t providedLevels = static_cast<uint32_t>(image.levels.size());
+        bool generate = texture.generateMips && providedLevels == 1 && canGenerateMips(image.format);
+        uint32_t levelCount = generate ? mipLevelCount(image.width, image.height) : providedLevels;
+
+        Replacement replacement = createImage(handle, image.format, image.width, image.height, levelCount, 0);
+        VkImage target = replacement.image;
+
+        transitionLevels(commandBuffer, target, 0, levelCount,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        // the whole supplied chain in one copy
+        std::vector<VkBufferImageCopy> regions(providedLevels);
+        for (uint32_t level = 0; level < providedLevels; level++) {
+            VkBufferImageCopy& region = regions[level];
+            region = {};
+            region.bufferOffset = stagingOffset + image.levels[level].offset;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            region.imageExtent = {image.levels[level].width, image.levels[level].height, 1};
+        }
+        vkCmdCopyBufferToImage(commandBuffer, batch.staging, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               providedLevels, regions.data());
+
+        if (generate) {
+            // each level is blitted from the one above it, which is then done and made readable
+            for (uint32_t level = 1; level < levelCount; level++) {
+                transitionLevels(commandBuffer, target, level - 1, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                VkImageBlit blit = {};
+                blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+                blit.srcOffsets[1] = {mipExtent(image.width, level - 1), mipExtent(image.height, level - 1), 1};
+                blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                blit.dstOffsets[1] = {mipExtent(image.width, level), mipExtent(image.height, level), 1};
+                vkCmdBlitImage(commandBuffer,
+                    target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1, &blit, VK_FILTER_LINEAR);
+
+                transitionLevels(commandBuffer, target, level - 1, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+            }
+            transitionLevels(commandBuffer, target, levelCount - 1, 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+        }
+        else {
+            transitionLevels(commandBuffer, target, 0, levelCount,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+        }
+
+        batch.replacements.push_back(replacement);
+    }
+
+    void TextureManager::recordDropLevel(Batch& batch, Handle handle) {
+        VkCommandBuffer commandBuffer = beginBatch(batch);
+        Texture& texture = m_textures[handle];
+        assert(texture.levelCount > 1 && "Cannot drop the only resident mip level.");
+
+        uint32_t levelCount = texture.levelCount - 1;
+        Replacement replacement = createImage(handle, texture.format,
+            mipExtent(texture.width, 1), mipExtent(texture.height, 1), levelCount, texture.droppedLevels + 1);
+
+        transitionLevels(commandBuffer, replacement.image, 0, levelCount,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        // the old image is still sampled by frames submitted before the swap, so it goes back to
+        // shader-read right after the copy
+        transitionLevels(commandBuffer, texture.image, 1, levelCount,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            SHADER_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        std::vector<VkImageCopy> regions(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            VkImageCopy& region = regions[level];
+            region = {};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level + 1, 0, 1};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            region.extent = {static_cast<uint32_t>(mipExtent(replacement.width, level)),
+                             static_cast<uint32_t>(mipExtent(replacement.height, level)), 1};
+        }
+        vkCmdCopyImage(commandBuffer,
+            texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            replacement.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            levelCount, regions.data());
+
+        transitionLevels(commandBuffer, texture.image, 1, levelCount,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+        transitionLevels(commandBuffer, replacement.image, 0, levelCount,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, SHADER_STAGES);
+
+        texture.busy = true;
+        batch.replacements.push_back(replacement);
+        m_stats.evictedLevels++;
+    }
+
+    void TextureManager::enforceBudget(Batch& batch, VkDeviceSize& projectedBytes) {
+        if (projectedBytes <= m_budgetBytes) {
+            return;
+        }
+
+        // textures the last recorded frame did not use, least recently used first
+        std::vector<Handle> candidates;
+        for (Handle handle = 0; handle < m_textures.size(); handle++) {
+            const Texture& texture = m_textures[handle];
+            if (texture.state == State::Ready && !texture.busy && texture.levelCount > 1 &&
+                texture.lastUsed + 1 < m_frame) {
+                candidates.push_back(handle);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](Handle a, Handle b) {
+            return m_textures[a].lastUsed < m_textures[b].lastUsed;
+        });
+
+        // one level per texture per update keeps the copy work spread over frames
+        for (Handle handle : candidates) {
+            if (projectedBytes <= m_budgetBytes) {
+                break;
+            }
+            recordDropLevel(batch, handle);
+            projectedBytes -= m_textures[handle].bytes - batch.replacements.back().bytes;
+        }
+    }
+
+    void TextureManager::restreamUsedTextures(VkDeviceSize projectedBytes) {
+        for (Handle handle = 0; handle < m_textures.size(); handle++) {
+            Texture& texture = m_textures[handle];
+            if (!texture.wantsFullResolution || texture.busy || texture.droppedLevels == 0) {
+                continue;
+            }
+
+            // every dropped level roughly quadruples the footprint
+            VkDeviceSize fullBytes = texture.bytes << (2 * texture.droppedLevels);
+            if (projectedBytes - texture.bytes + fullBytes > m_budgetBytes) {
+                continue;
+            }
+            projectedBytes = projectedBytes - texture.bytes + fullBytes;
+            texture.wantsFullResolution = false;
+            requestDecode(handle);
+        }
+    }
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "vk_device.h"
+#include "descriptors.h"
+#include "deletion_queue.h"
+#include "image_loader.h"
+#include "asset_pipeline.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VKEngine {
+
+    // Deduplicates samplers by their create info. Extension chains are not part of the key, so
+    // create infos passed here must have pNext == nullptr. Samplers live as long as the cache.
+    class SamplerCache {
+    public:
+        explicit SamplerCache(Device& device) : m_device(device) {}
+        ~SamplerCache();
+
+        SamplerCache(const SamplerCache&) = delete;
+        SamplerCache &operator=(const SamplerCache&) = delete;
+
+        VkSampler getSampler(const VkSamplerCreateInfo& info);
+
+        // Trilinear, repeating, anisotropic when the device allows it
+        VkSampler getDefaultSampler();
+
+        size_t size() const { return m_samplers.size(); }
+
+    private:
+        using SamplerKey = std::array<uint32_t, 16>;
+
+        struct SamplerKeyHash {
+            size_t operator()(const SamplerKey& key) const;
+        };
+
+        static SamplerKey makeKey(const VkSamplerCreateInfo& info);
+
+        Device& m_device;
+        std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> m_samplers;
+    };
+
+    // Owns every sampled texture. Files are read and decoded through the AssetPipeline, then all
+    // textures that finished decoding since the last update() are uploaded with a single command buffer whose
+    // completion is polled rather than waited on. Missing mip chains are generated on the GPU.
+    //
+    // Resident memory is kept under a budget by dropping the largest mip level of the textures
+    // that have gone unused the longest; a dropped texture streams back in at full resolution once
+    // it is used again and the budget has room. Both operations replace the texture's image, so
+    // callers must fetch the view or bindless index every frame instead of caching them.
+    //
+    // Block compressed KTX2 files are uploaded as is. Formats the device cannot sample are expanded
+    // to RGBA8 on the decode threads instead, costing memory but keeping the content loadable.
+    class TextureManager {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+        enum class State {
+            Loading,
+            Ready,
+            Failed
+        };
+
+        struct Stats {
+            uint32_t textures = 0;
+            uint32_t loading = 0;
+            uint32_t uploadsInFlight = 0;
+            VkDeviceSize residentBytes = 0;
+            VkDeviceSize budgetBytes = 0;
+            uint64_t evictedLevels = 0;
+            uint32_t transcoded = 0;    // block compressed files expanded for lack of device support
+        };
+
+        // bindless may be null, in which case textures are only reachable through their views.
+        // Replaced images go through the deletion queue, which must be flushed before this is destroyed,
+        // and decodes through the asset pipeline, which must be destroyed before this is.
+        TextureManager(Device& device, DeletionQueue& deletionQueue, AssetPipeline& assets, BindlessDescriptors* bindless,
+                       VkDeviceSize budgetBytes);
+        ~TextureManager();
+
+        TextureManager(const TextureManager&) = delete;
+        TextureManager &operator=(const TextureManager&) = delete;
+
+        // Higher priorities are read from disk first
+        Handle load(const std::string& path, bool srgb = true, bool generateMips = true, int priority = 0);
+        // Reorders the texture's read while it is still queued
+        void setPriority(Handle handle, int priority);
+
+        // Marks the texture as used by the frame being recorded, for LRU eviction and re-streaming
+        void touch(Handle handle);
+
+        // Once per frame, after the frame's fence wait and the asset pipeline's update, before recording
+        void update();
+
+        State getState(Handle handle) const;
+        VkImageView getImageView(Handle handle) const;
+        VkSampler getSampler(Handle handle) const;
+        uint32_t getBindlessIndex(Handle handle) const;
+        const Stats& getStats() const { return m_stats; }
+
+        SamplerCache& samplers() { return m_samplers; }
+
+    private:
+        static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+        struct Texture {
+            std::string path;
+            bool srgb = true;
+            bool generateMips = true;
+            State state = State::Loading;
+            bool busy = true;           // decode or GPU copy in flight
+            bool wantsFullResolution = false;
+            int priority = 0;
+            AssetPipeline::Handle request = AssetPipeline::INVALID_HANDLE;  // latest read of the file
+
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkSampler sampler = VK_NULL_HANDLE;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            uint32_t width = 0;         // of the largest resident level
+            uint32_t height = 0;
+            uint32_t levelCount = 0;    // resident levels
+            uint32_t droppedLevels = 0;
+            VkDeviceSize bytes = 0;
+            uint64_t lastUsed = 0;
+            uint32_t bindlessIndex = BindlessDescriptors::INVALID_INDEX;
+        };
+
+        struct DecodeResult {
+            Handle handle;
+            bool success;
+            ImageData image;
+            std::string error;
+            bool transcoded;
+        };
+
+        // A new image for a texture, swapped in once the command buffer filling it has completed
+        struct Replacement {
+            Handle handle;
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView view;
+            VkFormat format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t levelCount;
+            uint32_t droppedLevels;
+            VkDeviceSize bytes;
+        };
+
+        struct Batch {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            VkBuffer staging = VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+            std::vector<Replacement> replacements;
+        };
+
+        void requestDecode(Handle handle);
+        void completeBatches();
+        void releaseBatch(Batch& batch);
+        void applyReplacement(const Replacement& replacement);
+        void destroyImage(VkImage image, VkDeviceMemory memory, VkImageView view, uint32_t bindlessIndex);
+
+        Replacement createImage(Handle handle, VkFormat format, uint32_t width, uint32_t height,
+                                uint32_t levelCount, uint32_t droppedLevels);
+        VkCommandBuffer beginBatch(Batch& batch);
+        void recordUpload(Batch& batch, Handle handle, const ImageData& image, VkDeviceSize stagingOffset);
+        void recordDropLevel(Batch& batch, Handle handle);
+        void enforceBudget(Batch& batch, VkDeviceSize& projectedBytes);
+        void restreamUsedTextures(VkDeviceSize projectedBytes);
+        bool canGenerateMips(VkFormat format);
+        bool needsTranscode(VkFormat format) const;
+
+        Device& m_device;
+        DeletionQueue& m_deletionQueue;
+        AssetPipeline& m_assets;
+        BindlessDescriptors* m_bindless;
+        SamplerCache m_samplers;
+        VkDeviceSize m_budgetBytes;
+
+        std::vector<VkFormat> m_transcodedFormats;  // fixed after construction, read by decode threads
+        std::vector<Texture> m_textures;
+        std::vector<Batch> m_batches;
+        uint64_t m_frame = 0;
+        Stats m_stats;
+
+        std::vector<DecodeResult> m_decoded;  // filled by the asset pipeline's finish steps
+        uint32_t m_transcodedCount = 0;
+    };
+
+}
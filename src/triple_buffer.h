@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace VKEngine {
+
+    // Single-producer, single-consumer handoff of the latest value. The producer writes into its
+    // back slot and publishes it; the consumer takes the most recently published slot. Neither side
+    // ever waits: the three slots are owned by the producer, the consumer and the handoff point, and
+    // a publish or acquire only swaps the caller's slot with the handoff slot. Values the consumer
+    // never picked up are overwritten.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        TripleBuffer() = default;
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer &operator=(const TripleBuffer&) = delete;
+
+        // Producer side
+        T& back() { return m_slots[m_back]; }
+        void publish() {
+            uint32_t previous = m_ready.exchange(m_back | FRESH, std::memory_order_acq_rel);
+            m_back = previous & INDEX_MASK;
+        }
+
+        // Consumer side. Returns the latest published value, or the one taken last time if nothing
+        // new was published; hasNew tells which.
+        T& acquire(bool* hasNew = nullptr) {
+            bool fresh = (m_ready.load(std::memory_order_relaxed) & FRESH) != 0;
+            if (fresh) {
+                m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+            }
+            if (hasNew != nullptr) {
+                *hasNew = fresh;
+            }
+            return m_slots[m_front];
+        }
+
+    private:
+        static constexpr uint32_t FRESH = 4;
+        static constexpr uint32_t INDEX_MASK = 3;
+
+        std::array<T, 3> m_slots{};
+        uint32_t m_back = 0;                  // producer only
+        alignas(64) std::atomic<uint32_t> m_ready{1};
+        alignas(64) uint32_t m_front = 2;     // consumer only
+    };
+
+}
@@ -1,6 +1,12 @@
 #include "vk_device.h"
+#include "log.h"
 
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cctype>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -13,7 +19,16 @@ namespace VKEngine {
         VkDebugUtilsMessageTypeFlagsEXT messageType,
         const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
         void *pUserData) {
-        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+        // each level is rate limited by the logger, so a message repeated every frame can't flood it
+        if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+            LOG_ERROR("validation layer: " << pCallbackData->pMessage);
+        } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+            LOG_WARN("validation layer: " << pCallbackData->pMessage);
+        } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+            LOG_INFO("validation layer: " << pCallbackData->pMessage);
+        } else {
+            LOG_DEBUG("validation layer: " << pCallbackData->pMessage);
+        }
 
         return VK_FALSE;
     }
@@ -45,26 +60,39 @@ namespace VKEngine {
         }
     }
 
+    bool DeviceCapabilities::hasExtension(const char* name) const {
+        for (const auto &extension : extensions) {
+            if (strcmp(extension.extensionName, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     // class member functions
-    Device::Device(Window &window) : m_window{window} {
+    Device::Device(Window &window, const LaunchProfile& profile) : m_profile{profile}, m_window{window} {
 
 #if defined(__APPLE__)
         m_deviceExtensions.push_back("VK_KHR_portability_subset");
 #endif
 
         createInstance();
+        LOG_INFO("launch profile: " << m_profile.name());
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPool();
+        createPipelineCache();
     }
 
     Device::~Device() {
+        savePipelineCache();
+        vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
         vkDestroyCommandPool(m_device, m_commandPool, nullptr);
         vkDestroyDevice(m_device, nullptr);
 
-        if (enableValidationLayers) {
+        if (m_debugMessenger != VK_NULL_HANDLE) {
             DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, nullptr);
         }
 
@@ -73,8 +101,13 @@ namespace VKEngine {
     }
 
     void Device::createInstance() {
-        if (enableValidationLayers && !checkValidationLayerSupport()) {
-            throw std::runtime_error("validation layers requested, but not available!");
+        if (m_profile.validationLayers && !checkValidationLayerSupport()) {
+            // the layers come with the SDK, so machines without one still get to run
+            LOG_WARN("validation layers requested by the " << m_profile.name()
+                     << " profile, but not available; running without them");
+            std::string preferredDevice = m_profile.preferredDevice;
+            m_profile = LaunchProfile::make(LaunchProfile::Kind::Release);
+            m_profile.preferredDevice = preferredDevice;
         }
 
         VkApplicationInfo appInfo = {};
@@ -83,7 +116,7 @@ namespace VKEngine {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_3;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -98,12 +131,23 @@ namespace VKEngine {
 #endif
 
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
-        if (enableValidationLayers) {
+        VkValidationFeaturesEXT validationFeatures = {};
+        if (m_profile.validationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
             createInfo.ppEnabledLayerNames = m_validationLayers.data();
 
+            // also covers messages from vkCreateInstance and vkDestroyInstance themselves
             populateDebugMessengerCreateInfo(debugCreateInfo);
-            createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT *)&debugCreateInfo;
+            createInfo.pNext = m_profile.debugMessenger ? &debugCreateInfo : nullptr;
+
+            if (!m_profile.validationFeatures.empty()) {
+                validationFeatures.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+                validationFeatures.enabledValidationFeatureCount =
+                    static_cast<uint32_t>(m_profile.validationFeatures.size());
+                validationFeatures.pEnabledValidationFeatures = m_profile.validationFeatures.data();
+                validationFeatures.pNext = createInfo.pNext;
+                createInfo.pNext = &validationFeatures;
+            }
         } else {
             createInfo.enabledLayerCount = 0;
             createInfo.pNext = nullptr;
@@ -122,23 +166,178 @@ namespace VKEngine {
         if (deviceCount == 0) {
             throw std::runtime_error("failed to find GPUs with Vulkan support!");
         }
-        std::cout << "Device count: " << deviceCount << std::endl;
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
+        // the highest score wins, unless a suitable device matches the override
+        int64_t bestScore = -1;
+        bool bestMatchesOverride = false;
         for (const auto &device : devices) {
-            if (isDeviceSuitable(device)) {
+            DeviceCapabilities capabilities = queryCapabilities(device);
+            if (!isDeviceSuitable(device, capabilities)) {
+                LOG_INFO("GPU " << capabilities.properties.deviceName << ": not suitable");
+                continue;
+            }
+            int64_t score = scoreDevice(capabilities);
+            bool matchesOverride = !m_profile.preferredDevice.empty() &&
+                                   matchesDeviceOverride(capabilities, m_profile.preferredDevice);
+            LOG_INFO("GPU " << capabilities.properties.deviceName << ": score " << score
+                     << (matchesOverride ? ", matches override" : ""));
+            bool better = matchesOverride != bestMatchesOverride ? matchesOverride : score > bestScore;
+            if (better) {
                 m_physicalDevice = device;
-                break;
+                m_capabilities = std::move(capabilities);
+                bestScore = score;
+                bestMatchesOverride = matchesOverride;
             }
         }
 
         if (m_physicalDevice == VK_NULL_HANDLE) {
             throw std::runtime_error("failed to find a suitable GPU!");
         }
+        if (!m_profile.preferredDevice.empty() && !bestMatchesOverride) {
+            LOG_WARN("no suitable GPU matches " << m_profile.preferredDevice << ", picking by score");
+        }
+
+        // only the picked device is worth the format queries
+        for (uint32_t format = 0; format < DeviceCapabilities::CORE_FORMAT_COUNT; format++) {
+            vkGetPhysicalDeviceFormatProperties(
+                m_physicalDevice, static_cast<VkFormat>(format), &m_capabilities.formats[format]);
+        }
+        buildMemoryTypeTable();
+
+        LOG_INFO("physical device: " << m_capabilities.properties.deviceName
+                 << " (" << (m_capabilities.deviceLocalBytes >> 20) << " MiB device local)");
+    }
+
+    DeviceCapabilities Device::queryCapabilities(VkPhysicalDevice device) {
+        DeviceCapabilities capabilities;
+        vkGetPhysicalDeviceProperties(device, &capabilities.properties);
+        vkGetPhysicalDeviceFeatures(device, &capabilities.features);
+        vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memory);
+
+        uint32_t apiVersion = capabilities.properties.apiVersion;
+        if (apiVersion >= VK_API_VERSION_1_1) {
+            capabilities.idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+            capabilities.properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties2 = {};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &capabilities.idProperties;
+            if (apiVersion >= VK_API_VERSION_1_2) {
+                capabilities.idProperties.pNext = &capabilities.properties12;
+            }
+            vkGetPhysicalDeviceProperties2(device, &properties2);
+            capabilities.idProperties.pNext = nullptr;
+        }
+        if (apiVersion >= VK_API_VERSION_1_2) {
+            capabilities.features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            capabilities.features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            VkPhysicalDeviceFeatures2 features2 = {};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &capabilities.features12;
+            if (apiVersion >= VK_API_VERSION_1_3) {
+                capabilities.features12.pNext = &capabilities.features13;
+            }
+            vkGetPhysicalDeviceFeatures2(device, &features2);
+            capabilities.features12.pNext = nullptr;
+        }
 
-        vkGetPhysicalDeviceProperties(m_physicalDevice, &m_properties);
-        std::cout << "physical device: " << m_properties.deviceName << std::endl;
+        for (uint32_t i = 0; i < capabilities.memory.memoryHeapCount; i++) {
+            if (capabilities.memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                capabilities.deviceLocalBytes += capabilities.memory.memoryHeaps[i].size;
+            }
+        }
+
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        capabilities.extensions.resize(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, capabilities.extensions.data());
+        return capabilities;
+    }
+
+    int64_t Device::scoreDevice(const DeviceCapabilities& capabilities) {
+        // the type decides: a discrete GPU without the optional features still beats an integrated one
+        // with all of them, and software rasterizers only run when nothing else is there
+        int64_t score = 0;
+        switch (capabilities.properties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                score = 4000000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                score = 3000000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                score = 2000000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                score = 0;
+                break;
+            default:
+                score = 1000000;
+                break;
+        }
+
+        // then each optional feature the renderer has a faster path for
+        const VkPhysicalDeviceVulkan12Features& features12 = capabilities.features12;
+        const VkPhysicalDeviceVulkan13Features& features13 = capabilities.features13;
+        bool optionalFeatures[] = {
+            capabilities.features.multiDrawIndirect == VK_TRUE,
+            capabilities.features.drawIndirectFirstInstance == VK_TRUE,
+            features12.drawIndirectCount == VK_TRUE ||
+                capabilities.hasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME),
+            features12.descriptorIndexing == VK_TRUE && features12.runtimeDescriptorArray == VK_TRUE,
+            features13.dynamicRendering == VK_TRUE && features13.synchronization2 == VK_TRUE,
+            capabilities.features.textureCompressionBC == VK_TRUE,
+            capabilities.properties.limits.timestampComputeAndGraphics == VK_TRUE,
+        };
+        for (bool supported : optionalFeatures) {
+            score += supported ? 100000 : 0;
+        }
+
+        // and the memory to hold the most resident textures, in MiB
+        score += std::min<int64_t>(static_cast<int64_t>(capabilities.deviceLocalBytes >> 20), 99999);
+        return score;
+    }
+
+    bool Device::matchesDeviceOverride(const DeviceCapabilities& capabilities, const std::string& preferredDevice) {
+        auto lower = [](std::string text) {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+            return text;
+        };
+        std::string wanted = lower(preferredDevice);
+        if (lower(capabilities.properties.deviceName).find(wanted) != std::string::npos) {
+            return true;
+        }
+
+        // UUIDs are compared as hex digits, so both plain and dashed spellings work
+        if (capabilities.properties.apiVersion < VK_API_VERSION_1_1) {
+            return false;
+        }
+        std::string wantedDigits;
+        for (char c : wanted) {
+            if (c != '-') {
+                wantedDigits += c;
+            }
+        }
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        std::string uuid;
+        for (uint8_t byte : capabilities.idProperties.deviceUUID) {
+            uuid += HEX_DIGITS[byte >> 4];
+            uuid += HEX_DIGITS[byte & 0xf];
+        }
+        return wantedDigits == uuid;
+    }
+
+    void Device::buildMemoryTypeTable() {
+        for (uint32_t properties = 0; properties < MEMORY_TYPE_TABLE_SIZE; properties++) {
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < m_capabilities.memory.memoryTypeCount; i++) {
+                if ((m_capabilities.memory.memoryTypes[i].propertyFlags & properties) == properties) {
+                    mask |= 1u << i;
+                }
+            }
+            m_memoryTypeMasks[properties] = mask;
+        }
     }
 
     void Device::createLogicalDevice() {
@@ -157,11 +356,87 @@ namespace VKEngine {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        const VkPhysicalDeviceFeatures& supportedFeatures = m_capabilities.features;
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        m_multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+        m_drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        m_textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+        if (m_profile.shaderStoresAndAtomics) {
+            // GPU-assisted validation writes its findings from instrumented shaders; without these it
+            // leaves the affected stages unchecked
+            deviceFeatures.vertexPipelineStoresAndAtomics = supportedFeatures.vertexPipelineStoresAndAtomics;
+            deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+        }
+
+        // drawIndirectCount is core (but optional) in 1.2, otherwise it comes from VK_KHR_draw_indirect_count
+        bool drawIndirectCountCore = false;
+        bool drawIndirectCountExtension = false;
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        if (m_capabilities.properties.apiVersion >= VK_API_VERSION_1_2) {
+            const VkPhysicalDeviceVulkan12Features& supported12 = m_capabilities.features12;
+            vulkan12Features.drawIndirectCount = supported12.drawIndirectCount;
+            drawIndirectCountCore = supported12.drawIndirectCount == VK_TRUE;
+
+            // bindless needs the descriptor indexing subset below; either all of it or none
+            m_descriptorIndexing =
+                supported12.descriptorIndexing == VK_TRUE &&
+                supported12.runtimeDescriptorArray == VK_TRUE &&
+                supported12.descriptorBindingPartiallyBound == VK_TRUE &&
+                supported12.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+                supported12.shaderStorageBufferArrayNonUniformIndexing == VK_TRUE &&
+                supported12.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                supported12.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+                supported12.descriptorBindingUpdateUnusedWhilePending == VK_TRUE;
+            if (m_descriptorIndexing) {
+                vulkan12Features.descriptorIndexing = VK_TRUE;
+                vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+                vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+                vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+                vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+                const VkPhysicalDeviceVulkan12Properties& properties12 = m_capabilities.properties12;
+                m_maxBindlessSampledImages = std::min(
+                    properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                    properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+                m_maxBindlessStorageBuffers = std::min(
+                    properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                    properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+            }
+        }
+        else if (m_capabilities.hasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+            m_deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            drawIndirectCountExtension = true;
+        }
+
+        // dynamic rendering is only used together with synchronization2 for its layout transitions
+        bool dynamicRendering = false;
+        VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (m_capabilities.properties.apiVersion >= VK_API_VERSION_1_3) {
+            const VkPhysicalDeviceVulkan13Features& supported13 = m_capabilities.features13;
+
+            dynamicRendering = supported13.dynamicRendering == VK_TRUE && supported13.synchronization2 == VK_TRUE;
+            if (dynamicRendering) {
+                vulkan13Features.dynamicRendering = VK_TRUE;
+                vulkan13Features.synchronization2 = VK_TRUE;
+                vulkan12Features.pNext = &vulkan13Features;
+            }
+        }
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        if (m_capabilities.properties.apiVersion >= VK_API_VERSION_1_2) {
+            createInfo.pNext = &vulkan12Features;
+        }
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -172,7 +447,7 @@ namespace VKEngine {
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
-        if (enableValidationLayers) {
+        if (m_profile.validationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
             createInfo.ppEnabledLayerNames = m_validationLayers.data();
         } else {
@@ -185,6 +460,58 @@ namespace VKEngine {
 
         vkGetDeviceQueue(m_device, indices.graphicsFamily, 0, &m_graphicsQueue);
         vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+
+        if (drawIndirectCountCore) {
+            m_cmdDrawIndexedIndirectCount =
+                (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCount");
+        }
+        else if (drawIndirectCountExtension) {
+            m_cmdDrawIndexedIndirectCount =
+                (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR");
+        }
+        if (dynamicRendering) {
+            m_cmdBeginRendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(m_device, "vkCmdBeginRendering");
+            m_cmdEndRendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(m_device, "vkCmdEndRendering");
+            m_cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(m_device, "vkCmdPipelineBarrier2");
+        }
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+        m_timestampValidBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+
+        LOG_INFO("draw indirect count: " << (supportsDrawIndirectCount() ? "yes" : "no"));
+        LOG_INFO("descriptor indexing: " << (m_descriptorIndexing ? "yes" : "no"));
+        LOG_INFO("BC texture compression: " << (m_textureCompressionBC ? "yes" : "no"));
+        LOG_INFO("dynamic rendering: " << (supportsDynamicRendering() ? "yes" : "no"));
+        LOG_INFO("timestamps: " << (supportsTimestamps() ? "yes" : "no"));
+    }
+
+    void Device::cmdDrawIndexedIndirectCount(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer countBuffer,
+        VkDeviceSize countBufferOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride) {
+        assert(m_cmdDrawIndexedIndirectCount != nullptr && "vkCmdDrawIndexedIndirectCount is not supported on this device.");
+        m_cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+    }
+
+    void Device::cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo& renderingInfo) {
+        assert(m_cmdBeginRendering != nullptr && "vkCmdBeginRendering is not supported on this device.");
+        m_cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void Device::cmdEndRendering(VkCommandBuffer commandBuffer) {
+        assert(m_cmdEndRendering != nullptr && "vkCmdEndRendering is not supported on this device.");
+        m_cmdEndRendering(commandBuffer);
+    }
+
+    void Device::cmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo& dependencyInfo) {
+        assert(m_cmdPipelineBarrier2 != nullptr && "vkCmdPipelineBarrier2 is not supported on this device.");
+        m_cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
     }
 
     void Device::createCommandPool() {
@@ -201,12 +528,62 @@ namespace VKEngine {
         }
     }
 
+    void Device::createPipelineCache() {
+        std::vector<char> cacheData;
+        std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            cacheData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(cacheData.data(), static_cast<std::streamsize>(cacheData.size()));
+        }
+
+        // drivers reject foreign blobs, but check the header ourselves so a GPU/driver swap starts clean
+        if (cacheData.size() >= sizeof(VkPipelineCacheHeaderVersionOne)) {
+            VkPipelineCacheHeaderVersionOne header;
+            memcpy(&header, cacheData.data(), sizeof(header));
+            if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+                header.vendorID != m_capabilities.properties.vendorID ||
+                header.deviceID != m_capabilities.properties.deviceID ||
+                memcmp(header.pipelineCacheUUID, m_capabilities.properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+                cacheData.clear();
+            }
+        }
+        else {
+            cacheData.clear();
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+        if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    void Device::savePipelineCache() {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+        std::vector<char> cacheData(dataSize);
+        if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::ofstream file(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::trunc);
+        if (file.is_open()) {
+            file.write(cacheData.data(), static_cast<std::streamsize>(dataSize));
+        }
+    }
+
     void Device::createSurface() { m_window.createSurface(m_instance); }
 
-    bool Device::isDeviceSuitable(VkPhysicalDevice device) {
+    bool Device::isDeviceSuitable(VkPhysicalDevice device, const DeviceCapabilities& capabilities) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
+        bool extensionsSupported = checkDeviceExtensionSupport(capabilities);
 
         bool swapChainAdequate = false;
         if (extensionsSupported) {
@@ -214,19 +591,15 @@ namespace VKEngine {
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        VkPhysicalDeviceFeatures supportedFeatures;
-        vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
         return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-               supportedFeatures.samplerAnisotropy;
+               capabilities.features.samplerAnisotropy;
     }
 
     void Device::populateDebugMessengerCreateInfo(
         VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
         createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-                                     VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        createInfo.messageSeverity = m_profile.severities;
         createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
                                  VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
                                  VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
@@ -235,7 +608,7 @@ namespace VKEngine {
     }
 
     void Device::setupDebugMessenger() {
-        if (!enableValidationLayers) return;
+        if (!m_profile.debugMessenger) return;
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
         if (CreateDebugUtilsMessengerEXT(m_instance, &createInfo, nullptr, &m_debugMessenger) != VK_SUCCESS) {
@@ -281,9 +654,12 @@ namespace VKEngine {
         extensions.push_back("VK_KHR_get_physical_device_properties2");
 #endif
 
-        if (enableValidationLayers) {
+        if (m_profile.debugMessenger) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
+        if (!m_profile.validationFeatures.empty()) {
+            extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+        }
 
         return extensions;
     }
@@ -300,6 +676,17 @@ namespace VKEngine {
             std::cout << "\t" << extension.extensionName << std::endl;
             available.insert(extension.extensionName);
         }
+        // validation features are provided by the layer rather than the implementation
+        if (m_profile.validationLayers) {
+            for (const char *layerName : m_validationLayers) {
+                vkEnumerateInstanceExtensionProperties(layerName, &extensionCount, nullptr);
+                extensions.resize(extensionCount);
+                vkEnumerateInstanceExtensionProperties(layerName, &extensionCount, extensions.data());
+                for (uint32_t i = 0; i < extensionCount; i++) {
+                    available.insert(extensions[i].extensionName);
+                }
+            }
+        }
 
         std::cout << "required extensions:" << std::endl;
         auto requiredExtensions = getRequiredExtensions();
@@ -311,20 +698,10 @@ namespace VKEngine {
         }
     }
 
-    bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
-        uint32_t extensionCount;
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-        vkEnumerateDeviceExtensionProperties(
-            device,
-            nullptr,
-            &extensionCount,
-            availableExtensions.data());
-
+    bool Device::checkDeviceExtensionSupport(const DeviceCapabilities& capabilities) {
         std::set<std::string> requiredExtensions(m_deviceExtensions.begin(), m_deviceExtensions.end());
 
-        for (const auto &extension : availableExtensions) {
+        for (const auto &extension : capabilities.extensions) {
             requiredExtensions.erase(extension.extensionName);
         }
 
@@ -388,11 +765,19 @@ namespace VKEngine {
         return details;
     }
 
+    VkFormatProperties Device::getFormatProperties(VkFormat format) const {
+        if (static_cast<uint32_t>(format) < DeviceCapabilities::CORE_FORMAT_COUNT) {
+            return m_capabilities.formats[format];
+        }
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+        return properties;
+    }
+
     VkFormat Device::findSupportedFormat(
         const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
         for (VkFormat format : candidates) {
-            VkFormatProperties props;
-            vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &props);
+            VkFormatProperties props = getFormatProperties(format);
 
             if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
                 return format;
@@ -404,17 +789,26 @@ namespace VKEngine {
         throw std::runtime_error("failed to find supported format!");
     }
 
-    uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if ((typeFilter & (1 << i)) &&
-                (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
-                }
+    uint32_t Device::memoryTypeMask(VkMemoryPropertyFlags properties) const {
+        if (properties < MEMORY_TYPE_TABLE_SIZE) {
+            return m_memoryTypeMasks[properties];
         }
+        // vendor flags past the table
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < m_capabilities.memory.memoryTypeCount; i++) {
+            if ((m_capabilities.memory.memoryTypes[i].propertyFlags & properties) == properties) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
 
-        throw std::runtime_error("failed to find suitable memory type!");
+    uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        uint32_t candidates = typeFilter & memoryTypeMask(properties);
+        if (candidates == 0) {
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+        return static_cast<uint32_t>(std::countr_zero(candidates));
     }
 
     void Device::createBuffer(
@@ -448,6 +842,43 @@ namespace VKEngine {
         vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
     }
 
+    VkMemoryPropertyFlags Device::createBuffer(
+        VkDeviceSize size,
+        VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags preferredProperties,
+        VkMemoryPropertyFlags fallbackProperties,
+        VkBuffer &buffer,
+        VkDeviceMemory &bufferMemory) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+
+        VkMemoryPropertyFlags properties =
+            (memRequirements.memoryTypeBits & memoryTypeMask(preferredProperties)) != 0 ? preferredProperties
+                                                                                      : fallbackProperties;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+        return properties;
+    }
+
     VkCommandBuffer Device::beginSingleTimeCommands() {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -544,4 +975,36 @@ namespace VKEngine {
             throw std::runtime_error("failed to bind image memory!");
         }
     }
+
+    VkMemoryPropertyFlags Device::createImageWithInfo(
+        const VkImageCreateInfo &imageInfo,
+        VkMemoryPropertyFlags preferredProperties,
+        VkMemoryPropertyFlags fallbackProperties,
+        VkImage &image,
+        VkDeviceMemory &imageMemory) {
+        if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+        VkMemoryPropertyFlags properties =
+            (memRequirements.memoryTypeBits & memoryTypeMask(preferredProperties)) != 0 ? preferredProperties
+                                                                                      : fallbackProperties;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image memory!");
+        }
+
+        if (vkBindImageMemory(m_device, image, imageMemory, 0) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind image memory!");
+        }
+        return properties;
+    }
 }
\ No newline at end of file
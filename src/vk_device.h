@@ -1,8 +1,10 @@
 #pragma once
 
+#include "launch_profile.h"
 #include "vk_window.h"
 
 #include <vulkan/vulkan.h>
+#include <array>
 #include <vector>
 #include <string>
 
@@ -24,15 +26,30 @@ namespace VKEngine {
         }
     };
 
+    // What the physical device offers, queried once when it is picked so nothing after device creation
+    // goes back to the driver for it. Vulkan 1.1+ structures stay zeroed on devices that don't support
+    // them, and their pNext pointers are cleared.
+    struct DeviceCapabilities {
+        // the core formats, VK_FORMAT_UNDEFINED up to the ASTC ones, are cached; extension formats aren't
+        static constexpr uint32_t CORE_FORMAT_COUNT = VK_FORMAT_ASTC_12x12_SRGB_BLOCK + 1;
+
+        VkPhysicalDeviceProperties properties = {};
+        VkPhysicalDeviceVulkan12Properties properties12 = {};
+        VkPhysicalDeviceIDProperties idProperties = {};
+        VkPhysicalDeviceFeatures features = {};
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        VkPhysicalDeviceVulkan13Features features13 = {};
+        VkPhysicalDeviceMemoryProperties memory = {};
+        VkDeviceSize deviceLocalBytes = 0;
+        std::vector<VkExtensionProperties> extensions;
+        std::array<VkFormatProperties, CORE_FORMAT_COUNT> formats = {};  // only for the picked device
+
+        bool hasExtension(const char* name) const;
+    };
+
     class Device {
     public:
-//#if !defined(DEBUG)
-//        const bool enableValidationLayers = false;
-//#else
-        const bool enableValidationLayers = true;
-//#endif
-
-        Device(Window& window);
+        Device(Window& window, const LaunchProfile& profile);
         ~Device();
 
         Device(const Device&) = delete;
@@ -46,11 +63,51 @@ namespace VKEngine {
         VkQueue graphicsQueue() { return m_graphicsQueue; }
         VkQueue presentQueue() { return m_presentQueue; }
         VkInstance instance() { return m_instance; }
+        VkPipelineCache pipelineCache() { return m_pipelineCache; }
+        // The profile the device was created with; release if validation was asked for but unavailable
+        const LaunchProfile& profile() const { return m_profile; }
+        const DeviceCapabilities& capabilities() const { return m_capabilities; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_physicalDevice); }
-        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        // The lowest memory type in typeFilter with all of the properties; throws if there is none
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+        // Bit i is set if memory type i has all of the properties
+        uint32_t memoryTypeMask(VkMemoryPropertyFlags properties) const;
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(m_physicalDevice); }
         VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+        VkFormatProperties getFormatProperties(VkFormat format) const;
+
+        // Indirect drawing support, resolved once at logical device creation
+        bool supportsMultiDrawIndirect() const { return m_multiDrawIndirect; }
+        bool supportsDrawIndirectFirstInstance() const { return m_drawIndirectFirstInstance; }
+        bool supportsDrawIndirectCount() const { return m_cmdDrawIndexedIndirectCount != nullptr; }
+        void cmdDrawIndexedIndirectCount(
+            VkCommandBuffer commandBuffer,
+            VkBuffer buffer,
+            VkDeviceSize offset,
+            VkBuffer countBuffer,
+            VkDeviceSize countBufferOffset,
+            uint32_t maxDrawCount,
+            uint32_t stride);
+
+        // Descriptor indexing (Vulkan 1.2) for bindless resources, with the update-after-bind limits
+        bool supportsDescriptorIndexing() const { return m_descriptorIndexing; }
+        uint32_t maxBindlessSampledImages() const { return m_maxBindlessSampledImages; }
+        uint32_t maxBindlessStorageBuffers() const { return m_maxBindlessStorageBuffers; }
+
+        // BC1-BC7 sampling; individual formats still need checking with findSupportedFormat
+        bool supportsTextureCompressionBC() const { return m_textureCompressionBC; }
+
+        // Dynamic rendering with synchronization2 (Vulkan 1.3), rendering without render pass objects
+        bool supportsDynamicRendering() const { return m_cmdBeginRendering != nullptr; }
+        void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo& renderingInfo);
+        void cmdEndRendering(VkCommandBuffer commandBuffer);
+        void cmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo& dependencyInfo);
+
+        // Timestamp queries on the graphics queue; ticks convert to nanoseconds with timestampPeriod()
+        bool supportsTimestamps() const { return m_timestampValidBits != 0; }
+        uint32_t timestampValidBits() const { return m_timestampValidBits; }
+        float timestampPeriod() const { return m_capabilities.properties.limits.timestampPeriod; }
 
         // Buffer Helper Functions
         void createBuffer(
@@ -59,6 +116,14 @@ namespace VKEngine {
             VkMemoryPropertyFlags properties,
             VkBuffer &buffer,
             VkDeviceMemory &bufferMemory);
+        // Like the image variant below: preferred properties if possible, returns the ones used
+        VkMemoryPropertyFlags createBuffer(
+            VkDeviceSize size,
+            VkBufferUsageFlags usage,
+            VkMemoryPropertyFlags preferredProperties,
+            VkMemoryPropertyFlags fallbackProperties,
+            VkBuffer &buffer,
+            VkDeviceMemory &bufferMemory);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -70,8 +135,14 @@ namespace VKEngine {
             VkMemoryPropertyFlags properties,
             VkImage &image,
             VkDeviceMemory &imageMemory);
-
-        VkPhysicalDeviceProperties m_properties;
+        // Allocates from a memory type with the preferred properties if the image allows one, otherwise
+        // from one with the fallback properties; returns the properties that were used
+        VkMemoryPropertyFlags createImageWithInfo(
+            const VkImageCreateInfo &imageInfo,
+            VkMemoryPropertyFlags preferredProperties,
+            VkMemoryPropertyFlags fallbackProperties,
+            VkImage &image,
+            VkDeviceMemory &imageMemory);
 
     private:
         void createInstance();
@@ -80,28 +151,54 @@ namespace VKEngine {
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void createPipelineCache();
+        void savePipelineCache();
 
         // helper functions
-        bool isDeviceSuitable(VkPhysicalDevice device);
+        DeviceCapabilities queryCapabilities(VkPhysicalDevice device);
+        bool isDeviceSuitable(VkPhysicalDevice device, const DeviceCapabilities& capabilities);
+        int64_t scoreDevice(const DeviceCapabilities& capabilities);
+        bool matchesDeviceOverride(const DeviceCapabilities& capabilities, const std::string& preferredDevice);
+        void buildMemoryTypeTable();
         std::vector<const char *> getRequiredExtensions();
         bool checkValidationLayerSupport();
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
-        bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool checkDeviceExtensionSupport(const DeviceCapabilities& capabilities);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance m_instance;
-        VkDebugUtilsMessengerEXT m_debugMessenger;
+        LaunchProfile m_profile;
+        VkDebugUtilsMessengerEXT m_debugMessenger = VK_NULL_HANDLE;
         VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+        DeviceCapabilities m_capabilities;
+        // memory types by requested property flags, for the flags up to VK_MEMORY_PROPERTY_PROTECTED_BIT
+        static constexpr uint32_t MEMORY_TYPE_TABLE_SIZE = VK_MEMORY_PROPERTY_PROTECTED_BIT << 1;
+        std::array<uint32_t, MEMORY_TYPE_TABLE_SIZE> m_memoryTypeMasks = {};
         Window &m_window;
         VkCommandPool m_commandPool;
+        VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
 
         VkDevice m_device;
         VkQueue m_graphicsQueue;
         VkQueue m_presentQueue;
 
+        static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
         std::vector<const char*> m_validationLayers = {"VK_LAYER_KHRONOS_validation"};
         std::vector<const char*> m_deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+        bool m_multiDrawIndirect = false;
+        bool m_drawIndirectFirstInstance = false;
+        PFN_vkCmdDrawIndexedIndirectCount m_cmdDrawIndexedIndirectCount = nullptr;
+        PFN_vkCmdBeginRendering m_cmdBeginRendering = nullptr;
+        PFN_vkCmdEndRendering m_cmdEndRendering = nullptr;
+        PFN_vkCmdPipelineBarrier2 m_cmdPipelineBarrier2 = nullptr;
+        bool m_descriptorIndexing = false;
+        uint32_t m_maxBindlessSampledImages = 0;
+        uint32_t m_maxBindlessStorageBuffers = 0;
+        bool m_textureCompressionBC = false;
+        uint32_t m_timestampValidBits = 0;
     };
 }
\ No newline at end of file
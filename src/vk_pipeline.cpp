@@ -1,35 +1,83 @@
 #include "vk_pipeline.h"
 
+#include <atomic>
 #include <cassert>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
 
 #include "model.h"
 
 namespace VKEngine {
 
+    namespace {
+        struct CachedShaderModule {
+            VkDevice device;
+            VkShaderModule module;
+            uint32_t refCount;
+        };
+
+        // keyed by device handle + SPIR-V path
+        std::mutex s_shaderModuleMutex;
+        std::unordered_map<std::string, CachedShaderModule> s_shaderModules;
+
+        std::string shaderModuleKey(VkDevice device, const std::string& path) {
+            return std::to_string(reinterpret_cast<uintptr_t>(device)) + "|" + path;
+        }
+
+        std::atomic<uint32_t> s_nextSortId{0};
+    }
+
     Pipeline::Pipeline(Device& device,
             const std::string& vertPath,
             const std::string& fragPath,
             const PipelineConfigInfo& configInfo)
           : m_device(device),
-            m_graphicsPipeline(VK_NULL_HANDLE),
+            m_pipeline(VK_NULL_HANDLE),
+            m_bindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS),
             m_vertShaderModule(VK_NULL_HANDLE),
-            m_fragShaderModule(VK_NULL_HANDLE) {
-        createGraphicsPipeline(vertPath, fragPath, configInfo);
+            m_fragShaderModule(VK_NULL_HANDLE),
+            m_compShaderModule(VK_NULL_HANDLE),
+            m_sortId(s_nextSortId++) {
+        // the destructor doesn't run when a constructor throws, so modules acquired so far go back here
+        try {
+            createGraphicsPipeline(vertPath, fragPath, configInfo);
+        }
+        catch (...) {
+            releaseShaderModule(m_vertShaderModule);
+            releaseShaderModule(m_fragShaderModule);
+            throw;
+        }
     }
 
-    Pipeline::~Pipeline() {
-        if (m_graphicsPipeline != VK_NULL_HANDLE) {
-            vkDestroyPipeline(m_device.device(), m_graphicsPipeline, nullptr);
+    Pipeline::Pipeline(Device& device,
+            const std::string& compPath,
+            const ComputePipelineConfigInfo& configInfo)
+          : m_device(device),
+            m_pipeline(VK_NULL_HANDLE),
+            m_bindPoint(VK_PIPELINE_BIND_POINT_COMPUTE),
+            m_vertShaderModule(VK_NULL_HANDLE),
+            m_fragShaderModule(VK_NULL_HANDLE),
+            m_compShaderModule(VK_NULL_HANDLE),
+            m_sortId(s_nextSortId++) {
+        try {
+            createComputePipeline(compPath, configInfo);
         }
-        if (m_vertShaderModule != VK_NULL_HANDLE) {
-            vkDestroyShaderModule(m_device.device(), m_vertShaderModule, nullptr);
+        catch (...) {
+            releaseShaderModule(m_compShaderModule);
+            throw;
         }
-        if (m_fragShaderModule != VK_NULL_HANDLE) {
-            vkDestroyShaderModule(m_device.device(), m_fragShaderModule, nullptr);
+    }
+
+    Pipeline::~Pipeline() {
+        if (m_pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(m_device.device(), m_pipeline, nullptr);
         }
+        releaseShaderModule(m_vertShaderModule);
+        releaseShaderModule(m_fragShaderModule);
+        releaseShaderModule(m_compShaderModule);
     }
 
     std::vector<char> Pipeline::readFile(const std::string& path) {
@@ -53,12 +101,10 @@ namespace VKEngine {
         const PipelineConfigInfo& configInfo) {
 
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline, no pipelineLayout provided in configInfo.");
-        assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline, no renderPass provided in configInfo.");
-        std::vector<char> vertCode = readFile(vertPath);
-        std::vector<char> fragCode = readFile(fragPath);
-
-        createShaderModule(vertCode, m_vertShaderModule);
-        createShaderModule(fragCode, m_fragShaderModule);
+        assert((configInfo.renderPass != VK_NULL_HANDLE || configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+               "Cannot create graphics pipeline, no renderPass or attachment formats provided in configInfo.");
+        m_vertShaderModule = acquireShaderModule(vertPath);
+        m_fragShaderModule = acquireShaderModule(fragPath);
 
         VkPipelineShaderStageCreateInfo shaderStages[2] = {};
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -89,9 +135,14 @@ namespace VKEngine {
         VkPipelineViewportStateCreateInfo viewportInfo = {};
         viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportInfo.viewportCount = 1;
-        viewportInfo.pViewports = &configInfo.viewport;
+        viewportInfo.pViewports = nullptr;
         viewportInfo.scissorCount = 1;
-        viewportInfo.pScissors = &configInfo.scissor;
+        viewportInfo.pScissors = nullptr;
+
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+        dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStates.size());
+        dynamicStateInfo.pDynamicStates = configInfo.dynamicStates.data();
 
         VkGraphicsPipelineCreateInfo pipelineInfo = {};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -104,29 +155,148 @@ namespace VKEngine {
         pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
         pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
         pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-        pipelineInfo.pDynamicState = nullptr;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
 
         pipelineInfo.layout = configInfo.pipelineLayout;
         pipelineInfo.renderPass = configInfo.renderPass;
         pipelineInfo.subpass = configInfo.subpass;
 
+        // without a render pass the pipeline is built against the attachment formats
+        VkPipelineRenderingCreateInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        if (configInfo.renderPass == VK_NULL_HANDLE) {
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachmentFormats = &configInfo.colorAttachmentFormat;
+            renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+            pipelineInfo.pNext = &renderingInfo;
+        }
+
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(m_device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+        if (vkCreateGraphicsPipelines(m_device.device(), m_device.pipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
     }
 
+    void Pipeline::createComputePipeline(const std::string& compPath,
+        const ComputePipelineConfigInfo& configInfo) {
+
+        assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline, no pipelineLayout provided in configInfo.");
+        m_compShaderModule = acquireShaderModule(compPath);
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = m_compShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = configInfo.specializationInfo;
+        pipelineInfo.layout = configInfo.pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(m_device.device(), m_device.pipelineCache(), 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+    }
+
     void Pipeline::bind(VkCommandBuffer commandBuffer) {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, m_bindPoint, m_pipeline);
+    }
+
+    void Pipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+        assert(m_bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE && "Cannot dispatch a graphics pipeline.");
+        vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+    }
+
+    void Pipeline::dispatchForCount(VkCommandBuffer commandBuffer, uint32_t invocationCount, uint32_t workgroupSize) {
+        if (invocationCount == 0) {
+            return;
+        }
+        dispatch(commandBuffer, groupCount(invocationCount, workgroupSize));
+    }
+
+    void Pipeline::consumerStageAndAccess(ComputeConsumer consumer, VkPipelineStageFlags& stage, VkAccessFlags& access) {
+        switch (consumer) {
+            case ComputeConsumer::IndirectArguments:
+                stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+                access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+                break;
+            case ComputeConsumer::VertexInput:
+                stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+                access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+                break;
+            case ComputeConsumer::IndexInput:
+                stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+                access = VK_ACCESS_INDEX_READ_BIT;
+                break;
+            case ComputeConsumer::VertexShader:
+                stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+                access = VK_ACCESS_SHADER_READ_BIT;
+                break;
+            case ComputeConsumer::FragmentShader:
+                stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                access = VK_ACCESS_SHADER_READ_BIT;
+                break;
+            case ComputeConsumer::ComputeShader:
+                stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+                access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                break;
+            case ComputeConsumer::Transfer:
+                stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+                access = VK_ACCESS_TRANSFER_READ_BIT;
+                break;
+        }
     }
 
-    PipelineConfigInfo Pipeline::defaultPipelineConfigInfo(uint32_t width, uint32_t height) {
+    void Pipeline::computeWriteBarrier(VkCommandBuffer commandBuffer, ComputeConsumer consumer) {
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags dstAccess;
+        consumerStageAndAccess(consumer, dstStage, dstAccess);
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            dstStage,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void Pipeline::computeImageWriteBarrier(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        const VkImageSubresourceRange& range,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        ComputeConsumer consumer) {
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags dstAccess;
+        consumerStageAndAccess(consumer, dstStage, dstAccess);
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = range;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            dstStage,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    PipelineConfigInfo Pipeline::defaultPipelineConfigInfo() {
         PipelineConfigInfo configInfo{};
 
-        configInfo.viewport = {};
-        configInfo.scissor = {};
         configInfo.inputAssemblyInfo = {};
         configInfo.rasterizationInfo = {};
         configInfo.multisampleInfo = {};
@@ -145,15 +315,7 @@ namespace VKEngine {
         configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
         configInfo.inputAssemblyInfo.flags = 0;
 
-        configInfo.viewport.x = 0.0f;
-        configInfo.viewport.y = 0.0f;
-        configInfo.viewport.width = (float)width;
-        configInfo.viewport.height = (float)height;
-        configInfo.viewport.minDepth = 0.0f;
-        configInfo.viewport.maxDepth = 1.0f;
-
-        configInfo.scissor.offset = {0, 0};
-        configInfo.scissor.extent = {width, height};
+        configInfo.dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 
         configInfo.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         configInfo.rasterizationInfo.depthClampEnable = VK_FALSE;
@@ -205,7 +367,17 @@ namespace VKEngine {
         return configInfo;
     }
 
-    void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule& shaderModule) {
+    VkShaderModule Pipeline::acquireShaderModule(const std::string& path) {
+        std::lock_guard<std::mutex> lock(s_shaderModuleMutex);
+
+        std::string key = shaderModuleKey(m_device.device(), path);
+        auto it = s_shaderModules.find(key);
+        if (it != s_shaderModules.end()) {
+            it->second.refCount++;
+            return it->second.module;
+        }
+
+        std::vector<char> code = readFile(path);
         VkShaderModuleCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         if (code.empty()) {
@@ -214,8 +386,28 @@ namespace VKEngine {
         createInfo.codeSize = code.size();
         createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
+        VkShaderModule shaderModule;
         if (vkCreateShaderModule(m_device.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("failed to create shader module!");
         }
+        s_shaderModules.emplace(key, CachedShaderModule{m_device.device(), shaderModule, 1});
+        return shaderModule;
+    }
+
+    void Pipeline::releaseShaderModule(VkShaderModule shaderModule) {
+        if (shaderModule == VK_NULL_HANDLE) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(s_shaderModuleMutex);
+
+        for (auto it = s_shaderModules.begin(); it != s_shaderModules.end(); ++it) {
+            if (it->second.module == shaderModule && it->second.device == m_device.device()) {
+                if (--it->second.refCount == 0) {
+                    vkDestroyShaderModule(m_device.device(), shaderModule, nullptr);
+                    s_shaderModules.erase(it);
+                }
+                return;
+            }
+        }
     }
 }
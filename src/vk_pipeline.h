@@ -7,8 +7,8 @@
 namespace VKEngine {
 
     struct PipelineConfigInfo {
-        VkViewport viewport;
-        VkRect2D scissor;
+        // viewport and scissor are dynamic by default, so pipelines survive swapchain resizes
+        std::vector<VkDynamicState> dynamicStates;
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
         VkPipelineRasterizationStateCreateInfo rasterizationInfo;
         VkPipelineMultisampleStateCreateInfo multisampleInfo;
@@ -18,6 +18,25 @@ namespace VKEngine {
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // used instead of renderPass for dynamic rendering
+        VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    };
+
+    struct ComputePipelineConfigInfo {
+        VkPipelineLayout pipelineLayout = nullptr;
+        const VkSpecializationInfo* specializationInfo = nullptr;
+    };
+
+    // Who consumes the results of a compute dispatch; selects the destination stage/access of the barrier
+    enum class ComputeConsumer {
+        IndirectArguments,
+        VertexInput,
+        IndexInput,
+        VertexShader,
+        FragmentShader,
+        ComputeShader,
+        Transfer,
     };
 
     class Pipeline {
@@ -26,6 +45,9 @@ namespace VKEngine {
             const std::string& vertPath,
             const std::string& fragPath,
             const PipelineConfigInfo& configInfo);
+        Pipeline(Device& device,
+            const std::string& compPath,
+            const ComputePipelineConfigInfo& configInfo);
         ~Pipeline();
 
         Pipeline(const Pipeline&) = delete;
@@ -34,22 +56,51 @@ namespace VKEngine {
         Pipeline operator=(Pipeline&&) = delete;
 
         void bind(VkCommandBuffer commandBuffer);
+        VkPipelineBindPoint bindPoint() const { return m_bindPoint; }
+        // Small id in creation order, used to group draws by pipeline
+        uint32_t sortId() const { return m_sortId; }
 
-        static PipelineConfigInfo defaultPipelineConfigInfo(uint32_t width, uint32_t height);
+        // Compute dispatch helpers
+        void dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+        void dispatchForCount(VkCommandBuffer commandBuffer, uint32_t invocationCount, uint32_t workgroupSize);
+        static uint32_t groupCount(uint32_t invocationCount, uint32_t workgroupSize) {
+            return (invocationCount + workgroupSize - 1) / workgroupSize;
+        }
 
-    private:
+        // Make compute shader writes visible to the given consumer
+        static void computeWriteBarrier(VkCommandBuffer commandBuffer, ComputeConsumer consumer);
+        // Storage image written by compute, then sampled (or read as storage) by a later stage
+        static void computeImageWriteBarrier(
+            VkCommandBuffer commandBuffer,
+            VkImage image,
+            const VkImageSubresourceRange& range,
+            VkImageLayout oldLayout,
+            VkImageLayout newLayout,
+            ComputeConsumer consumer);
+
+        static PipelineConfigInfo defaultPipelineConfigInfo();
         static std::vector<char> readFile(const std::string& path);
 
+    private:
         void createGraphicsPipeline(const std::string& vertPath,
             const std::string& fragPath,
             const PipelineConfigInfo& configInfo);
+        void createComputePipeline(const std::string& compPath,
+            const ComputePipelineConfigInfo& configInfo);
+
+        // Shader modules are shared between pipelines built from the same SPIR-V file
+        VkShaderModule acquireShaderModule(const std::string& path);
+        void releaseShaderModule(VkShaderModule shaderModule);
 
-        void createShaderModule(const std::vector<char>& code, VkShaderModule& shaderModule);
+        static void consumerStageAndAccess(ComputeConsumer consumer, VkPipelineStageFlags& stage, VkAccessFlags& access);
 
         Device& m_device;
-        VkPipeline m_graphicsPipeline;
+        VkPipeline m_pipeline;
+        VkPipelineBindPoint m_bindPoint;
         VkShaderModule m_vertShaderModule;
         VkShaderModule m_fragShaderModule;
+        VkShaderModule m_compShaderModule;
+        uint32_t m_sortId;
     };
 
 }
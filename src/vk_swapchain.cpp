@@ -1,37 +1,214 @@
 #include "vk_swapchain.h"
+#include "log.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <iomanip>
 #include <limits>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 
 namespace VKEngine {
-    SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent)
-        : m_device{deviceRef}, m_windowExtent{extent} {
-        init();
-    }
-
-     SwapChain::SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous)
-         : m_device(deviceRef), m_windowExtent(windowExtent), m_oldSwapChain(previous) {
-        init();
-        m_oldSwapChain = nullptr;
+    SwapChain::SwapChain(Device &deviceRef, DeletionQueue &deletionQueue, VkExtent2D extent)
+        : m_device{deviceRef}, m_deletionQueue{deletionQueue},
+          m_dynamicRendering{deviceRef.supportsDynamicRendering()}, m_windowExtent{extent} {
+        createSwapChain(VK_NULL_HANDLE);
+        createImageViews();
+        if (!m_dynamicRendering) {
+            createRenderPass();
+        }
+        createDepthResources();
+        createFramebuffers();
+        createSyncObjects();
+        reportDepthMemory();
     }
 
+    bool SwapChain::recreate(VkExtent2D windowExtent) {
+        // a minimized window reports a zero extent, keep the current swapchain until it comes back
+        VkExtent2D surfaceExtent = m_device.getSwapChainSupport().capabilities.currentExtent;
+        if (m_swapChain != VK_NULL_HANDLE && (surfaceExtent.width == 0 || surfaceExtent.height == 0)) {
+            return false;
+        }
+        m_windowExtent = windowExtent;
 
-    void SwapChain::init() {
-        createSwapChain();
+        // the old handle stays valid until its deleter runs, so the driver can still migrate from it
+        VkSwapchainKHR oldSwapChain = m_swapChain;
+        VkFormat oldFormat = m_swapChainImageFormat;
+        retireSwapChain();
+        createSwapChain(oldSwapChain);
         createImageViews();
-        createRenderPass();
+
+        bool formatChanged = m_swapChainImageFormat != oldFormat;
+        if (formatChanged && !m_dynamicRendering) {
+            VkDevice device = m_device.device();
+            VkRenderPass renderPass = m_renderPass;
+            m_deletionQueue.push([device, renderPass]() {
+                vkDestroyRenderPass(device, renderPass, nullptr);
+            });
+            createRenderPass();
+        }
+
         createDepthResources();
         createFramebuffers();
-        createSyncObjects();
+        createRenderFinishedSemaphores();
+
+        // command buffers are indexed by image, so keep waiting on whichever frame last used that index
+        m_imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        return formatChanged;
+    }
+
+    void SwapChain::retireSwapChain() {
+        // frames already submitted may still render to or present these, so they go through the deletion queue
+        VkDevice device = m_device.device();
+        m_deletionQueue.push([device,
+                              swapChain = m_swapChain,
+                              framebuffers = std::move(m_swapChainFramebuffers),
+                              imageViews = std::move(m_swapChainImageViews),
+                              semaphores = std::move(m_renderFinishedSemaphores)]() {
+            for (VkFramebuffer framebuffer : framebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (VkImageView imageView : imageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            for (VkSemaphore semaphore : semaphores) {
+                vkDestroySemaphore(device, semaphore, nullptr);
+            }
+            if (swapChain != VK_NULL_HANDLE) {
+                vkDestroySwapchainKHR(device, swapChain, nullptr);
+            }
+        });
+
+        m_swapChain = VK_NULL_HANDLE;
+        m_swapChainFramebuffers.clear();
+        m_swapChainImageViews.clear();
+        m_renderFinishedSemaphores.clear();
+        m_swapChainImages.clear();
+    }
+
+    void SwapChain::beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearColorValue &clearColor) {
+        if (!m_dynamicRendering) {
+            std::array<VkClearValue, 2> clearValues = {};
+            clearValues[0].color = clearColor;
+            clearValues[1].depthStencil = {1.0f, 0};
+
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = m_renderPass;
+            renderPassInfo.framebuffer = getFrameBuffer(imageIndex);
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = m_swapChainExtent;
+            renderPassInfo.clearValueCount = (uint32_t)clearValues.size();
+            renderPassInfo.pClearValues = clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            return;
+        }
+
+        // both attachments start out UNDEFINED, their previous contents are never needed
+        std::array<VkImageMemoryBarrier2, 2> barriers = {};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;  // matches the acquire wait stage
+        barriers[0].srcAccessMask = VK_ACCESS_2_NONE;
+        barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = m_swapChainImages[imageIndex];
+        barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        barriers[1].srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        barriers[1].dstAccessMask =
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = m_depthImages[m_currentFrame];
+        barriers[1].subresourceRange = {getDepthAspect(), 0, 1, 0, 1};
+
+        VkDependencyInfo dependencyInfo = {};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = (uint32_t)barriers.size();
+        dependencyInfo.pImageMemoryBarriers = barriers.data();
+        m_device.cmdPipelineBarrier2(commandBuffer, dependencyInfo);
+
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = m_swapChainImageViews[imageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = clearColor;
+
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = m_depthImageViews[m_currentFrame];
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = m_swapChainExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        m_device.cmdBeginRendering(commandBuffer, renderingInfo);
+    }
+
+    VkImageAspectFlags SwapChain::getDepthAspect() {
+        VkFormat depthFormat = findDepthFormat();
+        if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+
+    void SwapChain::endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        if (!m_dynamicRendering) {
+            vkCmdEndRenderPass(commandBuffer);
+            return;
+        }
+
+        m_device.cmdEndRendering(commandBuffer);
+
+        // presentation is ordered by the render-finished semaphore; transfers are only waited for so a
+        // capture copy can chain onto the transition
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_swapChainImages[imageIndex];
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        VkDependencyInfo dependencyInfo = {};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = 1;
+        dependencyInfo.pImageMemoryBarriers = &barrier;
+        m_device.cmdPipelineBarrier2(commandBuffer, dependencyInfo);
     }
 
     SwapChain::~SwapChain() {
-        vkDeviceWaitIdle(m_device.device());
+        // the owner waits for the device before destroying the swapchain; anything replaced earlier was
+        // already handed to the deletion queue
 
         // 1. Destroy framebuffers first — they depend on image views and render pass
         for (auto framebuffer : m_swapChainFramebuffers) {
@@ -116,6 +293,11 @@ namespace VKEngine {
             VK_NULL_HANDLE,
             imageIndex);
 
+        // the image's command buffer is re-recorded before submit, so wait for its last use here
+        if ((result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) && m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+            vkWaitForFences(m_device.device(), 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+        }
+
         return result;
     }
 
@@ -172,9 +354,6 @@ namespace VKEngine {
 
     VkResult SwapChain::submitCommandBuffers(
         const VkCommandBuffer *buffers, uint32_t *imageIndex) {
-        if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(m_device.device(), 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-        }
         m_imagesInFlight[*imageIndex] = m_inFlightFences[m_currentFrame];
 
         VkSubmitInfo submitInfo = {};
@@ -197,7 +376,7 @@ namespace VKEngine {
         vkResetFences(m_device.device(), 1, &m_inFlightFences[m_currentFrame]);
         VkResult submitResult = vkQueueSubmit(m_device.graphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]);
         if (submitResult != VK_SUCCESS) {
-            std::cerr << "vkQueueSubmit failed: " << submitResult << std::endl;
+            LOG_ERROR("vkQueueSubmit failed: " << submitResult);
             return submitResult;
         }
 
@@ -215,7 +394,7 @@ namespace VKEngine {
 
         VkResult presentResult = vkQueuePresentKHR(m_device.presentQueue(), &presentInfo);
         if (presentResult != VK_SUCCESS) {
-            std::cerr << "vkQueuePresentKHR failed: " << presentResult << std::endl;
+            LOG_ERROR("vkQueuePresentKHR failed: " << presentResult);
         }
 
         m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
@@ -286,83 +465,7 @@ namespace VKEngine {
         return result;
     }
 
-    void SwapChain::cleanup() {
-        vkDeviceWaitIdle(m_device.device());
-
-        // 1. Framebuffers first (they depend on image views and render pass)
-        for (auto framebuffer : m_swapChainFramebuffers) {
-            if (framebuffer != VK_NULL_HANDLE) {
-                vkDestroyFramebuffer(m_device.device(), framebuffer, nullptr);
-            }
-        }
-        m_swapChainFramebuffers.clear();
-
-        // 2. Render pass
-        if (m_renderPass != VK_NULL_HANDLE) {
-            vkDestroyRenderPass(m_device.device(), m_renderPass, nullptr);
-            m_renderPass = VK_NULL_HANDLE;
-        }
-
-        // 3. Depth resources (image views, images, memory)
-        for (size_t i = 0; i < m_depthImageViews.size(); i++) {
-            if (m_depthImageViews[i] != VK_NULL_HANDLE) {
-                vkDestroyImageView(m_device.device(), m_depthImageViews[i], nullptr);
-            }
-        }
-        for (size_t i = 0; i < m_depthImages.size(); i++) {
-            if (m_depthImages[i] != VK_NULL_HANDLE) {
-                vkDestroyImage(m_device.device(), m_depthImages[i], nullptr);
-            }
-        }
-        for (size_t i = 0; i < m_depthImageMemorys.size(); i++) {
-            if (m_depthImageMemorys[i] != VK_NULL_HANDLE) {
-                vkFreeMemory(m_device.device(), m_depthImageMemorys[i], nullptr);
-            }
-        }
-        m_depthImageViews.clear();
-        m_depthImages.clear();
-        m_depthImageMemorys.clear();
-
-        // 4. Swapchain image views
-        for (auto imageView : m_swapChainImageViews) {
-            if (imageView != VK_NULL_HANDLE) {
-                vkDestroyImageView(m_device.device(), imageView, nullptr);
-            }
-        }
-        m_swapChainImageViews.clear();
-
-        // 5. Swapchain itself
-        if (m_swapChain != VK_NULL_HANDLE) {
-            vkDestroySwapchainKHR(m_device.device(), m_swapChain, nullptr);
-            m_swapChain = VK_NULL_HANDLE;
-        }
-
-        // 6. Synchronization objects (fences + semaphores)
-        for (auto semaphore : m_imageAvailableSemaphores) {
-            if (semaphore != VK_NULL_HANDLE) {
-                vkDestroySemaphore(m_device.device(), semaphore, nullptr);
-            }
-        }
-        m_imageAvailableSemaphores.clear();
-
-        for (auto semaphore : m_renderFinishedSemaphores) {
-            if (semaphore != VK_NULL_HANDLE) {
-                vkDestroySemaphore(m_device.device(), semaphore, nullptr);
-            }
-        }
-        m_renderFinishedSemaphores.clear();
-
-        for (auto fence : m_inFlightFences) {
-            if (fence != VK_NULL_HANDLE) {
-                vkDestroyFence(m_device.device(), fence, nullptr);
-            }
-        }
-        m_inFlightFences.clear();
-
-        m_imagesInFlight.clear();
-    }
-
-    void SwapChain::createSwapChain() {
+    void SwapChain::createSwapChain(VkSwapchainKHR oldSwapChain) {
         SwapChainSupportDetails swapChainSupport = m_device.getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -385,6 +488,10 @@ namespace VKEngine {
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        VkImageUsageFlags supportedUsage = swapChainSupport.capabilities.supportedUsageFlags;
+        m_transferDst = (supportedUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+        m_transferSrc = (supportedUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        createInfo.imageUsage |= supportedUsage & (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
         QueueFamilyIndices indices = m_device.findPhysicalQueueFamilies();
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -405,11 +512,11 @@ namespace VKEngine {
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = m_oldSwapChain == nullptr ? VK_NULL_HANDLE : m_oldSwapChain->m_swapChain;
+        createInfo.oldSwapchain = oldSwapChain;
 
         auto result = vkCreateSwapchainKHR(m_device.device(), &createInfo, nullptr, &m_swapChain);
         if (result != VK_SUCCESS) {
-            std::cerr << result << std::endl;
+            LOG_ERROR("vkCreateSwapchainKHR failed: " << result);
             throw std::runtime_error("failed to create swap chain!");
         }
 
@@ -481,17 +588,25 @@ namespace VKEngine {
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask =
+        std::array<VkSubpassDependency, 2> dependencies = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].srcStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstSubpass = 0;
-        dependency.dstStageMask =
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].dstStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask =
+        dependencies[0].dstAccessMask =
             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+        // the final layout transition happens before transfers, so a capture copy can chain onto it
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
         std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -499,8 +614,8 @@ namespace VKEngine {
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
@@ -508,9 +623,15 @@ namespace VKEngine {
     }
 
     void SwapChain::createFramebuffers() {
-        m_swapChainFramebuffers.resize(imageCount());
-        for (size_t i = 0; i < imageCount(); i++) {
-            std::array<VkImageView, 2> attachments = {m_swapChainImageViews[i], m_depthImageViews[i]};
+        if (m_dynamicRendering) {
+            return;
+        }
+
+        // one per (image, frame in flight) pair, since depth follows the frame rather than the image
+        m_swapChainFramebuffers.resize(imageCount() * MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < m_swapChainFramebuffers.size(); i++) {
+            std::array<VkImageView, 2> attachments = {
+                m_swapChainImageViews[i / MAX_FRAMES_IN_FLIGHT], m_depthImageViews[i % MAX_FRAMES_IN_FLIGHT]};
 
             VkExtent2D swapChainExtent = getSwapChainExtent();
             VkFramebufferCreateInfo framebufferInfo = {};
@@ -536,32 +657,54 @@ namespace VKEngine {
         VkFormat depthFormat = findDepthFormat();
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
-        m_depthImages.resize(imageCount());
-        m_depthImageMemorys.resize(imageCount());
-        m_depthImageViews.resize(imageCount());
+        // depth images larger than the framebuffer are fine, so they are only reallocated when the
+        // swapchain outgrows them
+        if (swapChainExtent.width > m_depthExtent.width || swapChainExtent.height > m_depthExtent.height) {
+            retireDepthResources();
+            auto roundUp = [](uint32_t value) {
+                return (value + DEPTH_EXTENT_GRANULARITY - 1) / DEPTH_EXTENT_GRANULARITY * DEPTH_EXTENT_GRANULARITY;
+            };
+            m_depthExtent.width = roundUp(std::max(swapChainExtent.width, m_depthExtent.width));
+            m_depthExtent.height = roundUp(std::max(swapChainExtent.height, m_depthExtent.height));
+        }
+
+        // depth is cleared on load and never stored, so only frames in flight need their own image
+        if (!m_depthImages.empty()) {
+            return;
+        }
+        m_depthImages.resize(MAX_FRAMES_IN_FLIGHT);
+        m_depthImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+        m_depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
 
-        for (int i = 0; i < m_depthImages.size(); i++) {
+        for (size_t i = 0; i < m_depthImages.size(); i++) {
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
             imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = swapChainExtent.width;
-            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.width = m_depthExtent.width;
+            imageInfo.extent.height = m_depthExtent.height;
             imageInfo.extent.depth = 1;
             imageInfo.mipLevels = 1;
             imageInfo.arrayLayers = 1;
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
-            m_device.createImageWithInfo(
+            // tile-based GPUs keep transient depth in on-chip memory and never back it with VRAM
+            VkMemoryPropertyFlags properties = m_device.createImageWithInfo(
                 imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 m_depthImages[i],
                 m_depthImageMemorys[i]);
+            m_depthLazilyAllocated = (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(m_device.device(), m_depthImages[i], &memRequirements);
+            m_depthImageBytes = memRequirements.size;
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -580,11 +723,43 @@ namespace VKEngine {
         }
     }
 
+    void SwapChain::retireDepthResources() {
+        VkDevice device = m_device.device();
+        m_deletionQueue.push([device,
+                              images = std::move(m_depthImages),
+                              memorys = std::move(m_depthImageMemorys),
+                              views = std::move(m_depthImageViews)]() {
+            for (size_t i = 0; i < images.size(); i++) {
+                vkDestroyImageView(device, views[i], nullptr);
+                vkDestroyImage(device, images[i], nullptr);
+                vkFreeMemory(device, memorys[i], nullptr);
+            }
+        });
+        m_depthImages.clear();
+        m_depthImageMemorys.clear();
+        m_depthImageViews.clear();
+    }
+
+    void SwapChain::reportDepthMemory() {
+        // scale the measured allocation to a 4K target, against the previous one-depth-per-image layout
+        double bytesPerPixel = static_cast<double>(m_depthImageBytes) / (m_depthExtent.width * m_depthExtent.height);
+        double mibAt4K = bytesPerPixel * 3840.0 * 2160.0 / (1024.0 * 1024.0);
+        size_t imagesSaved = imageCount() > MAX_FRAMES_IN_FLIGHT ? imageCount() - MAX_FRAMES_IN_FLIGHT : 0;
+
+        LOG_INFO("Depth: " << MAX_FRAMES_IN_FLIGHT << " transient images for " << imageCount()
+                 << " swapchain images, " << (m_depthLazilyAllocated ? "lazily allocated" : "device local"));
+        std::ostringstream saved;
+        saved << std::fixed << std::setprecision(1)
+              << "Depth VRAM saved at 4K: " << imagesSaved * mibAt4K << " MiB from per-frame depth";
+        if (m_depthLazilyAllocated) {
+            saved << ", up to " << MAX_FRAMES_IN_FLIGHT * mibAt4K << " MiB more from lazy allocation";
+        }
+        LOG_INFO(saved.str());
+    }
+
     void SwapChain::createSyncObjects() {
         // image-available semaphores: per-frame (MAX_FRAMES_IN_FLIGHT)
         m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        // render-finished semaphores: one per swapchain image (to avoid semaphore reuse while image is in-flight)
-        m_renderFinishedSemaphores.resize(imageCount());
         // in-flight fences: per-frame
         m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
         // track which fence is using which image
@@ -606,7 +781,17 @@ namespace VKEngine {
                 }
         }
 
-        // create one render-finished semaphore per swapchain image
+        createRenderFinishedSemaphores();
+    }
+
+    void SwapChain::createRenderFinishedSemaphores() {
+        // the presentation engine may still wait on the previous swapchain's semaphores, so every
+        // swapchain gets its own set
+        m_renderFinishedSemaphores.resize(imageCount());
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
         for (size_t i = 0; i < imageCount(); i++) {
             if (vkCreateSemaphore(m_device.device(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) !=
                 VK_SUCCESS) {
@@ -631,19 +816,19 @@ namespace VKEngine {
         const std::vector<VkPresentModeKHR> &availablePresentModes) {
         for (const auto &availablePresentMode : availablePresentModes) {
             if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                std::cout << "Present mode: Mailbox" << std::endl;
+                LOG_INFO("Present mode: Mailbox");
                 return availablePresentMode;
             }
         }
 
         // for (const auto &availablePresentMode : availablePresentModes) {
         //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
+        //     LOG_INFO("Present mode: Immediate");
         //     return availablePresentMode;
         //   }
         // }
 
-        std::cout << "Present mode: V-Sync" << std::endl;
+        LOG_INFO("Present mode: V-Sync");
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -1,9 +1,7 @@
 #pragma once
 
-#include <memory>
-
-
 #include "vk_device.h"
+#include "deletion_queue.h"
 
 #include <vulkan/vulkan.h>
 #include <string>
@@ -14,18 +12,31 @@ namespace VKEngine {
     public:
         static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-        SwapChain(Device &deviceRef, VkExtent2D windowExtent);
-        SwapChain(Device &deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+        // Depth capacity is rounded up to this many pixels so window drags rarely reallocate it
+        static constexpr uint32_t DEPTH_EXTENT_GRANULARITY = 128;
+
+        SwapChain(Device &deviceRef, DeletionQueue &deletionQueue, VkExtent2D windowExtent);
 
         ~SwapChain();
 
         SwapChain(const SwapChain &) = delete;
         void operator=(const SwapChain &) = delete;
 
-        VkFramebuffer getFrameBuffer(int index) { return m_swapChainFramebuffers[index]; }
+        // Framebuffer pairing the image with the current frame's depth attachment
+        VkFramebuffer getFrameBuffer(int imageIndex) {
+            return m_swapChainFramebuffers[imageIndex * MAX_FRAMES_IN_FLIGHT + m_currentFrame];
+        }
         VkRenderPass getRenderPass() { return m_renderPass; }
         VkImageView getImageView(int index) { return m_swapChainImageViews[index]; }
+        VkImage getImage(int index) { return m_swapChainImages[index]; }
+        VkImage getDepthImage(size_t frameIndex) { return m_depthImages[frameIndex]; }
+        VkImageView getDepthImageView(size_t frameIndex) { return m_depthImageViews[frameIndex]; }
+        VkImageAspectFlags getDepthAspect();
+        // Images can be blitted to, e.g. to upscale an offscreen target, or copied from for capture
+        bool supportsTransferDst() const { return m_transferDst; }
+        bool supportsTransferSrc() const { return m_transferSrc; }
         size_t imageCount() { return m_swapChainImages.size(); }
+        size_t currentFrame() const { return m_currentFrame; }
         VkFormat getSwapChainImageFormat() { return m_swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return m_swapChainExtent; }
         uint32_t width() { return m_swapChainExtent.width; }
@@ -44,16 +55,29 @@ namespace VKEngine {
         VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex,
                                       VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence inFlightFence);
 
-        void cleanup();
+        // Begins rendering to the image with the current frame's depth attachment, through the render
+        // pass or, where supported, dynamic rendering with synchronization2 layout transitions
+        bool usesDynamicRendering() const { return m_dynamicRendering; }
+        void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearColorValue &clearColor);
+        void endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+        // Replaces the swapchain in place. Frames still presenting from the old one retire through the
+        // deletion queue; the render pass, depth images and per-frame sync objects are kept when they
+        // still fit. Returns true if the image format changed and pipelines must be rebuilt.
+        bool recreate(VkExtent2D windowExtent);
+        // Hands the swapchain and its per-image resources to the deletion queue, e.g. before the surface is replaced
+        void retireSwapChain();
 
     private:
-        void init();
-        void createSwapChain();
+        void createSwapChain(VkSwapchainKHR oldSwapChain);
         void createImageViews();
         void createDepthResources();
+        void retireDepthResources();
+        void reportDepthMemory();
         void createRenderPass();
         void createFramebuffers();
         void createSyncObjects();
+        void createRenderFinishedSemaphores();
 
         // Helper functions
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -62,23 +86,29 @@ namespace VKEngine {
             const std::vector<VkPresentModeKHR> &availablePresentModes);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
-        VkFormat m_swapChainImageFormat;
+        VkFormat m_swapChainImageFormat = VK_FORMAT_UNDEFINED;
         VkExtent2D m_swapChainExtent;
 
         std::vector<VkFramebuffer> m_swapChainFramebuffers;
-        VkRenderPass m_renderPass;
+        VkRenderPass m_renderPass = VK_NULL_HANDLE;
 
         std::vector<VkImage> m_depthImages;
         std::vector<VkDeviceMemory> m_depthImageMemorys;
         std::vector<VkImageView> m_depthImageViews;
+        VkExtent2D m_depthExtent = {0, 0};  // allocated size, may exceed the swapchain extent
+        VkDeviceSize m_depthImageBytes = 0;
+        bool m_depthLazilyAllocated = false;
         std::vector<VkImage> m_swapChainImages;
         std::vector<VkImageView> m_swapChainImageViews;
 
         Device &m_device;
+        DeletionQueue &m_deletionQueue;
+        bool m_dynamicRendering;  // no render pass or framebuffers are created
+        bool m_transferDst = false;
+        bool m_transferSrc = false;
         VkExtent2D m_windowExtent;
 
-        VkSwapchainKHR m_swapChain;
-        std::shared_ptr<SwapChain> m_oldSwapChain;
+        VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 
         std::vector<VkSemaphore> m_imageAvailableSemaphores;
         std::vector<VkSemaphore> m_renderFinishedSemaphores;
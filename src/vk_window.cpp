@@ -35,6 +35,12 @@ namespace VKEngine {
         createSurface(instance);
     }
 
+    bool Window::consumeEvents() {
+        bool pending = m_eventsPending;
+        m_eventsPending = false;
+        return pending;
+    }
+
     GLFWwindow* Window::getWindowHandle() const {
         return m_windowHandle;
     }
@@ -44,6 +50,18 @@ namespace VKEngine {
         window->m_framebufferResized = true;
         window->m_width = width;
         window->m_height = height;
+        window->m_eventsPending = true;
+    }
+
+    void Window::focusCallback(GLFWwindow* window_handle, int focused) {
+        auto window = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window_handle));
+        window->m_focused = focused == GLFW_TRUE;
+        window->m_eventsPending = true;
+    }
+
+    void Window::markEvent(GLFWwindow* window_handle) {
+        auto window = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window_handle));
+        window->m_eventsPending = true;
     }
 
     void Window::initWindow() {
@@ -54,6 +72,16 @@ namespace VKEngine {
         m_windowHandle = glfwCreateWindow(m_width, m_height, m_windowName.c_str(), nullptr, nullptr);
         glfwSetWindowUserPointer(m_windowHandle, this);
         glfwSetFramebufferSizeCallback(m_windowHandle, framebufferResizeCallback);
+        glfwSetWindowFocusCallback(m_windowHandle, focusCallback);
+        // only recorded, so an on-demand frame loop knows the window may need a new frame
+        glfwSetWindowRefreshCallback(m_windowHandle, markEvent);
+        glfwSetKeyCallback(m_windowHandle, [](GLFWwindow* w, int, int, int, int) { markEvent(w); });
+        glfwSetMouseButtonCallback(m_windowHandle, [](GLFWwindow* w, int, int, int) { markEvent(w); });
+        glfwSetCursorPosCallback(m_windowHandle, [](GLFWwindow* w, double, double) { markEvent(w); });
+        glfwSetScrollCallback(m_windowHandle, [](GLFWwindow* w, double, double) { markEvent(w); });
+        m_focused = glfwGetWindowAttrib(m_windowHandle, GLFW_FOCUSED) == GLFW_TRUE;
+        // the framebuffer can differ from the requested window size on high-DPI displays
+        glfwGetFramebufferSize(m_windowHandle, &m_width, &m_height);
     }
 }
 
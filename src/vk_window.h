@@ -25,14 +25,23 @@ namespace VKEngine {
 
         GLFWwindow* getWindowHandle() const;
         VkExtent2D getExtent() { return { (uint32_t)m_width, (uint32_t)m_height }; }
+        bool isMinimized() const { return m_width == 0 || m_height == 0; }
+        bool isFocused() const { return m_focused; }
+
+        // Whether input, focus, resize or a repaint request arrived since the last call
+        bool consumeEvents();
 
     private:
         static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+        static void focusCallback(GLFWwindow* window, int focused);
+        static void markEvent(GLFWwindow* window);
         void initWindow();
 
         int m_width;
         int m_height;
         bool m_framebufferResized = false;
+        bool m_focused = true;
+        bool m_eventsPending = false;
 
         std::string m_windowName;
         GLFWwindow* m_windowHandle;
@@ -0,0 +1,159 @@
+#include "render_graph.h"
+#include "test_check.h"
+
+#include <vector>
+
+// Transients placed in the same memory inherit whatever the previous user wrote there. The first
+// use of each has to wait for those writes and make them available, or the aliased resource's
+// layout transition and writes race the old ones.
+
+using namespace VKEngine;
+
+namespace {
+
+    using Access = RenderGraph::Access;
+
+    struct Graph {
+        std::vector<RenderGraph::ResourceNode> resources;
+        std::vector<RenderGraph::PassNode> passes;
+        std::vector<int32_t> transientIndex;
+        std::vector<RenderGraph::TransientResource> transients;
+
+        RenderGraph::Resource addImage(VkImageAspectFlags aspect) {
+            RenderGraph::ResourceNode node;
+            node.isImage = true;
+            node.aspect = aspect;
+            resources.push_back(node);
+            transientIndex.push_back(-1);
+            return static_cast<RenderGraph::Resource>(resources.size() - 1);
+        }
+
+        RenderGraph::Resource addBuffer() {
+            resources.push_back({});
+            transientIndex.push_back(-1);
+            return static_cast<RenderGraph::Resource>(resources.size() - 1);
+        }
+
+        void place(RenderGraph::Resource resource, VkDeviceSize offset, VkDeviceSize size) {
+            RenderGraph::TransientResource transient;
+            transient.resource = resource;
+            transient.offset = offset;
+            transient.requirements.size = size;
+            transientIndex[resource] = static_cast<int32_t>(transients.size());
+            transients.push_back(transient);
+        }
+
+        void addPass(std::vector<RenderGraph::AccessEntry> accesses) {
+            RenderGraph::PassNode pass;
+            pass.accesses = std::move(accesses);
+            passes.push_back(std::move(pass));
+        }
+
+        RenderGraph::BarrierPlan plan() {
+            return RenderGraph::planBarriers(resources, passes, std::vector<bool>(passes.size(), false), transientIndex,
+                                             transients);
+        }
+    };
+
+    const RenderGraph::ImageTransition* findTransition(const RenderGraph::BarrierBatch& batch,
+                                                       RenderGraph::Resource resource) {
+        for (const RenderGraph::ImageTransition& transition : batch.images) {
+            if (transition.resource == resource) {
+                return &transition;
+            }
+        }
+        return nullptr;
+    }
+
+    // depth prepass, a pass sampling the depth, then a colour target in the same memory and a pass sampling that
+    Graph depthThenColor(VkDeviceSize colorOffset) {
+        Graph graph;
+        RenderGraph::Resource depth = graph.addImage(VK_IMAGE_ASPECT_DEPTH_BIT);
+        RenderGraph::Resource color = graph.addImage(VK_IMAGE_ASPECT_COLOR_BIT);
+        RenderGraph::Resource output = graph.addImage(VK_IMAGE_ASPECT_COLOR_BIT);
+        graph.resources[output].imported = true;
+        graph.place(depth, 0, 4096);
+        graph.place(color, colorOffset, 2048);
+
+        graph.addPass({{depth, Access::DepthAttachmentWrite, true}});
+        graph.addPass({{depth, Access::FragmentSampled, false}, {output, Access::ColorAttachmentWrite, true}});
+        graph.addPass({{color, Access::ColorAttachmentWrite, true}});
+        graph.addPass({{color, Access::FragmentSampled, false}, {output, Access::ColorAttachmentWrite, true}});
+        return graph;
+    }
+
+    void testAliasedColorWaitsForDepthWrites() {
+        Graph graph = depthThenColor(0);
+        RenderGraph::BarrierPlan plan = graph.plan();
+
+        const RenderGraph::BarrierBatch& batch = plan.passBarriers[2];
+        const RenderGraph::ImageTransition* transition = findTransition(batch, 1);
+        CHECK(transition != nullptr);
+        if (transition != nullptr) {
+            CHECK(transition->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+            CHECK(transition->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            CHECK((transition->srcAccess & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) != 0);
+            CHECK((transition->srcAccess & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT) != 0);  // its own, last frame
+        }
+        // the access mask is only valid with the stages that wrote it
+        CHECK((batch.srcStages & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0);
+        CHECK((batch.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) != 0);
+    }
+
+    void testAliasedDepthWaitsForColorWrites() {
+        // the depth prepass reuses the memory the colour target wrote in the previous frame
+        Graph graph = depthThenColor(0);
+        RenderGraph::BarrierPlan plan = graph.plan();
+
+        const RenderGraph::BarrierBatch& batch = plan.passBarriers[0];
+        const RenderGraph::ImageTransition* transition = findTransition(batch, 0);
+        CHECK(transition != nullptr);
+        if (transition != nullptr) {
+            CHECK(transition->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+            CHECK((transition->srcAccess & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT) != 0);
+        }
+        CHECK((batch.srcStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) != 0);
+    }
+
+    void testSeparateMemoryDoesNotWait() {
+        Graph graph = depthThenColor(8192);
+        RenderGraph::BarrierPlan plan = graph.plan();
+
+        const RenderGraph::ImageTransition* transition = findTransition(plan.passBarriers[2], 1);
+        CHECK(transition != nullptr);
+        if (transition != nullptr) {
+            CHECK((transition->srcAccess & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) == 0);
+        }
+        CHECK((plan.passBarriers[2].srcStages & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) == 0);
+    }
+
+    void testAliasedBufferGetsMemoryBarrier() {
+        Graph graph;
+        RenderGraph::Resource first = graph.addBuffer();
+        RenderGraph::Resource second = graph.addBuffer();
+        RenderGraph::Resource output = graph.addBuffer();
+        graph.resources[output].imported = true;
+        graph.place(first, 0, 1024);
+        graph.place(second, 0, 1024);
+
+        graph.addPass({{first, Access::ComputeStorageWrite, true}});
+        graph.addPass({{first, Access::ComputeStorageRead, false}, {output, Access::ComputeStorageWrite, true}});
+        graph.addPass({{second, Access::TransferWrite, true}});
+        RenderGraph::BarrierPlan plan = graph.plan();
+
+        const RenderGraph::BarrierBatch& batch = plan.passBarriers[2];
+        CHECK((batch.memorySrcAccess & VK_ACCESS_SHADER_WRITE_BIT) != 0);
+        CHECK((batch.memoryDstAccess & VK_ACCESS_TRANSFER_WRITE_BIT) != 0);
+        CHECK((batch.srcStages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) != 0);
+        CHECK((batch.dstStages & VK_PIPELINE_STAGE_TRANSFER_BIT) != 0);
+    }
+
+}
+
+int main() {
+    testAliasedColorWaitsForDepthWrites();
+    testAliasedDepthWaitsForColorWrites();
+    testSeparateMemoryDoesNotWait();
+    testAliasedBufferGetsMemoryBarrier();
+    return testResult("render graph tests");
+}
@@ -0,0 +1,106 @@
+#include "render_queue.h"
+#include "test_check.h"
+
+#include <vector>
+
+// Sorting draws submitted in an interleaved order has to group them by pipeline, then material,
+// so recording them binds each pipeline once and switches meshes far less often.
+
+using namespace VKEngine;
+
+namespace {
+
+    constexpr uint32_t PIPELINE_SHIFT = RenderQueue::MATERIAL_BITS + RenderQueue::DEPTH_BITS + RenderQueue::MESH_BITS;
+    constexpr uint64_t MESH_MASK = (1u << RenderQueue::MESH_BITS) - 1;
+
+    uint32_t pipelineOf(uint64_t key) {
+        return static_cast<uint32_t>(key >> PIPELINE_SHIFT) & ((1u << RenderQueue::PIPELINE_BITS) - 1);
+    }
+
+    struct BindCounts {
+        uint32_t pipelineBinds = 0;
+        uint32_t meshChanges = 0;
+    };
+
+    // what RenderQueue::record would bind when drawing the keys in this order
+    BindCounts countBinds(const std::vector<RenderQueue::SortEntry>& entries) {
+        BindCounts counts;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (i == 0 || pipelineOf(entries[i].key) != pipelineOf(entries[i - 1].key)) {
+                counts.pipelineBinds++;
+            }
+            if (i == 0 || (entries[i].key & MESH_MASK) != (entries[i - 1].key & MESH_MASK)) {
+                counts.meshChanges++;
+            }
+        }
+        return counts;
+    }
+
+    void testSortGroupsState() {
+        constexpr uint32_t PIPELINES = 3;
+        constexpr uint32_t MESHES = 4;
+        constexpr uint32_t COPIES = 50;
+
+        // round-robin over pipelines and meshes, the worst order for binding
+        std::vector<RenderQueue::SortEntry> entries;
+        for (uint32_t copy = 0; copy < COPIES; copy++) {
+            for (uint32_t mesh = 0; mesh < MESHES; mesh++) {
+                for (uint32_t pipeline = 0; pipeline < PIPELINES; pipeline++) {
+                    uint64_t key = RenderQueue::makeKey(0, pipeline, 0, 0.5f, mesh << RenderQueue::LOD_BITS);
+                    entries.push_back({key, static_cast<uint32_t>(entries.size())});
+                }
+            }
+        }
+        BindCounts unsorted = countBinds(entries);
+
+        std::vector<RenderQueue::SortEntry> scratch;
+        RenderQueue::radixSort(entries, scratch);
+        BindCounts sorted = countBinds(entries);
+
+        for (size_t i = 1; i < entries.size(); i++) {
+            CHECK(entries[i - 1].key <= entries[i].key);
+        }
+        CHECK(unsorted.pipelineBinds == PIPELINES * MESHES * COPIES);
+        CHECK(sorted.pipelineBinds == PIPELINES);
+        CHECK(sorted.meshChanges == PIPELINES * MESHES);
+        CHECK(sorted.meshChanges < unsorted.meshChanges);
+    }
+
+    void testDepthOrdersWithinState() {
+        // same pipeline and material: nearer draws come first
+        uint64_t nearKey = RenderQueue::makeKey(0, 1, 2, 0.1f, 7);
+        uint64_t farKey = RenderQueue::makeKey(0, 1, 2, 0.9f, 3);
+        CHECK(nearKey < farKey);
+
+        // state outranks depth
+        uint64_t farFirstPipeline = RenderQueue::makeKey(0, 0, 5, 1.0f, 0);
+        uint64_t nearSecondPipeline = RenderQueue::makeKey(0, 1, 0, 0.0f, 0);
+        CHECK(farFirstPipeline < nearSecondPipeline);
+
+        // and the pass outranks everything
+        CHECK(RenderQueue::makeKey(0, 4095, 65535, 1.0f, 65535) < RenderQueue::makeKey(1, 0, 0, 0.0f, 0));
+    }
+
+    void testSortIsStable() {
+        // equal keys keep submission order, so ties draw in a predictable order
+        std::vector<RenderQueue::SortEntry> entries;
+        for (uint32_t i = 0; i < 1000; i++) {
+            entries.push_back({RenderQueue::makeKey(0, i % 2, 0, 0.0f, 0), i});
+        }
+        std::vector<RenderQueue::SortEntry> scratch;
+        RenderQueue::radixSort(entries, scratch);
+        for (size_t i = 1; i < entries.size(); i++) {
+            if (entries[i - 1].key == entries[i].key) {
+                CHECK(entries[i - 1].index < entries[i].index);
+            }
+        }
+    }
+
+}
+
+int main() {
+    testSortGroupsState();
+    testDepthOrdersWithinState();
+    testSortIsStable();
+    return testResult("render queue tests");
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test executables: a failed check is reported and the test keeps going,
+// main() returns testResult() so ctest sees the failure. Unlike assert these stay on in release builds.
+
+inline int g_testFailures = 0;
+
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_testFailures++;                                                              \
+        }                                                                                  \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (g_testFailures == 0) {
+        std::printf("%s passed\n", name);
+        return 0;
+    }
+    std::fprintf(stderr, "%s: %d checks failed\n", name, g_testFailures);
+    return 1;
+}
@@ -0,0 +1,288 @@
+// Offline texture cooker: turns a PPM/TGA source image into a KTX2 file holding a block
+// compressed (or plain RGBA8) mip chain, so the engine can upload it without any CPU work.
+//
+//   texture_cooker <input> <output.ktx2> [--format bc1|bc3|bc5|bc7|rgba8] [--linear] [--no-mips]
+
+#include "image_loader.h"
+#include "block_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace VKEngine;
+
+    struct Options {
+        std::string input;
+        std::string output;
+        std::string format = "bc7";
+        bool srgb = true;
+        bool mips = true;
+    };
+
+    VkFormat targetFormat(const std::string& name, bool srgb) {
+        if (name == "bc1") return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        if (name == "bc3") return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        if (name == "bc5") return VK_FORMAT_BC5_UNORM_BLOCK;
+        if (name == "bc7") return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        if (name == "rgba8") return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    float srgbToLinear(uint8_t value) {
+        float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint8_t linearToSrgb(float c) {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    // 2x2 box filter down to 1x1; colour is averaged in linear space for sRGB images
+    void generateMipChain(ImageData& image, bool srgb) {
+        std::array<float, 256> toLinear;
+        for (int i = 0; i < 256; i++) {
+            toLinear[i] = srgb ? srgbToLinear(static_cast<uint8_t>(i)) : i / 255.0f;
+        }
+
+        while (image.levels.back().width > 1 || image.levels.back().height > 1) {
+            const ImageData::Level source = image.levels.back();
+            uint32_t width = std::max(1u, source.width / 2);
+            uint32_t height = std::max(1u, source.height / 2);
+
+            size_t offset = image.data.size();
+            image.data.resize(offset + size_t(width) * height * 4);
+            const uint8_t* in = image.data.data() + source.offset;
+            uint8_t* out = image.data.data() + offset;
+
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    float sum[4] = {};
+                    for (uint32_t dy = 0; dy < 2; dy++) {
+                        for (uint32_t dx = 0; dx < 2; dx++) {
+                            uint32_t sx = std::min(x * 2 + dx, source.width - 1);
+                            uint32_t sy = std::min(y * 2 + dy, source.height - 1);
+                            const uint8_t* texel = &in[(size_t(sy) * source.width + sx) * 4];
+                            for (int c = 0; c < 3; c++) sum[c] += toLinear[texel[c]];
+                            sum[3] += texel[3] / 255.0f;
+                        }
+                    }
+                    uint8_t* texel = &out[(size_t(y) * width + x) * 4];
+                    for (int c = 0; c < 3; c++) {
+                        texel[c] = srgb ? linearToSrgb(sum[c] * 0.25f)
+                                        : static_cast<uint8_t>(sum[c] * 0.25f * 255.0f + 0.5f);
+                    }
+                    texel[3] = static_cast<uint8_t>(sum[3] * 0.25f * 255.0f + 0.5f);
+                }
+            }
+            image.levels.push_back({offset, size_t(width) * height * 4, width, height});
+        }
+    }
+
+    // Basic data format descriptor (Khronos Data Format 1.3) for the formats the cooker writes
+    std::vector<uint32_t> makeDataFormatDescriptor(VkFormat format) {
+        constexpr uint32_t MODEL_RGBSDA = 1, MODEL_BC1A = 128, MODEL_BC3 = 130, MODEL_BC5 = 132, MODEL_BC7 = 134;
+        constexpr uint32_t PRIMARIES_BT709 = 1;
+        constexpr uint32_t TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2;
+        constexpr uint32_t CHANNEL_ALPHA = 15, QUALIFIER_LINEAR = 0x10;
+
+        struct Sample {
+            uint32_t bitOffset;
+            uint32_t bitLength;
+            uint32_t channel;
+            uint32_t upper;
+        };
+
+        bool srgb = decompressedFormat(format) == VK_FORMAT_R8G8B8A8_SRGB;
+        uint32_t model = MODEL_RGBSDA;
+        std::vector<Sample> samples;
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                model = MODEL_BC1A;
+                samples = {{0, 64, 0, UINT32_MAX}};
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                model = MODEL_BC3;
+                samples = {{0, 64, CHANNEL_ALPHA | (srgb ? QUALIFIER_LINEAR : 0), UINT32_MAX}, {64, 64, 0, UINT32_MAX}};
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                model = MODEL_BC5;
+                samples = {{0, 64, 0, UINT32_MAX}, {64, 64, 1, UINT32_MAX}};
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                model = MODEL_BC7;
+                samples = {{0, 128, 0, UINT32_MAX}};
+                break;
+            default:
+                samples = {{0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255},
+                           {24, 8, CHANNEL_ALPHA | (srgb ? QUALIFIER_LINEAR : 0), 255}};
+                break;
+        }
+
+        bool compressed = isBlockCompressed(format);
+        uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint32_t> words;
+        words.push_back(4 + blockSize);                          // dfdTotalSize
+        words.push_back(0);                                      // vendorId = Khronos, descriptorType = basic
+        words.push_back(2 | (blockSize << 16));                  // versionNumber, descriptorBlockSize
+        words.push_back(model | (PRIMARIES_BT709 << 8) | ((srgb ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16));
+        words.push_back(compressed ? (3 | (3 << 8)) : 0);        // texel block dimensions minus one
+        words.push_back(formatBlockBytes(format));               // bytesPlane0
+        words.push_back(0);
+        for (const Sample& sample : samples) {
+            words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+            words.push_back(0);                                  // sample position
+            words.push_back(0);                                  // sampleLower
+            words.push_back(sample.upper);
+        }
+        return words;
+    }
+
+    bool writeKtx2(const std::string& path, const ImageData& image, std::string& error) {
+        constexpr size_t HEADER_SIZE = 80;
+        constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+        std::vector<uint32_t> dfd = makeDataFormatDescriptor(image.format);
+        const size_t levelCount = image.levels.size();
+        const size_t dfdOffset = HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE;
+        const size_t dfdLength = dfd.size() * 4;
+        // level data must be aligned to lcm(texel block size, 4), which is the block size here
+        const size_t alignment = formatBlockBytes(image.format);
+
+        std::vector<uint8_t> file(dfdOffset + dfdLength);
+        auto put32 = [&](size_t offset, uint32_t value) {
+            for (int i = 0; i < 4; i++) file[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+        };
+        auto put64 = [&](size_t offset, uint64_t value) {
+            for (int i = 0; i < 8; i++) file[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+        };
+
+        std::memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+        put32(12, image.format);
+        put32(16, 1);                                            // typeSize
+        put32(20, image.width);
+        put32(24, image.height);
+        put32(28, 0);                                            // pixelDepth
+        put32(32, 0);                                            // layerCount
+        put32(36, 1);                                            // faceCount
+        put32(40, static_cast<uint32_t>(levelCount));
+        put32(44, 0);                                            // supercompressionScheme
+        put32(48, static_cast<uint32_t>(dfdOffset));
+        put32(52, static_cast<uint32_t>(dfdLength));
+        for (size_t i = 0; i < dfd.size(); i++) {
+            put32(dfdOffset + i * 4, dfd[i]);
+        }
+
+        // mip data goes smallest level first
+        for (size_t level = levelCount; level-- > 0;) {
+            const ImageData::Level& source = image.levels[level];
+            size_t offset = (file.size() + alignment - 1) / alignment * alignment;
+            file.resize(offset);
+            file.insert(file.end(), image.data.begin() + source.offset, image.data.begin() + source.offset + source.size);
+
+            size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+            put64(entry, offset);
+            put64(entry + 8, source.size);
+            put64(entry + 16, source.size);
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            error = "failed to open " + path + " for writing";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        return out.good();
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        std::vector<std::string> positional;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--format" && i + 1 < argc) {
+                options.format = argv[++i];
+            }
+            else if (arg == "--linear") {
+                options.srgb = false;
+            }
+            else if (arg == "--no-mips") {
+                options.mips = false;
+            }
+            else if (arg.rfind("--", 0) == 0) {
+                return false;
+            }
+            else {
+                positional.push_back(arg);
+            }
+        }
+        if (positional.size() != 2) {
+            return false;
+        }
+        options.input = positional[0];
+        options.output = positional[1];
+        return true;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: texture_cooker <input> <output.ktx2> [--format bc1|bc3|bc5|bc7|rgba8] [--linear] [--no-mips]"
+                  << std::endl;
+        return 1;
+    }
+
+    VkFormat format = targetFormat(options.format, options.srgb);
+    if (format == VK_FORMAT_UNDEFINED) {
+        std::cerr << "unknown format: " << options.format << std::endl;
+        return 1;
+    }
+
+    ImageData image;
+    std::string error;
+    if (!loadImage(options.input, options.srgb, image, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    if (isBlockCompressed(image.format) || image.levels.size() != 1) {
+        std::cerr << "cooker input must be an uncompressed single-level image" << std::endl;
+        return 1;
+    }
+
+    if (options.mips) {
+        generateMipChain(image, options.srgb);
+    }
+
+    if (isBlockCompressed(format)) {
+        ImageData compressed;
+        if (!compressImage(image, format, compressed, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        image = std::move(compressed);
+    }
+    else {
+        image.format = format;
+    }
+
+    if (!writeKtx2(options.output, image, error)) {
+        std::cerr << (error.empty() ? "failed to write " + options.output : error) << std::endl;
+        return 1;
+    }
+
+    std::cout << options.input << " -> " << options.output << ": " << image.width << "x" << image.height
+              << ", " << image.levels.size() << " levels, " << image.data.size() << " bytes" << std::endl;
+    return 0;
+}